@@ -11,15 +11,35 @@ Api::Command Api::commands[ATOLL_API_MAX_COMMANDS];
 uint8_t Api::numCommands = 0;
 Api::Result Api::results[ATOLL_API_MAX_RESULTS];
 uint8_t Api::numResults = 0;
+Api::Channel Api::channels[ATOLL_API_MAX_CHANNELS];
+uint8_t Api::numChannels = 0;
+uint32_t Api::snapshotVersion = 0;
+char Api::replyBuffer[ATOLL_API_MAX_REPLY_LENGTH];
+char Api::chunkBuffer[ATOLL_API_MAX_REPLY_LENGTH];
+char Api::sendBuffer[ATOLL_API_MAX_REPLY_LENGTH];
 CircularBuffer<char, ATOLL_API_COMMAND_BUF_LENGTH> Api::_commandBuf;
 
 Api *Api::instance = nullptr;
+Api::Client Api::clients[ATOLL_API_MAX_CLIENTS];
+MpscRing<Api::ClientRef, ATOLL_API_REMOVED_CLIENTS> Api::removedClients;
+QueueHandle_t Api::queue = nullptr;
+Api::QueueStats Api::queueStats;
 
 #ifdef FEATURE_BLE_SERVER
+uint8_t Api::packetBuffer[ATOLL_API_PACKET_LENGTH];
 BleServer *Api::bleServer = nullptr;
 BLEUUID Api::serviceUuid = BLEUUID("DEAD");
 bool Api::secureBle = false;                // whether to use LESC for BLE API service
 uint32_t Api::passkey = ATOLL_API_PASSKEY;  // passkey for BLE API service, max 6 digits
+#ifdef FEATURE_BLELOG
+BLECharacteristic *Api::logChar = nullptr;
+char Api::logBuffer[ATOLL_API_LOG_BUFFER_SIZE];
+size_t Api::logBuffered = 0;
+ulong Api::logBufferedSince = 0;
+uint32_t Api::logReportedDropped = 0;
+portMUX_TYPE Api::logMux = portMUX_INITIALIZER_UNLOCKED;
+Api::LogStats Api::logStats;
+#endif
 #endif
 
 Api::Result::Result(
@@ -77,10 +97,21 @@ size_t Api::Message::replyAppend(const char *str, bool onlyIfNotEmpty) {
 Api::Command::Command(
     const char *name,
     Processor processor,
-    uint8_t code) {
+    uint8_t code,
+    uint32_t timeout,
+    bool cache) {
     this->code = code;
     snprintf(this->name, sizeof(this->name), "%s", name);
     this->processor = processor;
+    this->timeout = timeout;
+    this->cache = cache;
+}
+
+Api::Channel::Channel(
+    const char *name,
+    Sampler sampler) {
+    snprintf(this->name, sizeof(this->name), "%s", name);
+    this->sampler = sampler;
 }
 
 Api::Result *Api::Command::call(Api::Message *msg) {
@@ -125,9 +156,13 @@ void Api::setup(
     addResult(Result("argInvalid"));
     addResult(Result("argTooLong"));
     addResult(Result("internalError"));
+    addResult(Result("timeout"));
+    addResult(Result("busy"));
 
     addCommand(Command("init", Atoll::Api::initProcessor, 1));
     addCommand(Command("system", Atoll::Api::systemProcessor));
+    addCommand(Command("sub", Atoll::Api::subProcessor));
+    addCommand(Command("log", Atoll::Api::logProcessor));
 
     loadSettings();
     // printSettings();
@@ -137,6 +172,34 @@ void Api::setup(
         addBleService();
 #endif
     _commandBuf.clear();
+
+    if (nullptr == queue)
+        queue = xQueueCreate(ATOLL_API_QUEUE_LENGTH, sizeof(QueueItem));
+    if (nullptr == queue)
+        log_e("could not create queue, commands will be rejected");
+    else if (instance) {
+        instance->taskSetWakeOnNotify(true);  // woken by enqueue()
+        // isWorker() identifies the worker by the handle of a dedicated task
+        instance->taskSetShared(nullptr);
+        instance->taskStart(ATOLL_API_TASK_FREQ, ATOLL_API_TASK_STACK);
+    }
+}
+
+// process the queued frames in order
+void Api::loop() {
+    if (nullptr == queue) return;
+    QueueItem item;
+    while (pdTRUE == xQueueReceive(queue, &item, 0)) {
+        // a client that disconnected before the frame was received must not
+        // leave its settings to a new client with the same id
+        removeClients();
+        processItem(&item);
+    }
+    removeClients();
+    processSubscriptions();
+#if defined(FEATURE_BLE_SERVER) && defined(FEATURE_BLELOG)
+    flushLog();
+#endif
 }
 
 #ifdef FEATURE_BLE_SERVER
@@ -201,6 +264,7 @@ bool Api::addBleService() {
     }
     // log->setCallbacks(instance);
     log->setValue((uint8_t *)str, strlen(str));
+    logChar = log;
     Log::setWriteCallback([](const char *buf, size_t size) { Api::onLogWrite(buf, size); });
 #endif
 
@@ -249,6 +313,7 @@ bool Api::addCommand(Command newCommand) {
             if (0 == strcmp(commands[i].name, existing->name)) {
                 // log_d("replacing command %d:%s", existing->code, existing->name);
                 newCommand.code = existing->code;
+                free(commands[i].cached);
                 commands[i] = newCommand;
                 return true;
             }
@@ -336,14 +401,66 @@ uint8_t Api::nextAvailableResultCode() {
     return 0;
 }
 
+// replaces an existing channel with the same name
+bool Api::addChannel(Channel newChannel) {
+    if (strlen(newChannel.name) < 1) {
+        log_e("no name");
+        return false;
+    }
+    if (nullptr == newChannel.sampler) {
+        log_e("%s has no sampler", newChannel.name);
+        return false;
+    }
+    for (uint8_t i = 0; i < numChannels; i++)
+        if (0 == strcmp(channels[i].name, newChannel.name)) {
+            // log_d("replacing channel %s", newChannel.name);
+            channels[i] = newChannel;
+            return true;
+        }
+    if (ATOLL_API_MAX_CHANNELS <= numChannels) {
+        log_e("no slot for '%s'", newChannel.name);
+        return false;
+    }
+    channels[numChannels] = newChannel;
+    numChannels++;
+    return true;
+}
+
+// force sending the channel to all subscribers in the next round
+void Api::channelChanged(const char *name) {
+    for (uint8_t i = 0; i < numChannels; i++)
+        if (0 == strcmp(channels[i].name, name)) {
+            channels[i].changes++;
+            return;
+        }
+}
+
+// the cached value of the command will be refreshed on the next init, commands
+// created with cache set must call this when the value changes without the
+// command being called with an argument
+void Api::invalidate(const char *name) {
+    Command *c = command(name, false);
+    if (nullptr != c) c->stale = true;
+}
+
+void Api::invalidateAll() {
+    for (uint8_t i = 0; i < numCommands; i++) commands[i].stale = true;
+}
+
 void Api::loadSettings() {
     if (nullptr == instance) {
         log_e("instance null");
         return;
     }
     if (!instance->preferencesStartLoad()) return;
+#ifdef FEATURE_BLE_SERVER
     secureBle = instance->preferences->getBool("secureBle", secureBle);
     passkey = (uint32_t)instance->preferences->getInt("passkey", passkey);
+#endif
+    char levels[ATOLL_LOG_MAX_TAGS * (ATOLL_LOG_TAG_LENGTH + 3) + 8] = "";
+    if (0 < instance->preferences->getString("log", levels, sizeof(levels)) &&
+        !Log::levelsFromStr(levels))
+        log_e("invalid log levels: %s", levels);
     instance->preferencesEnd();
 }
 
@@ -353,13 +470,20 @@ void Api::saveSettings() {
         return;
     }
     if (!instance->preferencesStartSave()) return;
+#ifdef FEATURE_BLE_SERVER
     instance->preferences->putBool("secureBle", secureBle);
     instance->preferences->putInt("passkey", (int32_t)passkey);
+#endif
+    char levels[ATOLL_LOG_MAX_TAGS * (ATOLL_LOG_TAG_LENGTH + 3) + 8];
+    Log::levelsToStr(levels, sizeof(levels));
+    instance->preferences->putString("log", levels);
     instance->preferencesEnd();
 }
 
 void Api::printSettings() {
+#ifdef FEATURE_BLE_SERVER
     log_i("secureBle: %s, passkey: %d", secureBle ? "yes" : "no", passkey);
+#endif
 }
 
 bool Api::isAlNumStr(const char *str) {
@@ -476,13 +600,21 @@ void Api::notifyTxChar(const char *str) {
 
 // Api::Command format: commandCode|commandStr[=[arg]];
 // Reply format: resultCode[:resultName];[commandCode[=value]]
-Api::Message Api::process(const char *commandWithArg, bool log) {
+// maxReplySize is the space formatReply() will have, see Message
+Api::Message Api::process(const char *commandWithArg,
+                          bool log,
+                          ApiTransport *transport,
+                          uint16_t clientId,
+                          size_t maxReplySize) {
     // log_d("Processing command %s%s", commandWithArg, log ? "" : " (logging suppressed)");
     Message msg;
     msg.log = log;
+    msg.transport = transport;
+    msg.clientId = clientId;
+    msg.maxReplySize = maxReplySize;
     char commandStr[ATOLL_API_COMMAND_NAME_LENGTH] = "";
     int commandWithArgLength = strlen(commandWithArg);
-    char *eqSign = strstr(commandWithArg, "=");
+    const char *eqSign = strstr(commandWithArg, "=");
     int commandEnd = eqSign ? eqSign - commandWithArg : commandWithArgLength;
     if (commandEnd < 1) {
         log_e("missing command: %s", commandWithArg);
@@ -525,41 +657,455 @@ Api::Message Api::process(const char *commandWithArg, bool log) {
 
     // call the command's processor, it will set msg.result msg.reply
     c->call(&msg);
+    // a setter may have changed the value
+    if (0 < strlen(msg.arg) && msg.result == success()) c->stale = true;
 
     return msg;
 }
 
-// process all available commands except 'init' without arguments
-// and return the results in the format: commandCode:commandName=value;...
+// Called by the transports with a complete frame received from a client.
+// Queues the frame for the worker task and replies with "busy" if the queue is
+// full. Frames are never processed in the caller's task, e.g. the BLE host,
+// without a worker they are rejected. Returns false if the frame was rejected.
+bool Api::receive(ApiTransport *transport, uint16_t clientId, const char *frame, size_t length) {
+    QueueItem item;
+    if (!prepareItem(&item, frame, length, transport, clientId)) {
+        sendResult(&item, result("commandTooLong"));
+        return false;
+    }
+    if (enqueue(&item)) return true;
+    if (nullptr != queue && nullptr != instance && instance->taskRunning()) {
+        // queue is full
+        sendResult(&item, result("busy"));
+        return false;
+    }
+    log_e("no worker, rejecting '%s'", item.frame);
+    sendResult(&item, internalError());
+    return false;
+}
+
+// Frame format: [[correlationId]]command[=arg] or a batch, see processBatch()
+// returns false if the frame does not fit in the item
+bool Api::prepareItem(QueueItem *item,
+                      const char *frame,
+                      size_t length,
+                      ApiTransport *transport,
+                      uint16_t clientId) {
+    // strip trailing nul bytes
+    while (0 < length && '\0' == frame[length - 1]) length--;
+    item->enqueued = millis();
+    item->transport = transport;
+    item->clientId = clientId;
+    item->correlationId[0] = '\0';
+    item->commandCode = 0;
+    if (0 < length && '[' == frame[0]) {
+        const char *close = (const char *)memchr(frame, ']', length);
+        if (nullptr != close && close - frame <= sizeof(item->correlationId)) {
+            size_t idLength = close - frame - 1;
+            memcpy(item->correlationId, frame + 1, idLength);
+            item->correlationId[idLength] = '\0';
+            length -= idLength + 2;
+            frame = close + 1;
+        }
+    }
+    if (sizeof(item->frame) <= length) {
+        log_e("frame too long: %d", length);
+        item->frame[0] = '\0';
+        item->length = 0;
+        item->deadline = item->enqueued;
+        return false;
+    }
+    memcpy(item->frame, frame, length);
+    item->frame[length] = '\0';
+    item->length = length;
+    uint32_t timeout = ATOLL_API_COMMAND_TIMEOUT;
+    if (!isBatch(item->frame, item->length)) {
+        char name[ATOLL_API_COMMAND_NAME_LENGTH] = "";
+        size_t nameLength = strcspn(item->frame, "=");
+        if (nameLength < sizeof(name)) {
+            memcpy(name, item->frame, nameLength);
+            name[nameLength] = '\0';
+            Command *c = command(name, false);
+            if (nullptr == c) {
+                int code = atoi(name);
+                if (0 < code && code <= UINT8_MAX) c = command((uint8_t)code, false);
+            }
+            if (nullptr != c) {
+                item->commandCode = c->code;
+                if (0 < c->timeout) timeout = c->timeout;
+            }
+        }
+    }
+    item->deadline = item->enqueued + timeout;
+    return true;
+}
+
+// returns false if the queue is full or there is no worker
+bool Api::enqueue(QueueItem *item) {
+    if (nullptr == queue || nullptr == instance || !instance->taskRunning())
+        return false;
+    if (pdTRUE != xQueueSend(queue, item, 0)) {
+        queueStats.dropped++;
+        log_e("queue full, dropping '%s'", item->frame);
+        return false;
+    }
+    uint8_t depth = (uint8_t)uxQueueMessagesWaiting(queue);
+    if (queueStats.maxDepth < depth) queueStats.maxDepth = depth;
+    instance->taskNotify();
+    return true;
+}
+
+void Api::processItem(QueueItem *item) {
+    if (nullptr == item->transport) {
+        log_e("'%s' has no transport", item->frame);
+        return;
+    }
+    if ((long)(millis() - item->deadline) > 0) {
+        queueStats.expired++;
+        log_w("'%s' expired after %dms in queue", item->frame, millis() - item->enqueued);
+        sendResult(item, result("timeout"));
+        return;
+    }
+    size_t maxReplySize = item->transport->maxReplySize(item->clientId);
+    if (sizeof(replyBuffer) < maxReplySize) maxReplySize = sizeof(replyBuffer);
+    // reserve space for the correlation id prefix
+    maxReplySize -= strlen(item->correlationId) + 2;
+    if (isBatch(item->frame, item->length)) {
+        processBatch(
+            item->frame,
+            item->length,
+            [item](const char *buf, size_t size) { sendReply(item, buf, size); },
+            maxReplySize,
+            true,
+            item->transport,
+            item->clientId);
+    } else {
+        Message msg = process(item->frame, true, item->transport, item->clientId, maxReplySize);
+        sendReply(item, replyBuffer, formatReply(&msg, replyBuffer, maxReplySize));
+    }
+    uint32_t latency = millis() - item->enqueued;
+    queueStats.processed++;
+    queueStats.totalLatency += latency;
+    if (queueStats.maxLatency < latency) queueStats.maxLatency = latency;
+}
+
+// prepends the correlation id and sends the reply to the client, called by the worker task
+void Api::sendReply(QueueItem *item, const char *buf, size_t size) {
+    if (nullptr == item->transport) return;
+    char *out = sendBuffer;
+    size_t outSize = item->transport->maxReplySize(item->clientId);
+    if (sizeof(sendBuffer) < outSize) outSize = sizeof(sendBuffer);
+    size_t outLength = 0;
+    if (strlen(item->correlationId))
+        outLength = snprintf(out, outSize, "[%s]", item->correlationId);
+    if (outSize < outLength + size) {
+        log_w("reply has been cropped from %d to %d bytes", size, outSize - outLength);
+        size = outSize - outLength;
+    }
+    memcpy(out + outLength, buf, size);
+    outLength += size;
+    // log_d("%s reply(%d): %.*s", item->transport->transportName(), outLength, outLength, out);
+    item->transport->send(item->clientId, (uint8_t *)out, outLength);
+}
+
+// sends a reply with only the result, e.g. an error, from any task
+// in the format: [[correlationId]]resultCode:resultName;commandCode=
+void Api::sendResult(QueueItem *item, Result *result) {
+    if (nullptr == item->transport || nullptr == result) return;
+    char out[ATOLL_API_CORRELATION_ID_LENGTH + 2 + 4 + ATOLL_API_RESULT_NAME_LENGTH + 5];
+    int length = strlen(item->correlationId)
+                     ? snprintf(out, sizeof(out), "[%s]%d:%s;%d=",
+                                item->correlationId, result->code, result->name, item->commandCode)
+                     : snprintf(out, sizeof(out), "%d:%s;%d=",
+                                result->code, result->name, item->commandCode);
+    if (length < 0) return;
+    if (sizeof(out) <= (size_t)length) length = sizeof(out) - 1;
+    item->transport->send(item->clientId, (uint8_t *)out, length);
+}
+
+// whether the caller is the worker task, the only one using the reply buffers and the clients
+bool Api::isWorker() {
+    return nullptr != instance &&
+           nullptr != instance->taskHandle &&
+           xTaskGetCurrentTaskHandle() == instance->taskHandle;
+}
+
+// returns nullptr if the client is not found and create is false or there are no free slots
+Api::Client *Api::client(ApiTransport *transport, uint16_t clientId, bool create) {
+    if (nullptr == transport || UINT16_MAX == clientId) return nullptr;
+    Client *free = nullptr;
+    for (uint8_t i = 0; i < ATOLL_API_MAX_CLIENTS; i++) {
+        if (clients[i].transport == transport && clients[i].id == clientId) return &clients[i];
+        if (nullptr == free && nullptr == clients[i].transport) free = &clients[i];
+    }
+    if (!create) return nullptr;
+    if (nullptr == free) {
+        log_e("no slot for %s client %d", transport->transportName(), clientId);
+        return nullptr;
+    }
+    *free = Client();
+    free->transport = transport;
+    free->id = clientId;
+    return free;
+}
+
+// transports should call this when a client disconnects, from any task:
+// the client is removed by the worker task before its next frame
+void Api::removeClient(ApiTransport *transport, uint16_t clientId) {
+    if (nullptr == transport || UINT16_MAX == clientId) return;
+    ClientRef ref;
+    ref.transport = transport;
+    ref.id = clientId;
+    if (!removedClients.push(ref))
+        log_e("could not remove %s client %d", transport->transportName(), clientId);
+}
+
+// called by the worker task
+void Api::removeClients() {
+    ClientRef ref;
+    while (removedClients.pop(&ref)) {
+        Client *c = client(ref.transport, ref.id);
+        if (nullptr != c) *c = Client();
+    }
+}
+
+// Reply format: resultCode[:resultName];commandCode=[value]
+// returns the length of the reply written to buf, which may contain binary data
+size_t Api::formatReply(Message *msg, char *buf, size_t size) {
+    if (size < 1) return 0;
+    // length = length(uint8max) + ":" + resultName
+    char resultStr[4 + ATOLL_API_RESULT_NAME_LENGTH];
+
+    if (msg->result->code == success()->code) {
+        // in case of success we omit the resultName: "resultCode;..."
+        snprintf(resultStr, sizeof(resultStr), "%d", msg->result->code);
+    } else {
+        // in case of an error we provide the resultName: "resultCode:resultName;..."
+        snprintf(resultStr, sizeof(resultStr), "%d:%s",
+                 msg->result->code, msg->result->name);
+    }
+    snprintf(buf, size, "%s;%d=", resultStr, msg->commandCode);
+    size_t replyTextLength = strlen(buf);
+    // in case of an error we only send the result
+    if (msg->result->code != success()->code) return replyTextLength;
+    // in case of success we append the reply
+    // msg->replyLength will be set when msg->reply contains binary data
+    size_t replyDataLength = 0 < msg->replyLength ? msg->replyLength : strlen(msg->reply);
+    if (size < replyTextLength + replyDataLength + 1) {
+        log_w("%s reply has been cropped from %d to %d bytes",
+              buf, replyDataLength, size - replyTextLength - 1);
+        replyDataLength = size - replyTextLength - 1;
+    }
+    // log_d("reply: '%s', msg->replyLength: %d, replyTextLength: %d, replyDataLength: %d",
+    //       buf, msg->replyLength, replyTextLength, replyDataLength);
+    // using memcpy to deal with binary data
+    memcpy(buf + replyTextLength, msg->reply, replyDataLength);
+    buf[replyTextLength + replyDataLength] = '\0';
+    return replyTextLength + replyDataLength;
+}
+
+// a frame containing the separator is a batch
+bool Api::isBatch(const char *frame, size_t length) {
+    return nullptr != memchr(frame, ATOLL_API_BATCH_SEPARATOR, length);
+}
+
+// Batch format: command1[=arg1]\ncommand2[=arg2]\n...
+// Commands are processed in order, the replies are joined by the separator
+// and passed to the writer in chunks of at most maxChunkSize bytes, each chunk
+// containing only complete replies. Binary replies are always sent in a chunk of their own.
+// Called by the worker task. Returns the number of commands processed.
+uint8_t Api::processBatch(const char *batch,
+                          size_t length,
+                          ReplyWriter writer,
+                          size_t maxChunkSize,
+                          bool log,
+                          ApiTransport *transport,
+                          uint16_t clientId) {
+#if 0 != ATOLL_LOG_LEVEL && ARDUHAL_LOG_LEVEL_DEBUG <= ATOLL_LOG_LOCAL_LEVEL
+    ulong start = millis();
+#endif
+    const char *end = batch + length;
+    // strip trailing nul bytes
+    while (batch < end && '\0' == *(end - 1)) end--;
+
+    uint16_t numLines = 0;
+    for (const char *cp = batch; cp < end; cp++)
+        if ((cp == batch || ATOLL_API_BATCH_SEPARATOR == *(cp - 1)) &&
+            ATOLL_API_BATCH_SEPARATOR != *cp && '\r' != *cp)
+            numLines++;
+    if (ATOLL_API_BATCH_MAX_COMMANDS < numLines) {
+        log_e("too many commands in batch: %d, max %d", numLines, ATOLL_API_BATCH_MAX_COMMANDS);
+        Message msg;
+        msg.result = result("commandTooLong");
+        char reply[4 + ATOLL_API_RESULT_NAME_LENGTH + 5];
+        size_t replyLength = formatReply(&msg, reply, sizeof(reply));
+        writer(reply, replyLength);
+        return 0;
+    }
+
+    if (sizeof(chunkBuffer) < maxChunkSize) maxChunkSize = sizeof(chunkBuffer);
+    char *chunk = chunkBuffer;
+    size_t chunkLength = 0;
+    char *reply = replyBuffer;
+    // command name + "=" + arg + nul, longer commands will be rejected with argTooLong
+    char line[ATOLL_API_COMMAND_NAME_LENGTH + ATOLL_API_MSG_ARG_LENGTH + 2];
+    uint8_t processed = 0;
+    const char *lineStart = batch;
+    while (lineStart < end) {
+        const char *lineEnd = (const char *)memchr(lineStart, ATOLL_API_BATCH_SEPARATOR, end - lineStart);
+        if (nullptr == lineEnd) lineEnd = end;
+        size_t lineLength = lineEnd - lineStart;
+        if (0 < lineLength && '\r' == lineStart[lineLength - 1]) lineLength--;
+        const char *next = lineEnd + 1;
+        if (0 == lineLength) {
+            lineStart = next;
+            continue;
+        }
+        Message msg;
+        if (sizeof(line) <= lineLength) {
+            log_e("line too long: %d", lineLength);
+            msg.result = result("argTooLong");
+        } else {
+            memcpy(line, lineStart, lineLength);
+            line[lineLength] = '\0';
+            msg = process(line, log, transport, clientId, maxChunkSize);
+        }
+        processed++;
+        size_t replyLength = formatReply(&msg, reply, maxChunkSize);
+        bool isBinary = 0 < msg.replyLength;
+        // flush the chunk if the reply does not fit or is binary
+        if (0 < chunkLength &&
+            (isBinary || maxChunkSize < chunkLength + 1 + replyLength)) {
+            writer(chunk, chunkLength);
+            chunkLength = 0;
+        }
+        if (isBinary) {
+            writer(reply, replyLength);
+        } else {
+            if (0 < chunkLength) chunk[chunkLength++] = ATOLL_API_BATCH_SEPARATOR;
+            memcpy(chunk + chunkLength, reply, replyLength);
+            chunkLength += replyLength;
+        }
+        lineStart = next;
+    }
+    if (0 < chunkLength) writer(chunk, chunkLength);
+#if 0 != ATOLL_LOG_LEVEL && ARDUHAL_LOG_LEVEL_DEBUG <= ATOLL_LOG_LOCAL_LEVEL
+    if (log) log_d("%d commands processed in %dms", processed, millis() - start);
+#endif
+    return processed;
+}
+
+// init: the values of all available commands except 'init' without arguments
+// in the format: commandCode:commandName=value;...
+// init=since:<version>: only the values that changed after the version
+// init=page:<n>: page n of the values, n starts at 0
+// init=since:<version>;page:<n>: both of the above
+// Commands are called on every request, except the ones created with cache
+// set, whose values are refreshed only after the command has been invalidated.
+// With an argument the reply starts with "0:version=<version>;" to be used in
+// the next request. If the values do not fit in the reply, the reply ends
+// with "0:next=<n>;" and the rest can be requested with page:<n>.
 Api::Result *Api::initProcessor(Message *msg) {
-    char reply[msgReplyLength] = "";
-    char token[6 + ATOLL_API_COMMAND_NAME_LENGTH + msgReplyLength];
-    Result *successResult = success();
-    for (int i = 0; i < numCommands; i++) {
-        if (0 == strcmp(commands[i].name, "init")) continue;
-        // call command without arg, suppress logging
-        Message msg = process(commands[i].name, false);
-        if (msg.result == successResult)
-            snprintf(token, sizeof(token), "%d:%s=%s;",
-                     commands[i].code,
-                     commands[i].name,
-                     msg.reply);
-        else
-            snprintf(token, sizeof(token), "%d:%s;",
-                     commands[i].code,
-                     commands[i].name);
-        int16_t remaining = msgReplyLength - strlen(reply) - 1;
-        if (remaining < strlen(token)) {
-            log_e("reply out of space: %d + %d + 1 > %d",
-                  strlen(reply), strlen(token), msgReplyLength);
-            log_e("token: %s", token);
-            log_e("reply: %s", reply);
-            return internalError();
-        }
-        strncat(reply, token, remaining);
-    }
-    strncpy(msg->reply, reply, msgReplyLength);
-    return successResult;
+    uint32_t since = 0;
+    uint16_t page = 0;
+    bool withArg = 0 < strlen(msg->arg);
+    if (withArg) {
+        char param[12] = "";
+        bool valid = false;
+        if (msg->argGetParam("since:", param, sizeof(param) - 1)) {
+            if (strspn(param, "0123456789") != strlen(param)) goto argInvalid;
+            since = strtoul(param, nullptr, 10);
+            valid = true;
+        }
+        if (msg->argGetParam("page:", param, sizeof(param) - 1)) {
+            if (strspn(param, "0123456789") != strlen(param)) goto argInvalid;
+            int i = atoi(param);
+            if (i < 0 || UINT16_MAX < i) goto argInvalid;
+            page = (uint16_t)i;
+            valid = true;
+        }
+        if (!valid) goto argInvalid;
+    }
+    {
+        for (int i = 0; i < numCommands; i++)
+            if (0 != strcmp(commands[i].name, "init")) refreshSnapshot(&commands[i]);
+        char reply[msgReplyLength] = "";
+        size_t header = 0;
+        if (withArg) header = snprintf(reply, sizeof(reply), "0:version=%u;", snapshotVersion);
+        // the page and the next page marker must fit in the reply
+        size_t dataSize = sizeof(reply) - 1;
+        if (0 < msg->maxReplySize) {
+            // formatReply() prepends "<result>;<command>=" and appends nul
+            char prefix[12];
+            size_t prefixLength = snprintf(prefix, sizeof(prefix), "%d;%d=", success()->code, msg->commandCode);
+            size_t transportDataSize = msg->maxReplySize < prefixLength + 1
+                                           ? 0
+                                           : msg->maxReplySize - prefixLength - 1;
+            if (transportDataSize < dataSize) dataSize = transportDataSize;
+        }
+        size_t marker = strlen("0:next=65535;");
+        size_t available = marker < dataSize ? dataSize - marker : 0;
+        char token[6 + ATOLL_API_COMMAND_NAME_LENGTH + msgReplyLength];
+        size_t pageLength = header;
+        uint16_t currentPage = 0;
+        bool more = false;
+        for (int i = 0; i < numCommands; i++) {
+            Command *c = &commands[i];
+            if (0 == strcmp(c->name, "init")) continue;
+            if (c->version <= since) continue;
+            if (c->cachedSuccess && nullptr != c->cached)
+                snprintf(token, sizeof(token), "%d:%s=%s;", c->code, c->name, c->cached);
+            else
+                snprintf(token, sizeof(token), "%d:%s;", c->code, c->name);
+            size_t tokenLength = strlen(token);
+            if (available < header + tokenLength) {
+                // the value would not fit on any page
+                log_w("%s value too long for init: %d", c->name, tokenLength);
+                snprintf(token, sizeof(token), "%d:%s;", c->code, c->name);
+                tokenLength = strlen(token);
+            }
+            if (header < pageLength && available < pageLength + tokenLength) {
+                currentPage++;
+                pageLength = header;
+                if (page < currentPage) {
+                    more = true;
+                    break;
+                }
+            }
+            if (currentPage == page) strncat(reply, token, sizeof(reply) - strlen(reply) - 1);
+            pageLength += tokenLength;
+        }
+        if (more) {
+            snprintf(token, sizeof(token), "0:next=%d;", page + 1);
+            strncat(reply, token, sizeof(reply) - strlen(reply) - 1);
+        }
+        strncpy(msg->reply, reply, msgReplyLength);
+        return success();
+    }
+
+argInvalid:
+    strncpy(msg->reply, "since:version;page:n", msgReplyLength);
+    return argInvalid();
+}
+
+// calls the command without an argument unless it is cached and not stale,
+// and bumps the snapshot version if the value has changed
+void Api::refreshSnapshot(Command *c) {
+    if (c->cache && !c->stale) return;
+    Message msg = process(c->name, false);
+    c->stale = false;
+    bool isSuccess = msg.result == success();
+    const char *value = isSuccess ? msg.reply : "";
+    if (0 < c->version &&
+        c->cachedSuccess == isSuccess &&
+        nullptr != c->cached &&
+        0 == strcmp(c->cached, value))
+        return;
+    free(c->cached);
+    c->cached = strdup(value);
+    if (nullptr == c->cached) log_e("out of memory caching %s", c->name);
+    c->cachedSuccess = isSuccess;
+    c->version = ++snapshotVersion;
 }
 
 Api::Result *Api::systemProcessor(Message *msg) {
@@ -567,11 +1113,91 @@ Api::Result *Api::systemProcessor(Message *msg) {
         snprintf(msg->reply, msgReplyLength, "%s%s %s %s",
                  VERSION, BUILDTAG, __DATE__, __TIME__);
         return success();
+    } else if (msg->argIs("queue")) {
+        snprintf(msg->reply, msgReplyLength,
+                 "depth:%d;maxDepth:%d;processed:%d;expired:%d;dropped:%d;latencyAvg:%d;latencyMax:%d",
+                 nullptr == queue ? 0 : uxQueueMessagesWaiting(queue),
+                 queueStats.maxDepth,
+                 queueStats.processed,
+                 queueStats.expired,
+                 queueStats.dropped,
+                 0 < queueStats.processed ? (uint32_t)(queueStats.totalLatency / queueStats.processed) : 0,
+                 queueStats.maxLatency);
+        return success();
+#ifdef FEATURE_BLELOG
+    } else if (msg->argIs("blelog")) {
+        snprintf(msg->reply, msgReplyLength,
+                 "buffered:%d;sent:%u;packets:%u;dropped:%u",
+                 logBuffered, logStats.sent, logStats.packets, logStats.dropped);
+        return success();
+#endif
+    } else if (msg->argIs("tasks")) {
+        // name:loops:avgUs:maxUs:overruns:jitterMaxMs:stackFree:notified;...
+        char entry[64];
+        msg->reply[0] = '\0';
+        for (uint8_t i = 0; i < Task::taskCount(); i++) {
+            Task *task = Task::taskAt(i);
+            if (nullptr == task) continue;
+            size_t len = task->taskStatsToStr(entry, sizeof(entry));
+            if (msgReplyLength <= strlen(msg->reply) + len + 1) break;
+            if (0 < strlen(msg->reply)) msg->replyAppend(";");
+            msg->replyAppend(entry);
+        }
+        return success();
+    } else if (msg->argIs("tasks:reset")) {
+        for (uint8_t i = 0; i < Task::taskCount(); i++) {
+            Task *task = Task::taskAt(i);
+            if (nullptr != task) task->taskStatsReset();
+        }
+        Task::taskModeTimeReset();
+        strncpy(msg->reply, "tasks:reset", msgReplyLength);
+        return success();
+    } else if (msg->argIs("tasks:modes")) {
+        // modes:activity;idle:ms;active:ms
+        snprintf(msg->reply, msgReplyLength, "modes:%u;idle:%llu;active:%llu",
+                 Task::taskActivity(), Task::taskModeTime(false), Task::taskModeTime(true));
+        return success();
+    } else if (msg->argStartsWith("tasks:")) {
+        // name:loops:avgUs:maxUs:overruns:jitterMaxMs:stackFree:notified;hist:<64us|<256us|<1ms|<4ms|<16ms|<65ms|<262ms|more
+        // ;awake:idleUs|activeUs[;gov:idleHz|activeHz|idle|active]
+        Task *task = Task::taskFind(msg->arg + strlen("tasks:"));
+        if (nullptr == task) goto argInvalid;
+        task->taskStatsToStr(msg->reply, msgReplyLength);
+        msg->replyAppend(";hist:");
+        char bucket[48];
+        for (uint8_t i = 0; i < ATOLL_TASK_STATS_BUCKETS; i++) {
+            snprintf(bucket, sizeof(bucket), "%s%u", 0 < i ? "|" : "", task->taskStats.histogram[i]);
+            msg->replyAppend(bucket);
+        }
+        snprintf(bucket, sizeof(bucket), ";awake:%llu|%llu",
+                 task->taskStats.awakeTime[0], task->taskStats.awakeTime[1]);
+        msg->replyAppend(bucket);
+        if (task->taskGoverned()) {
+            snprintf(bucket, sizeof(bucket), ";gov:%.2f|%.2f|%s",
+                     task->taskGovernorFreq(false), task->taskGovernorFreq(true),
+                     task->taskGovernorActive() ? "active" : "idle");
+            msg->replyAppend(bucket);
+        }
+        return success();
     } else if (msg->argIs("bootlog")) {
         Log::dumpBootLog();
         strncpy(msg->reply, "bootlog", ATOLL_API_MSG_REPLY_LENGTH);
         return success();
+    } else if (msg->argStartsWith("bootlog:")) {
+        // bootlog:offset replies with "bootlog:offset:length;" and a chunk of the boot log
+        const char *offsetStr = msg->arg + strlen("bootlog:");
+        if (0 == strlen(offsetStr) || strlen(offsetStr) != strspn(offsetStr, "0123456789"))
+            goto argInvalid;
+        size_t offset = (size_t)atoi(offsetStr);
+        size_t length = Log::bootLogLength();
+        if (0 < length && length <= offset) goto argInvalid;
+        snprintf(msg->reply, msgReplyLength, "bootlog:%u:%u;", offset, length);
+        size_t replyTextLen = strlen(msg->reply);
+        msg->replyLength = replyTextLen +
+                           Log::readBootLog(msg->reply + replyTextLen, msgReplyLength - replyTextLen - 1, offset);
+        return success();
     } else if (msg->argIs("reboot")) {
+#ifdef FEATURE_BLE_SERVER
         if (bleServer) {
             BLECharacteristic *c = bleServer->getChar(
                 serviceUuid,
@@ -583,10 +1209,12 @@ Api::Result *Api::systemProcessor(Message *msg) {
                 c->notify();
             }
         }
+#endif
         log_i("rebooting");
         delay(500);
         ESP.restart();
     }
+#ifdef FEATURE_BLE_SERVER
     {
         const char *str = "secureApi";
         uint8_t sStr = strlen(str);
@@ -631,6 +1259,31 @@ Api::Result *Api::systemProcessor(Message *msg) {
             return success();
         }
     }
+#endif
+    {
+        const char *str = "frag";
+        uint8_t sStr = strlen(str);
+        if (sStr == strspn(msg->arg, str)) {
+            char *arg = msg->arg;
+            size_t sArg = strlen(arg);
+            Client *c = client(msg->transport, msg->clientId, sStr < sArg);
+            if (sStr < sArg) {
+                // set fragmentation for the client
+                if (':' != arg[sStr]) goto argInvalid;
+                arg += sStr + 1;
+                sArg = strlen(arg);
+                if (sArg != 1) goto argInvalid;
+                int i = atoi(arg);
+                if (i < 0 || 1 < i) goto argInvalid;
+                if (nullptr == c) goto argInvalid;
+                c->fragment = (bool)i;
+            }
+            // get fragmentation for the client
+            snprintf(msg->reply, msgReplyLength, "%d", nullptr != c && c->fragment);
+            return success();
+        }
+    }
+#ifdef FEATURE_BLE_SERVER
     {
         const char *str = "deleteBond";
         uint8_t sStr = strlen(str);
@@ -647,84 +1300,343 @@ Api::Result *Api::systemProcessor(Message *msg) {
             goto argInvalid;
         }
     }
+#endif
 argInvalid:
     msg->replyAppend("|", true);
-    msg->replyAppend("build|bootlog|reboot|secureApi[:0|1]|passkey[:1..999999]|deleteBond:[address|*]");
+    msg->replyAppend("build|queue|tasks[:name|:reset|:modes]|blelog|bootlog[:offset]|reboot|secureApi[:0|1]|passkey[:1..999999]|frag[:0|1]|deleteBond:[address|*]");
     return result("argInvalid");
 }
 
-// BleCharacteristicCallbacks
-void Api::onWrite(BLECharacteristic *c, BLEConnInfo &connInfo) {
-    if (c->getUUID().equals(BLEUUID(API_RX_CHAR_UUID))) {
-        Message msg = process(c->getValue().c_str());
-
-        // length = length(uint8max) + ":" + resultName
-        char resultStr[4 + ATOLL_API_RESULT_NAME_LENGTH];
+// log: get the log levels as *:level[,tag:level...], "*" being the global level
+// log=tag:level[,...]: set the level of tags, "*:level" sets the global level
+// log=-tag: remove the level of a tag, "-*" removes all tag levels
+// levels are 0: none, 1: error, 2: warning, 3: info, 4: debug, 5: verbose
+Api::Result *Api::logProcessor(Message *msg) {
+    if (0 < strlen(msg->arg)) {
+        if (!Log::levelsFromStr(msg->arg)) {
+            msg->replyAppend("tag:0..5[,tag:0..5...]|-tag|-*");
+            return argInvalid();
+        }
+        saveSettings();
+    }
+    Log::levelsToStr(msg->reply, msgReplyLength);
+    return success();
+}
 
-        if (msg.result->code == success()->code) {
-            // in case of success we omit the resultName: "resultCode;..."
-            snprintf(resultStr, sizeof(resultStr), "%d", msg.result->code);
+// sub: list subscriptions of the client
+// sub=channel:intervalMs[:threshold]: subscribe to a telemetry channel
+// sub=-channel: unsubscribe from channel
+// sub=-*: unsubscribe from all channels
+Api::Result *Api::subProcessor(Message *msg) {
+    Client *c = client(msg->transport, msg->clientId, 0 < strlen(msg->arg));
+    if (0 < strlen(msg->arg)) {
+        if (nullptr == c) {
+            log_e("no client");
+            return error();
+        }
+        if (msg->argIs("-*")) {
+            for (uint8_t i = 0; i < ATOLL_API_MAX_SUBSCRIPTIONS; i++)
+                c->subs[i] = Subscription();
         } else {
-            // in case of an error we provide the resultName: "resultCode:resultName;..."
-            snprintf(resultStr, sizeof(resultStr), "%d:%s",
-                     msg.result->code, msg.result->name);
-        }
-        char reply[ATOLL_BLE_SERVER_CHAR_VALUE_MAXLENGTH] = "";
-        snprintf(reply, sizeof(reply), "%s;%d=",
-                 resultStr, msg.commandCode);
-        size_t replyLength = 0;
-        // in case of success we append the reply
-        if (msg.result->code == success()->code) {
-            size_t replyTextLength = strlen(reply);
-            // msg.replyLength will be set when msg.reply contains binary data
-            size_t replyDataLength = 0 < msg.replyLength ? msg.replyLength : strlen(msg.reply);
-            if (sizeof(reply) < replyTextLength + replyDataLength - 1) {
-                size_t prevLength = replyDataLength;
-                replyDataLength = sizeof(reply) - replyTextLength - 1;
-                log_w("%s reply has been cropped from %d to %d bytes",
-                      reply, prevLength, replyDataLength);
+            bool unsubscribe = '-' == msg->arg[0];
+            char name[ATOLL_API_COMMAND_NAME_LENGTH] = "";
+            const char *cp = msg->arg + (unsubscribe ? 1 : 0);
+            size_t nameLength = strcspn(cp, ":");
+            if (nameLength < 1 || sizeof(name) <= nameLength) goto argInvalid;
+            memcpy(name, cp, nameLength);
+            name[nameLength] = '\0';
+            cp += nameLength;
+            uint8_t channel = UINT8_MAX;
+            for (uint8_t i = 0; i < numChannels; i++)
+                if (0 == strcmp(channels[i].name, name)) channel = i;
+            if (UINT8_MAX == channel) goto argInvalid;
+            Subscription *sub = nullptr;
+            Subscription *freeSlot = nullptr;
+            for (uint8_t i = 0; i < ATOLL_API_MAX_SUBSCRIPTIONS; i++) {
+                if (channel == c->subs[i].channel) sub = &c->subs[i];
+                if (nullptr == freeSlot && UINT8_MAX == c->subs[i].channel) freeSlot = &c->subs[i];
             }
-            // log_d("reply: '%s', msg.replyLength: %d, replyTextLength: %d, replyDataLength: %d",
-            //       reply, msg.replyLength, replyTextLength, replyDataLength);
-            // using memcpy to deal with binary data
-            memcpy(reply + replyTextLength, msg.reply, replyDataLength);
-            replyLength = replyTextLength + replyDataLength;
-        } else {  // in case of an error we append the arg
-            msg.replyAppend(msg.arg);
-            replyLength = strlen(reply);
+            if (unsubscribe) {
+                if ('\0' != *cp) goto argInvalid;
+                if (nullptr != sub) *sub = Subscription();
+            } else {
+                if (':' != *cp) goto argInvalid;
+                cp++;
+                int interval = atoi(cp);
+                if (interval < 1 || UINT16_MAX < interval) goto argInvalid;
+                if (interval < ATOLL_API_SUB_MIN_INTERVAL) interval = ATOLL_API_SUB_MIN_INTERVAL;
+                float threshold = 0.0f;
+                cp = strchr(cp, ':');
+                if (nullptr != cp) threshold = atof(cp + 1);
+                if (threshold < 0.0f) goto argInvalid;
+                if (nullptr == sub) sub = freeSlot;
+                if (nullptr == sub) {
+                    log_e("client %d has no free subscription slot", msg->clientId);
+                    snprintf(msg->reply, msgReplyLength, "max %d subscriptions", ATOLL_API_MAX_SUBSCRIPTIONS);
+                    return error();
+                }
+                *sub = Subscription();
+                sub->channel = channel;
+                sub->interval = (uint16_t)interval;
+                sub->threshold = threshold;
+            }
+        }
+    }
+    // list subscriptions
+    if (nullptr != c) {
+        char token[ATOLL_API_COMMAND_NAME_LENGTH + 20];
+        for (uint8_t i = 0; i < ATOLL_API_MAX_SUBSCRIPTIONS; i++) {
+            Subscription *sub = &c->subs[i];
+            if (UINT8_MAX == sub->channel) continue;
+            if (0.0f < sub->threshold)
+                snprintf(token, sizeof(token), "%s:%d:%.2f;",
+                         channels[sub->channel].name, sub->interval, sub->threshold);
+            else
+                snprintf(token, sizeof(token), "%s:%d;",
+                         channels[sub->channel].name, sub->interval);
+            msg->replyAppend(token);
+        }
+    }
+    return success();
+
+argInvalid:
+    msg->replyAppend("channel:intervalMs[:threshold]|-channel|-*, channels: ");
+    for (uint8_t i = 0; i < numChannels; i++) {
+        if (0 < i) msg->replyAppend("|");
+        msg->replyAppend(channels[i].name);
+    }
+    return argInvalid();
+}
+
+// FNV-1a
+uint32_t Api::hash(const char *str) {
+    uint32_t h = 2166136261UL;
+    while (*str) {
+        h ^= (uint8_t)*str++;
+        h *= 16777619UL;
+    }
+    return h;
+}
+
+// Sends the due telemetry channels to the subscribed clients, coalesced into
+// one notification per client in the format: resultCode;subCode=channel=value;...
+void Api::processSubscriptions() {
+    if (0 == numChannels) return;
+    Command *subCommand = nullptr;
+    ulong t = millis();
+    // sample each channel at most once per round
+    char values[ATOLL_API_MAX_CHANNELS][ATOLL_API_CHANNEL_VALUE_LENGTH];
+    float numeric[ATOLL_API_MAX_CHANNELS];
+    enum { notSampled,
+           available,
+           unavailable } state[ATOLL_API_MAX_CHANNELS];
+    for (uint8_t i = 0; i < numChannels; i++) state[i] = notSampled;
+    for (uint8_t ci = 0; ci < ATOLL_API_MAX_CLIENTS; ci++) {
+        Client *c = &clients[ci];
+        if (nullptr == c->transport) continue;
+        char out[ATOLL_API_MSG_REPLY_LENGTH] = "";
+        size_t outLength = 0;
+        for (uint8_t si = 0; si < ATOLL_API_MAX_SUBSCRIPTIONS; si++) {
+            Subscription *sub = &c->subs[si];
+            if (numChannels <= sub->channel) continue;
+            Channel *ch = &channels[sub->channel];
+            uint32_t changes = ch->changes;
+            bool forced = changes != sub->changes;
+            if (!forced && t - sub->lastSent < sub->interval) continue;
+            if (notSampled == state[sub->channel]) {
+                numeric[sub->channel] = NAN;
+                state[sub->channel] =
+                    ch->sampler(values[sub->channel], sizeof(values[0]), &numeric[sub->channel])
+                        ? available
+                        : unavailable;
+            }
+            if (unavailable == state[sub->channel]) continue;
+            float value = numeric[sub->channel];
+            uint32_t valueHash = hash(values[sub->channel]);
+            if (!forced && 0.0f < sub->threshold) {
+                bool unchanged = isnan(value) || isnan(sub->lastValue)
+                                     ? valueHash == sub->lastHash
+                                     : fabsf(value - sub->lastValue) < sub->threshold;
+                if (unchanged) {
+                    sub->lastSent = t;
+                    continue;
+                }
+            }
+            if (0 == outLength) {
+                if (nullptr == subCommand) subCommand = command("sub", false);
+                if (nullptr == subCommand) return;
+                outLength = snprintf(out, sizeof(out), "%d;%d=", success()->code, subCommand->code);
+            }
+            int written = snprintf(out + outLength, sizeof(out) - outLength, "%s=%s;",
+                                   ch->name, values[sub->channel]);
+            if (written < 0 || sizeof(out) - outLength <= (size_t)written) {
+                // does not fit, will be sent in the next round
+                out[outLength] = '\0';
+                break;
+            }
+            outLength += written;
+            sub->lastSent = t;
+            sub->lastValue = value;
+            sub->lastHash = valueHash;
+            sub->changes = changes;
         }
-        // log_d("apiRxChar reply(%d): %s", replyLength, reply);
+        if (0 < outLength) c->transport->send(c->id, (uint8_t *)out, outLength);
+    }
+}
 
+// ApiTransport: sends data to a BLE client, fragmented if the client accepts fragments.
+// Otherwise the value of the TX char is set, so the client can read the full
+// value when the notification is truncated to the MTU. Only the worker task
+// sends fragments, the other tasks only send short results.
+bool Api::send(uint16_t connHandle, const uint8_t *data, size_t size) {
 #ifdef FEATURE_BLE_SERVER
-        if (bleServer)
-            bleServer->notify(
-                serviceUuid,
-                BLEUUID(API_TX_CHAR_UUID),
-                (uint8_t *)reply,
-                replyLength);
-#endif
-        return;
+    if (!bleServer) return false;
+    Client *c = isWorker() ? client(this, connHandle) : nullptr;
+    if (nullptr != c && c->fragment) {
+        sendFragmented(connHandle, data, size);
+        return true;
     }
+    if (UINT16_MAX == connHandle) {
+        bleServer->notify(serviceUuid, BLEUUID(API_TX_CHAR_UUID), (uint8_t *)data, size);
+        return true;
+    }
+    BLECharacteristic *tx = bleServer->getChar(serviceUuid, BLEUUID(API_TX_CHAR_UUID));
+    if (nullptr == tx) return false;
+    tx->setValue(data, size);
+    bleServer->notify(serviceUuid, BLEUUID(API_TX_CHAR_UUID), (uint8_t *)data, size, connHandle);
+    return true;
+#else
+    return false;
+#endif
+}
+
+size_t Api::maxReplySize(uint16_t connHandle) {
+    Client *c = isWorker() ? client(this, connHandle) : nullptr;
+    if (nullptr != c && c->fragment) return ATOLL_API_FRAGMENTED_REPLY_LENGTH;
 #ifdef FEATURE_BLE_SERVER
-    BleCharacteristicCallbacks::onWrite(c, connInfo);
+    return ATOLL_BLE_SERVER_CHAR_VALUE_MAXLENGTH;
+#else
+    return ATOLL_API_MSG_REPLY_LENGTH;
 #endif
 }
 
 #ifdef FEATURE_BLE_SERVER
+// BleCharacteristicCallbacks
+// runs in the BLE host task: only queue the frame, the worker task will process it
+void Api::onWrite(BLECharacteristic *c, BLEConnInfo &connInfo) {
+    if (c->getUUID().equals(BLEUUID(API_RX_CHAR_UUID))) {
+        BLEAttValue value = c->getValue();
+        receive(this, connInfo.getConnHandle(), value.c_str(), value.length());
+        return;
+    }
+    BleCharacteristicCallbacks::onWrite(c, connInfo);
+}
+
+void Api::onSubscribe(BLECharacteristic *c, BLEConnInfo &connInfo, uint16_t subValue) {
+    // forget the client's settings when it unsubscribes or disconnects
+    if (0 == subValue && c->getUUID().equals(BLEUUID(API_TX_CHAR_UUID)))
+        removeClient(this, connInfo.getConnHandle());
+    BleCharacteristicCallbacks::onSubscribe(c, connInfo, subValue);
+}
+
+// Fragment format: [API_FRAGMENT_MARKER][sequence number][flags]data...
+// The last fragment has the API_FRAGMENT_FLAG_END flag set.
+// Replies that fit in a single notification are sent without the header.
+void Api::sendFragmented(uint16_t connHandle, const uint8_t *data, size_t size) {
+    uint16_t mtu = bleServer->getMTU(connHandle);
+    if (mtu <= 3 + API_FRAGMENT_HEADER_LENGTH) {
+        log_e("invalid mtu %d for client %d", mtu, connHandle);
+        return;
+    }
+    size_t payload = mtu - 3;
+    // a notification that fills the mtu makes the client read the value, which is not set here
+    if (size < payload) {
+        bleServer->notify(serviceUuid, BLEUUID(API_TX_CHAR_UUID), (uint8_t *)data, size, connHandle);
+        return;
+    }
+    if (sizeof(packetBuffer) < payload) payload = sizeof(packetBuffer);
+    size_t chunk = payload - API_FRAGMENT_HEADER_LENGTH;
+    uint8_t *fragment = packetBuffer;
+    uint8_t seq = 0;
+    size_t sent = 0;
+    while (sent < size) {
+        size_t length = size - sent < chunk ? size - sent : chunk;
+        fragment[0] = API_FRAGMENT_MARKER;
+        fragment[1] = seq++;
+        fragment[2] = sent + length < size ? 0 : API_FRAGMENT_FLAG_END;
+        memcpy(fragment + API_FRAGMENT_HEADER_LENGTH, data + sent, length);
+        bleServer->notify(serviceUuid, BLEUUID(API_TX_CHAR_UUID), fragment,
+                          API_FRAGMENT_HEADER_LENGTH + length, connHandle);
+        sent += length;
+        if (sent < size && 0 < ATOLL_API_FRAGMENT_INTERVAL) delay(ATOLL_API_FRAGMENT_INTERVAL);
+    }
+    // log_d("sent %d bytes in %d fragments to client %d", size, seq, connHandle);
+}
+
+// called with the log mutex held, must not log
 void Api::onLogWrite(const char *buf, size_t size) {
-#ifndef FEATURE_BLELOG
-    return;
-#endif
-    BLECharacteristic *logChar = bleServer->getChar(serviceUuid, BLEUUID(API_LOG_CHAR_UUID));
-    if (nullptr == logChar) {
-#ifdef FEATURE_SERIAL
-        Serial.print("[Api::onLogWrite] Error: could not get char\n");
+#ifdef FEATURE_BLELOG
+    if (nullptr == logChar) return;
+    ulong t = millis();
+    portENTER_CRITICAL(&logMux);
+    size_t space = sizeof(logBuffer) - logBuffered;
+    size_t length = size < space ? size : space;
+    if (0 == logBuffered) logBufferedSince = t;
+    memcpy(logBuffer + logBuffered, buf, length);
+    logBuffered += length;
+    logStats.dropped += size - length;
+    portEXIT_CRITICAL(&logMux);
 #endif
+}
+
+#ifdef FEATURE_BLELOG
+// Notifies the buffered log output in packets of the smallest mtu of the
+// connected clients. A packet is sent when it is full or when the output has
+// waited for ATOLL_API_LOG_FLUSH_INTERVAL. At most ATOLL_API_LOG_MAX_PACKETS
+// are sent per call so log output does not delay the API and sensor traffic,
+// the rest stays in the buffer and new output is dropped when it is full.
+void Api::flushLog() {
+    if (nullptr == logChar || 0 == logBuffered) return;
+    if (0 == logChar->getSubscribedCount()) {
+        portENTER_CRITICAL(&logMux);
+        logBuffered = 0;
+        portEXIT_CRITICAL(&logMux);
         return;
     }
-    logChar->setValue((uint8_t *)buf, size);
-    logChar->notify();
+    uint16_t mtu = bleServer->getMinMTU();
+    if (mtu <= 3) return;
+    size_t payload = mtu - 3;
+    if (sizeof(packetBuffer) < payload) payload = sizeof(packetBuffer);
+    uint8_t *packet = packetBuffer;
+    for (uint8_t i = 0; i < ATOLL_API_LOG_MAX_PACKETS; i++) {
+        ulong t = millis();
+        size_t length = 0;
+        portENTER_CRITICAL(&logMux);
+        if (payload <= logBuffered || (0 < logBuffered && ATOLL_API_LOG_FLUSH_INTERVAL <= t - logBufferedSince)) {
+            length = logBuffered < payload ? logBuffered : payload;
+            memcpy(packet, logBuffer, length);
+            logBuffered -= length;
+            memmove(logBuffer, logBuffer + length, logBuffered);
+            logBufferedSince = t;
+        }
+        portEXIT_CRITICAL(&logMux);
+        if (0 == length) break;
+        logChar->setValue(packet, length);
+        logChar->notify();
+        logStats.sent += length;
+        logStats.packets++;
+    }
+    uint32_t dropped = logStats.dropped;
+    if (logReportedDropped != dropped && logBuffered < sizeof(logBuffer) / 2) {
+        // note the gap in the stream
+        char note[48];
+        int length = snprintf(note, sizeof(note), "[Api] %u log bytes dropped\r\n",
+                              dropped - logReportedDropped);
+        logReportedDropped = dropped;
+        if (0 < length) onLogWrite(note, (size_t)length < sizeof(note) ? length : sizeof(note) - 1);
+    }
 }
+#endif
 #endif  // FEATURE_BLE_SERVER
 
 #endif  //  FEATURE_API
@@ -5,6 +5,9 @@
 #include <CircularBuffer.h>
 
 #include "atoll_preferences.h"
+#include "atoll_task.h"
+#include "atoll_api_transport.h"
+#include "atoll_mpsc_ring.h"
 
 #ifdef FEATURE_BLE_SERVER
 #include "atoll_ble_server.h"
@@ -42,9 +45,69 @@
 #ifndef ATOLL_API_MAX_RESULTS
 #define ATOLL_API_MAX_RESULTS 16
 #endif
+#ifndef ATOLL_API_BATCH_MAX_COMMANDS
+#define ATOLL_API_BATCH_MAX_COMMANDS 16  // max number of commands in a batch frame
+#endif
+#ifndef ATOLL_API_BATCH_SEPARATOR
+#define ATOLL_API_BATCH_SEPARATOR '\n'  // separates commands in a batch frame and replies in a batch reply
+#endif
+#ifndef ATOLL_API_TASK_FREQ
+#define ATOLL_API_TASK_FREQ 10  // worker task frequency, the worker also wakes up when a command is queued
+#endif
+#ifndef ATOLL_API_TASK_STACK
+#define ATOLL_API_TASK_STACK 8192
+#endif
+#ifndef ATOLL_API_QUEUE_LENGTH
+#define ATOLL_API_QUEUE_LENGTH 8  // max number of frames waiting for the worker
+#endif
+#ifndef ATOLL_API_COMMAND_TIMEOUT
+#define ATOLL_API_COMMAND_TIMEOUT 5000  // default max time in ms a command can wait in the queue
+#endif
+#ifndef ATOLL_API_CORRELATION_ID_LENGTH
+#define ATOLL_API_CORRELATION_ID_LENGTH 9  // max length of the optional "[id]" request prefix + 1
+#endif
+#ifndef ATOLL_API_MAX_CLIENTS
+#define ATOLL_API_MAX_CLIENTS 3
+#endif
+#ifndef ATOLL_API_REMOVED_CLIENTS
+#define ATOLL_API_REMOVED_CLIENTS 8  // power of 2, disconnected clients waiting to be removed by the worker
+#endif
+#ifndef ATOLL_API_FRAGMENTED_REPLY_LENGTH
+#define ATOLL_API_FRAGMENTED_REPLY_LENGTH 1024  // max reply length for clients that accept fragmented replies
+#endif
+#ifndef ATOLL_API_MAX_REPLY_LENGTH
+#define ATOLL_API_MAX_REPLY_LENGTH ATOLL_API_FRAGMENTED_REPLY_LENGTH  // size of the reply buffers of the worker task
+#endif
+#ifndef ATOLL_API_PACKET_LENGTH
+#define ATOLL_API_PACKET_LENGTH 509  // max payload of a notification, larger mtus are not used
+#endif
+#ifndef ATOLL_API_FRAGMENT_INTERVAL
+#define ATOLL_API_FRAGMENT_INTERVAL 2  // delay in ms between sending fragments
+#endif
+#ifndef ATOLL_API_MAX_CHANNELS
+#define ATOLL_API_MAX_CHANNELS 16  // max number of telemetry channels
+#endif
+#ifndef ATOLL_API_MAX_SUBSCRIPTIONS
+#define ATOLL_API_MAX_SUBSCRIPTIONS 4  // max number of telemetry subscriptions per client
+#endif
+#ifndef ATOLL_API_SUB_MIN_INTERVAL
+#define ATOLL_API_SUB_MIN_INTERVAL 100  // min telemetry subscription interval in ms
+#endif
+#ifndef ATOLL_API_CHANNEL_VALUE_LENGTH
+#define ATOLL_API_CHANNEL_VALUE_LENGTH 32  // max length of a telemetry channel value
+#endif
 #ifndef ATOLL_API_PASSKEY
 #define ATOLL_API_PASSKEY 696669
 #endif
+#ifndef ATOLL_API_LOG_BUFFER_SIZE
+#define ATOLL_API_LOG_BUFFER_SIZE 2048  // bytes of log output waiting to be notified on the log char
+#endif
+#ifndef ATOLL_API_LOG_FLUSH_INTERVAL
+#define ATOLL_API_LOG_FLUSH_INTERVAL 100  // ms, max time log output waits for a full packet
+#endif
+#ifndef ATOLL_API_LOG_MAX_PACKETS
+#define ATOLL_API_LOG_MAX_PACKETS 4  // max number of log notifications per loop
+#endif
 
 #ifndef API_SERVICE_UUID
 #if API_SERVICE == 1
@@ -66,7 +129,13 @@
 
 namespace Atoll {
 
-class Api : public Preferences, public BleCharacteristicCallbacks {
+// The Api dispatcher is also the BLE transport
+class Api : public Preferences,
+#ifdef FEATURE_BLE_SERVER
+            public BleCharacteristicCallbacks,
+#endif
+            public Task,
+            public ApiTransport {
    public:
     struct Result {
        public:
@@ -78,12 +147,15 @@ class Api : public Preferences, public BleCharacteristicCallbacks {
 
     struct Message {
        public:
-        uint8_t commandCode;
+        uint8_t commandCode = 0;
         char arg[ATOLL_API_MSG_ARG_LENGTH] = "";
         Result *result;
         char reply[ATOLL_API_MSG_REPLY_LENGTH] = "";
-        size_t replyLength = 0;  // the actual length of the reply when it contains binary data
-        bool log = true;         // set false to suppress logging when processing messages
+        size_t replyLength = 0;             // the actual length of the reply when it contains binary data
+        bool log = true;                    // set false to suppress logging when processing messages
+        ApiTransport *transport = nullptr;  // the transport the message was received on
+        uint16_t clientId = UINT16_MAX;     // the client that sent the message, UINT16_MAX: none
+        size_t maxReplySize = 0;            // space for the formatted reply incl. nul, 0: not limited by the transport
 
         bool argIs(const char *str);
         bool argStartsWith(const char *str);
@@ -92,6 +164,9 @@ class Api : public Preferences, public BleCharacteristicCallbacks {
         size_t replyAppend(const char *str, bool onlyIfNotEmpty = false);
     };
 
+    // receives a chunk of the reply to a batch
+    typedef std::function<void(const char *buf, size_t size)> ReplyWriter;
+
     // typedef Result *(*Processor)(Message *);
     typedef std::function<Result *(Message *)> Processor;
 
@@ -100,15 +175,93 @@ class Api : public Preferences, public BleCharacteristicCallbacks {
         uint8_t code;
         char name[ATOLL_API_COMMAND_NAME_LENGTH];
         Processor processor;
+        uint32_t timeout;  // max time in ms the command can wait in the queue, 0: ATOLL_API_COMMAND_TIMEOUT
+        // whether init may return the cached value instead of calling the processor,
+        // the command must call Api::invalidate() whenever its value changes
+        bool cache;
+
+        // snapshot of the value returned without an argument, used by init
+        char *cached = nullptr;      // heap allocated, nullptr: not cached
+        bool cachedSuccess = false;  // whether the cached value was returned with success
+        bool stale = true;           // the cached value needs to be refreshed
+        uint32_t version = 0;        // snapshot version when the cached value last changed
 
         Command(const char *name = "",
                 Processor processor = nullptr,
-                uint8_t code = 0);
+                uint8_t code = 0,
+                uint32_t timeout = 0,
+                bool cache = false);
 
         Result *call(Message *msg);
     };
 
+    // a frame received from a client, waiting to be processed by the worker task
+    struct QueueItem {
+        char correlationId[ATOLL_API_CORRELATION_ID_LENGTH] = "";  // echoed in the reply as "[id]"
+        char frame[ATOLL_API_COMMAND_STR_LENGTH] = "";            // command or batch
+        uint16_t length = 0;                                      //
+        uint8_t commandCode = 0;                                  // 0 for batches and unknown commands
+        ulong enqueued = 0;                                       // millis() when queued
+        ulong deadline = 0;                                       // millis() after which the frame expires
+        ApiTransport *transport = nullptr;                        // the transport the frame was received on
+        uint16_t clientId = UINT16_MAX;                           // UINT16_MAX: none
+    };
+
+    struct QueueStats {
+        uint32_t processed = 0;     // number of frames processed
+        uint32_t dropped = 0;       // number of frames dropped because the queue was full
+        uint32_t expired = 0;       // number of frames not processed because of the deadline
+        uint8_t maxDepth = 0;       // max number of frames waiting
+        uint64_t totalLatency = 0;  // ms from enqueue to reply, sum
+        uint32_t maxLatency = 0;    // ms from enqueue to reply, max
+    };
+
+    // writes the current value of a telemetry channel to buf and its numeric value
+    // to value (NAN if not numeric), returns false if the value is not available
+    typedef std::function<bool(char *buf, size_t size, float *value)> Sampler;
+
+    // a named telemetry channel that clients can subscribe to
+    struct Channel {
+       public:
+        char name[ATOLL_API_COMMAND_NAME_LENGTH];
+        Sampler sampler;
+        uint32_t changes = 0;  // incremented by channelChanged(), forces the next update of each subscription
+
+        Channel(const char *name = "", Sampler sampler = nullptr);
+    };
+
+    struct Subscription {
+        uint8_t channel = UINT8_MAX;  // index in channels, UINT8_MAX: unused slot
+        uint16_t interval = 0;        // ms
+        float threshold = 0.0f;       // min change of the numeric value, 0: send every interval
+        ulong lastSent = 0;           // ms
+        float lastValue = NAN;        // last sent numeric value
+        uint32_t lastHash = 0;        // hash of the last sent value
+        uint32_t changes = 0;         // the changes of the channel when last sent
+    };
+
+    // a client of one of the transports, the table is only accessed by the worker task
+    struct Client {
+        ApiTransport *transport = nullptr;  // nullptr: unused slot
+        uint16_t id = UINT16_MAX;           // client ID on the transport, BLE: connection handle
+        bool fragment = false;              // whether the client accepts fragmented replies
+        Subscription subs[ATOLL_API_MAX_SUBSCRIPTIONS];
+    };
+
     static Api *instance;
+    static Client clients[ATOLL_API_MAX_CLIENTS];
+    static QueueHandle_t queue;
+    static QueueStats queueStats;
+
+#if defined(FEATURE_BLE_SERVER) && defined(FEATURE_BLELOG)
+    struct LogStats {
+        uint32_t sent = 0;     // number of bytes notified
+        uint32_t packets = 0;  // number of notifications
+        uint32_t dropped = 0;  // number of bytes dropped because the buffer was full
+    };
+
+    static LogStats logStats;
+#endif
 
 #ifdef FEATURE_BLE_SERVER
     static Atoll::BleServer *bleServer;
@@ -119,9 +272,9 @@ class Api : public Preferences, public BleCharacteristicCallbacks {
 
     static void setup(Api *instance,
                       ::Preferences *p,
-                      const char *preferencesNS,
-
+                      const char *preferencesNS
 #ifdef FEATURE_BLE_SERVER
+                      ,
                       BleServer *bleServer = nullptr,
                       const char *serviceUuid = nullptr
 #endif
@@ -134,7 +287,37 @@ class Api : public Preferences, public BleCharacteristicCallbacks {
 
     static bool addCommand(Command command);
     static bool addResult(Result result);
-    static Message process(const char *commandWithArg, bool log = true);
+    static bool addChannel(Channel channel);
+    static void channelChanged(const char *name);
+    static void invalidate(const char *name);
+    static void invalidateAll();
+    static Message process(const char *commandWithArg,
+                           bool log = true,
+                           ApiTransport *transport = nullptr,
+                           uint16_t clientId = UINT16_MAX,
+                           size_t maxReplySize = 0);
+    static uint8_t processBatch(const char *batch,
+                                size_t length,
+                                ReplyWriter writer,
+                                size_t maxChunkSize = ATOLL_API_MSG_REPLY_LENGTH,
+                                bool log = true,
+                                ApiTransport *transport = nullptr,
+                                uint16_t clientId = UINT16_MAX);
+    static bool isBatch(const char *frame, size_t length);
+    static bool receive(ApiTransport *transport, uint16_t clientId, const char *frame, size_t length);
+    static bool prepareItem(QueueItem *item,
+                            const char *frame,
+                            size_t length,
+                            ApiTransport *transport,
+                            uint16_t clientId);
+    static bool enqueue(QueueItem *item);
+    static void processItem(QueueItem *item);
+    static void sendReply(QueueItem *item, const char *buf, size_t size);
+    static void sendResult(QueueItem *item, Result *result);
+    static bool isWorker();
+    static Client *client(ApiTransport *transport, uint16_t clientId, bool create = false);
+    static void removeClient(ApiTransport *transport, uint16_t clientId);
+    static size_t formatReply(Message *msg, char *buf, size_t size);
 
     static Result *result(uint8_t code, bool logOnError = true);
     static Result *result(const char *name, bool logOnError = true);
@@ -157,11 +340,20 @@ class Api : public Preferences, public BleCharacteristicCallbacks {
 
     static bool isAlNumStr(const char *str);
 
+    const char *taskName() { return "Api"; }
+    void loop() override;
+
+    // ApiTransport
+    const char *transportName() override { return "BLE"; }
+    bool send(uint16_t connHandle, const uint8_t *data, size_t size) override;
+    size_t maxReplySize(uint16_t connHandle) override;
+
     static size_t write(const uint8_t *buffer, size_t size);
 
 #ifdef FEATURE_BLE_SERVER
     // BleCharacteristicCallbacks
     void onWrite(BLECharacteristic *c, BLEConnInfo &connInfo) override;
+    void onSubscribe(BLECharacteristic *c, BLEConnInfo &connInfo, uint16_t subValue) override;
 
     void notifyTxChar(const char *str);
 #endif
@@ -173,11 +365,54 @@ class Api : public Preferences, public BleCharacteristicCallbacks {
     static uint8_t numCommands;
     static Result results[ATOLL_API_MAX_RESULTS];
     static uint8_t numResults;
+    static Channel channels[ATOLL_API_MAX_CHANNELS];
+    static uint8_t numChannels;
+    static uint32_t snapshotVersion;
+
+    // buffers of the worker task
+    static char replyBuffer[ATOLL_API_MAX_REPLY_LENGTH];
+    static char chunkBuffer[ATOLL_API_MAX_REPLY_LENGTH];
+    static char sendBuffer[ATOLL_API_MAX_REPLY_LENGTH];
+#ifdef FEATURE_BLE_SERVER
+    static uint8_t packetBuffer[ATOLL_API_PACKET_LENGTH];  // a fragment or a log packet
+#endif
+
+#if defined(FEATURE_BLE_SERVER) && defined(FEATURE_BLELOG)
+    // log output is coalesced into packets of the smallest mtu, the stream is
+    // split at packet boundaries regardless of line endings
+    static BLECharacteristic *logChar;
+    static char logBuffer[ATOLL_API_LOG_BUFFER_SIZE];
+    static size_t logBuffered;
+    static ulong logBufferedSince;  // millis() when the buffer was last empty or flushed
+    static uint32_t logReportedDropped;
+    static portMUX_TYPE logMux;
+#endif
 
     static Result *initProcessor(Message *msg);
+    static void refreshSnapshot(Command *c);
     static Result *systemProcessor(Message *msg);
+    static Result *subProcessor(Message *msg);
+    static Result *logProcessor(Message *msg);
+
+    // a client that disconnected, see removeClient()
+    struct ClientRef {
+        ApiTransport *transport = nullptr;
+        uint16_t id = UINT16_MAX;
+    };
+
+    static MpscRing<ClientRef, ATOLL_API_REMOVED_CLIENTS> removedClients;
+    static void removeClients();
+
+    static void processSubscriptions();
+    static uint32_t hash(const char *str);
 
     static void onLogWrite(const char *buf, size_t size);
+#ifdef FEATURE_BLE_SERVER
+#ifdef FEATURE_BLELOG
+    static void flushLog();
+#endif
+    static void sendFragmented(uint16_t connHandle, const uint8_t *data, size_t size);
+#endif
 
    private:
 };
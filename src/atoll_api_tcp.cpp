@@ -0,0 +1,179 @@
+#if defined(FEATURE_API_TCP) && defined(FEATURE_API) && defined(FEATURE_WIFI)
+
+#include "atoll_api_tcp.h"
+
+using namespace Atoll;
+
+void ApiTcp::setup(uint16_t port,
+                   float taskFreq,
+                   uint32_t taskStack) {
+    if (0 < port) this->port = port;
+    taskSetFreq(0.0 < taskFreq ? taskFreq : ATOLL_API_TCP_TASK_FREQ);
+    taskSetStack(0 < taskStack ? taskStack : ATOLL_API_TCP_TASK_STACK);
+    server = WiFiServer(this->port, ATOLL_API_TCP_MAX_CLIENTS);
+}
+
+void ApiTcp::loop() {
+    if (WiFi.getMode() == WIFI_MODE_NULL) {
+        log_i("Wifi is disabled, task should be stopped");
+        return;
+    }
+    if (!WiFi.isConnected() && !WiFi.softAPgetStationNum()) return;
+    if (pdTRUE != xSemaphoreTakeRecursive(mutex, (TickType_t)100)) return;
+    accept();
+    for (uint16_t i = 0; i < ATOLL_API_TCP_MAX_CLIENTS; i++) {
+        Client *c = &clients[i];
+        if (!c->connected) continue;
+        if (!c->client.connected()) {
+            disconnect(i);
+            continue;
+        }
+        receive(i);
+        // lastReceived may have been set by receive()
+        if ((0 < c->headerReceived) && ATOLL_API_TCP_FRAME_TIMEOUT < millis() - c->lastReceived) {
+            log_w("client %d: incomplete frame timed out, received %d of %d bytes",
+                  i, c->received, c->expected);
+            c->headerReceived = 0;
+            c->expected = 0;
+            c->received = 0;
+        }
+    }
+    xSemaphoreGiveRecursive(mutex);
+}
+
+void ApiTcp::start() {
+    server.begin(port);
+    server.setNoDelay(true);
+    if (!taskRunning()) taskStart();
+}
+
+void ApiTcp::stop() {
+    log_i("Shutting down");
+    taskStop();
+    if (pdTRUE == xSemaphoreTakeRecursive(mutex, (TickType_t)100)) {
+        for (uint16_t i = 0; i < ATOLL_API_TCP_MAX_CLIENTS; i++)
+            if (clients[i].connected) disconnect(i);
+        xSemaphoreGiveRecursive(mutex);
+    }
+    server.end();
+}
+
+// called with the mutex held
+void ApiTcp::accept() {
+    while (server.hasClient()) {
+        WiFiClient incoming = server.available();
+        if (!incoming) return;
+        uint16_t id = UINT16_MAX;
+        for (uint16_t i = 0; i < ATOLL_API_TCP_MAX_CLIENTS; i++)
+            if (!clients[i].connected) {
+                id = i;
+                break;
+            }
+        if (UINT16_MAX == id) {
+            log_w("no slot for client %s", incoming.remoteIP().toString().c_str());
+            incoming.stop();
+            continue;
+        }
+        Client *c = &clients[id];
+        uint16_t session = UINT16_MAX == c->id ? 0 : c->id / ATOLL_API_TCP_MAX_CLIENTS + 1;
+        if (UINT16_MAX / ATOLL_API_TCP_MAX_CLIENTS <= session) session = 0;
+        c->id = session * ATOLL_API_TCP_MAX_CLIENTS + id;
+        c->client = incoming;
+        c->client.setNoDelay(true);
+        c->connected = true;
+        c->headerReceived = 0;
+        c->expected = 0;
+        c->received = 0;
+        c->lastReceived = millis();
+        log_i("client %d connected from %s", c->id, c->client.remoteIP().toString().c_str());
+        if (nullptr != onClientConnected) onClientConnected(c->id);
+    }
+}
+
+// called with the mutex held
+void ApiTcp::receive(uint16_t slot) {
+    Client *c = &clients[slot];
+    while (0 < c->client.available()) {
+        c->lastReceived = millis();
+        if (c->headerReceived < sizeof(c->header)) {
+            int b = c->client.read();
+            if (b < 0) return;
+            c->header[c->headerReceived++] = (uint8_t)b;
+            if (c->headerReceived < sizeof(c->header)) continue;
+            c->expected = c->header[0] | (c->header[1] << 8);
+            c->received = 0;
+            if (0 == c->expected) c->headerReceived = 0;  // empty frame: keepalive
+            continue;
+        }
+        size_t remaining = c->expected - c->received;
+        int read;
+        if (c->received < sizeof(c->frame)) {
+            size_t space = sizeof(c->frame) - c->received;
+            read = c->client.read((uint8_t *)c->frame + c->received,
+                                  remaining < space ? remaining : space);
+        } else {
+            // frame too long, discard the rest
+            uint8_t discard[32];
+            read = c->client.read(discard, remaining < sizeof(discard) ? remaining : sizeof(discard));
+        }
+        if (read <= 0) return;
+        c->received += read;
+        if (c->received < c->expected) continue;
+        // frame complete
+        uint16_t length = c->expected;
+        c->headerReceived = 0;
+        c->expected = 0;
+        c->received = 0;
+        if (sizeof(c->frame) < length) {
+            log_e("client %d: frame too long: %d", c->id, length);
+            Api::Message msg;
+            msg.result = Api::result("commandTooLong");
+            char reply[4 + ATOLL_API_RESULT_NAME_LENGTH + 5];
+            send(c->id, (uint8_t *)reply, Api::formatReply(&msg, reply, sizeof(reply)));
+            continue;
+        }
+        Api::receive(this, c->id, c->frame, length);
+    }
+}
+
+// called with the mutex held
+void ApiTcp::disconnect(uint16_t slot) {
+    Client *c = &clients[slot];
+    c->client.stop();
+    c->connected = false;
+    c->headerReceived = 0;
+    c->expected = 0;
+    c->received = 0;
+    Api::removeClient(this, c->id);
+    log_i("client %d disconnected", c->id);
+    if (nullptr != onClientDisconnected) onClientDisconnected(c->id);
+}
+
+// ApiTransport: sends a length prefixed frame, called from the Api task
+bool ApiTcp::send(uint16_t clientId, const uint8_t *data, size_t size) {
+    if (UINT16_MAX == clientId) return false;
+    if (UINT16_MAX < size) {
+        log_e("client %d: reply too long: %d", clientId, size);
+        return false;
+    }
+    if (pdTRUE != xSemaphoreTakeRecursive(mutex, (TickType_t)100)) {
+        log_e("client %d: could not get mutex", clientId);
+        return false;
+    }
+    bool sent = false;
+    Client *c = &clients[clientId % ATOLL_API_TCP_MAX_CLIENTS];
+    if (c->connected && clientId == c->id && c->client.connected()) {
+        uint8_t header[2] = {(uint8_t)(size & 0xff), (uint8_t)((size >> 8) & 0xff)};
+        sent = sizeof(header) == c->client.write(header, sizeof(header)) &&
+               size == c->client.write(data, size);
+        if (!sent) log_e("client %d: write failed", clientId);
+    }
+    xSemaphoreGiveRecursive(mutex);
+    return sent;
+}
+
+size_t ApiTcp::maxReplySize(uint16_t clientId) {
+    return ATOLL_API_TCP_MAX_REPLY_LENGTH;
+}
+
+#endif
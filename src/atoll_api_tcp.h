@@ -0,0 +1,80 @@
+#if !defined(__atoll_api_tcp_h) && defined(FEATURE_API_TCP) && defined(FEATURE_API) && defined(FEATURE_WIFI)
+#define __atoll_api_tcp_h
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#include "atoll_task.h"
+#include "atoll_api.h"
+
+#ifndef ATOLL_API_TCP_PORT
+#define ATOLL_API_TCP_PORT 2323
+#endif
+#ifndef ATOLL_API_TCP_MAX_CLIENTS
+#define ATOLL_API_TCP_MAX_CLIENTS 3
+#endif
+#ifndef ATOLL_API_TCP_TASK_FREQ
+#define ATOLL_API_TCP_TASK_FREQ 50
+#endif
+#ifndef ATOLL_API_TCP_TASK_STACK
+#define ATOLL_API_TCP_TASK_STACK 4096
+#endif
+#ifndef ATOLL_API_TCP_MAX_REPLY_LENGTH
+#define ATOLL_API_TCP_MAX_REPLY_LENGTH ATOLL_API_FRAGMENTED_REPLY_LENGTH
+#endif
+#ifndef ATOLL_API_TCP_FRAME_TIMEOUT
+#define ATOLL_API_TCP_FRAME_TIMEOUT 2000  // ms to wait for the rest of an incomplete frame
+#endif
+
+namespace Atoll {
+
+// API transport over TCP.
+// Frame format in both directions: [length LSB][length MSB]data,
+// requests have the same format as on BLE, including batches and the
+// optional correlation id. The client ID is the slot index plus a multiple
+// of ATOLL_API_TCP_MAX_CLIENTS that changes on every connection, so replies
+// queued for a disconnected client are not sent to the next one in the slot.
+class ApiTcp : public Task, public ApiTransport {
+   public:
+    const char *taskName() override { return "ApiTcp"; }
+    const char *transportName() override { return "TCP"; }
+
+    void setup(uint16_t port = 0,
+               float taskFreq = 0.0,
+               uint32_t taskStack = 0);
+    void loop() override;
+    void start();
+    void stop();
+
+    // ApiTransport
+    bool send(uint16_t clientId, const uint8_t *data, size_t size) override;
+    size_t maxReplySize(uint16_t clientId) override;
+
+    std::function<void(uint16_t clientId)> onClientConnected = nullptr;
+    std::function<void(uint16_t clientId)> onClientDisconnected = nullptr;
+
+   protected:
+    struct Client {
+        WiFiClient client;
+        bool connected = false;
+        uint16_t id = UINT16_MAX;                       // client ID of the connection, UINT16_MAX: none yet
+        uint8_t header[2] = {0, 0};
+        uint8_t headerReceived = 0;                     // number of header bytes received
+        char frame[ATOLL_API_COMMAND_STR_LENGTH] = "";  //
+        uint16_t expected = 0;                          // length of the frame being received
+        uint16_t received = 0;                          // number of frame bytes received
+        ulong lastReceived = 0;                         // millis() when the last byte was received
+    } clients[ATOLL_API_TCP_MAX_CLIENTS];
+
+    WiFiServer server;
+    uint16_t port = ATOLL_API_TCP_PORT;
+    SemaphoreHandle_t mutex = xSemaphoreCreateRecursiveMutex();  // send() may be called from receive()
+
+    void accept();
+    void receive(uint16_t slot);
+    void disconnect(uint16_t slot);
+};
+
+}  // namespace Atoll
+
+#endif
@@ -0,0 +1,26 @@
+#if !defined(__atoll_api_transport_h) && defined(FEATURE_API)
+#define __atoll_api_transport_h
+
+#include <Arduino.h>
+
+namespace Atoll {
+
+// Carries API frames between clients and the Api dispatcher.
+// A transport passes complete frames received from its clients to Api::receive()
+// and delivers the replies in send(). Client IDs are local to the transport.
+class ApiTransport {
+   public:
+    virtual ~ApiTransport() {}
+
+    virtual const char *transportName() = 0;
+
+    // delivers a complete reply or notification to the client, framing it as needed
+    virtual bool send(uint16_t clientId, const uint8_t *data, size_t size) = 0;
+
+    // max length of a reply that can be delivered to the client
+    virtual size_t maxReplySize(uint16_t clientId) = 0;
+};
+
+}  // namespace Atoll
+
+#endif
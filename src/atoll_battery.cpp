@@ -39,8 +39,20 @@ void Battery::setup(
 
     if (nullptr == instance) return;
 #ifdef FEATURE_API
-    if (nullptr != api)
-        api->addCommand(Api::Command("bat", batteryProcessor));
+    if (nullptr != api) {
+        api->addCommand(Api::Command("bat", batteryProcessor, 0, 0, true));
+        api->addChannel(Api::Channel("bat", [this](char *buf, size_t size, float *value) {
+            if (voltage < ATOLL_BATTERY_EMPTY) return false;
+            snprintf(buf, size, "%.2f%s", voltage,
+                     csCharging == chargingState
+                         ? "|charging"
+                     : csDischarging == chargingState
+                         ? "|discharging"
+                         : "");
+            *value = voltage;
+            return true;
+        }));
+    }
 #endif
 }
 
@@ -125,6 +137,9 @@ void Battery::loop() {
     detectChargingState();
     calculateLevel();
     report();
+#ifdef FEATURE_API
+    if (oldVoltage != voltage) Api::invalidate("bat");
+#endif
 }
 
 void Battery::detectChargingState() {
@@ -147,6 +162,8 @@ void Battery::detectChargingState() {
         if (csUnknown != chargingState && prevState != chargingState) {
             log_i("%scharging %.2f => %.2f", csCharging == chargingState ? "" : "dis", avg, voltage);
 #ifdef FEATURE_API
+            Api::channelChanged("bat");
+            Api::invalidate("bat");
 #ifdef FEATURE_BLE_SERVER
             if (nullptr == api || nullptr == bleServer) {
                 log_e("api or bleServer is null");
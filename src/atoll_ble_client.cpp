@@ -23,6 +23,11 @@ void BleClient::setup(const char* deviceName, ::Preferences* p
     loadSettings();
     printSettings();
     enabled = true;
+    // the task freq sets the max time between loops, peer connection
+    // events wake the task
+    taskSetWakeOnNotify(true);
+    // the blocking NimBLE client calls must not hold up a shared executor
+    taskSetShared(nullptr);
 
     init();
 
@@ -56,8 +61,14 @@ void BleClient::loop() {
         taskStop();
         return;
     }
-    if (scan->isScanning()) return;
+    if (passiveScanning && !scan->isScanning()) passiveScanning = false;  // stopped by the stack
+    if (scan->isScanning() && !passiveScanning) return;
     ulong t = millis();
+    // the controller takes one connection attempt at a time
+    bool connecting = false;
+    for (int8_t i = 0; i < peersMax && !connecting; i++)
+        if (nullptr != peers[i] && peers[i]->connecting) connecting = true;
+    Peer* next = nullptr;  // the due peer to connect
     for (int8_t i = 0; i < peersMax; i++) {
         if (nullptr == peers[i]) continue;
         // log_d("checking peer %d %s en: %d, isConn:%d shouldConn:%d conning:%d remov:%d",
@@ -84,15 +95,16 @@ void BleClient::loop() {
             log_i("removing peer %s", peers[i]->saved.name);
             removePeer(peers[i], false);
             continue;
-        } else if (peers[i]->enabled &&
-                   peers[i]->shouldConnect &&
-                   !peers[i]->isConnected() &&
-                   !peers[i]->connecting &&
+        } else if (peers[i]->setupPending) {
+            peers[i]->setupConnection();
+        } else if (peers[i]->connectDue(t) &&
                    (0 == peers[i]->lastConnectionAttempt ||
                     peers[i]->lastConnectionAttempt + reconnectDelay < t)) {
-            // log_d("connecting peer %s %s(%d)",
-            //       peers[i]->saved.name, peers[i]->saved.address, peers[i]->saved.addressType);
-            peers[i]->connect();
+            if (nullptr == next ||
+                next->priority < peers[i]->priority ||
+                (next->priority == peers[i]->priority &&
+                 (long)(peers[i]->nextConnectionAttempt - next->nextConnectionAttempt) < 0))
+                next = peers[i];
         } else if ((!peers[i]->enabled ||
                     !peers[i]->shouldConnect) &&
                    peers[i]->isConnected()) {
@@ -102,11 +114,24 @@ void BleClient::loop() {
         } else if (peers[i]->isConnected())
             peers[i]->loop();
     }
+    if (!connecting && nullptr != next) {
+        if (passiveScanning) stopPassiveScan();  // the scanner would hold up the connection
+        // log_d("connecting peer %s %s(%d)",
+        //       next->saved.name, next->saved.address, next->saved.addressType);
+        next->connect();
+    } else if (!connecting && backgroundScan && !passiveScanning)
+        startPassiveScan();
+    if (passiveScanning && !backgroundScan) stopPassiveScan();
+    bool connected = false;
+    for (int8_t i = 0; i < peersMax && !connected; i++)
+        if (nullptr != peers[i] && peers[i]->isConnected()) connected = true;
+    taskSetActivity(TaskActivity::peers, connected);
     // log_i("loop end");
 }
 
 void BleClient::stop() {
     shouldStop = true;
+    taskNotify();
 }
 
 void BleClient::loadSettings() {
@@ -124,12 +149,40 @@ void BleClient::loadSettings() {
         if (Peer::unpack(packed, &saved)) {
             Peer* peer = createPeer(saved);
             if (nullptr == peer) continue;  // delete nullptr should be safe!
-            if (!addPeer(peer)) delete peer;
+            if (!addPeer(peer)) {
+                delete peer;
+                continue;
+            }
+            uint8_t hash[DATABASE_HASH_LENGTH];
+            char hashKey[16] = "";
+            dbHashKey(saved.address, hashKey, sizeof(hashKey));
+            if (sizeof(hash) == preferences->getBytes(hashKey, hash, sizeof(hash)))
+                peer->setSavedDbHash(hash);
         }
     }
     preferencesEnd();
 }
 
+void BleClient::dbHashKey(const char* address, char* key, size_t size) {
+    // "h" and the address without colons, NVS keys are limited to 15 chars
+    size_t len = 0;
+    if (len < size - 1) key[len++] = 'h';
+    for (const char* c = address; *c && len < size - 1; c++)
+        if (':' != *c) key[len++] = *c;
+    key[len] = '\0';
+}
+
+void BleClient::saveDbHash(Peer* peer) {
+    uint8_t hash[DATABASE_HASH_LENGTH];
+    if (!peer->getSavedDbHash(hash)) return;
+    if (!preferencesStartSave()) return;
+    char key[16] = "";
+    dbHashKey(peer->saved.address, key, sizeof(key));
+    log_i("saving %s database hash", peer->saved.name);
+    preferences->putBytes(key, hash, sizeof(hash));
+    preferencesEnd();
+}
+
 void BleClient::saveSettings() {
     if (!preferencesStartSave()) return;
     char key[8] = "";
@@ -137,6 +190,11 @@ void BleClient::saveSettings() {
     char saved[Peer::packedMaxLength] = "";
     for (uint8_t i = 0; i < peersMax; i++) {
         snprintf(key, sizeof(key), "peer%d", i);
+        if (nullptr != peers[i] && peers[i]->markedForRemoval) {
+            char hashKey[16] = "";
+            dbHashKey(peers[i]->saved.address, hashKey, sizeof(hashKey));
+            preferences->remove(hashKey);
+        }
         strncpy(packed, "", sizeof(packed));
         strncpy(saved,
                 preferences->getString(key).c_str(),
@@ -178,13 +236,22 @@ void BleClient::deleteClients() {
         if (nullptr == peers[i]) continue;
         if (peers[i]->hasClient())
             peers[i]->unsetClient();
+        peers[i]->forgetAttributes();
         // peers[i]->deleteClient();
     }
 }
 
 bool BleClient::startScan(uint32_t duration) {
+    if (passiveScanning) stopPassiveScan();
     if (scan->isScanning()) return false;
 
+    // report the cached advertisers again
+    portENTER_CRITICAL(&advertisersMux);
+    for (uint8_t i = 0; i < ATOLL_BLE_CLIENT_ADVERTISERS; i++)
+        advertisers[i].reported = false;
+    portEXIT_CRITICAL(&advertisersMux);
+
+    scan->setScanCallbacks(this, false);
     // scan->setDuplicateFilter(false);
     scan->clearDuplicateCache();
     scan->clearResults();
@@ -197,7 +264,7 @@ bool BleClient::startScan(uint32_t duration) {
     scan->setMaxResults(0);     // do not store the scan results, use callback only.
 
     bool ret = scan->start(duration, false);
-#ifdef FEATURE_API
+#if defined(FEATURE_API) && defined(FEATURE_BLE_SERVER)
     if (nullptr == api) {
         log_e("api is null");
     } else {
@@ -214,6 +281,27 @@ bool BleClient::startScan(uint32_t duration) {
     return ret;
 }
 
+bool BleClient::startPassiveScan() {
+    if (scan->isScanning()) return false;
+    scan->setScanCallbacks(this, true);  // every advertisement refreshes the cache
+    scan->setDuplicateFilter(false);
+    scan->setFilterPolicy(BLE_HCI_SCAN_FILT_NO_WL);
+    scan->setLimitedOnly(false);
+    scan->setActiveScan(false);  // no scan requests, names only from advertisements
+    scan->setInterval(ATOLL_BLE_CLIENT_PASSIVE_SCAN_INTERVAL);
+    scan->setWindow(ATOLL_BLE_CLIENT_PASSIVE_SCAN_WINDOW);
+    scan->setMaxResults(0);
+    passiveScanning = scan->start(0, false);  // until stopped
+    if (!passiveScanning) log_e("could not start passive scan");
+    return passiveScanning;
+}
+
+void BleClient::stopPassiveScan() {
+    if (!passiveScanning) return;
+    scan->stop();
+    passiveScanning = false;
+}
+
 Peer* BleClient::createPeer(Peer::Saved saved) {
     // log_d("creating %s,%d,%s,%s,%d", saved.address, saved.addressType, saved.type, saved.name, saved.passkey);
     if (strstr(saved.type, "E"))
@@ -232,28 +320,95 @@ Peer* BleClient::createPeer(Peer::Saved saved) {
 
 Peer* BleClient::createPeer(BLEAdvertisedDevice* device) {
     Peer::Saved saved = advertisedToSaved(device);
+    strncpy(saved.type, advertisedType(device), sizeof(saved.type));
+    return createPeer(saved);
+}
 
-    if (device->isAdvertisingService(BLEUUID(ESPM_API_SERVICE_UUID))) {
-        strncpy(saved.type, "E", sizeof(saved.type));
-        return new ESPM(saved);
-    }
-    if (device->isAdvertisingService(BLEUUID(CYCLING_POWER_SERVICE_UUID))) {
-        strncpy(saved.type, "P", sizeof(saved.type));
-        return new PowerMeter(saved);
-    }
-    if (device->isAdvertisingService(BLEUUID(HEART_RATE_SERVICE_UUID))) {
-        strncpy(saved.type, "H", sizeof(saved.type));
-        return new HeartrateMonitor(saved);
-    }
-    if (device->isAdvertisingService(BLEUUID(VESC_SERVICE_UUID))) {
-        strncpy(saved.type, "V", sizeof(saved.type));
-        return new Vesc(saved);
-    }
-    if (device->isAdvertisingService(BLEUUID(PeerCharacteristicJkBms::SERVICE_UUID))) {
-        strncpy(saved.type, "B", sizeof(saved.type));
-        return new JkBms(saved);
+const char* BleClient::advertisedType(BLEAdvertisedDevice* device) {
+    if (device->isAdvertisingService(BLEUUID(ESPM_API_SERVICE_UUID))) return "E";
+    if (device->isAdvertisingService(BLEUUID(CYCLING_POWER_SERVICE_UUID))) return "P";
+    if (device->isAdvertisingService(BLEUUID(HEART_RATE_SERVICE_UUID))) return "H";
+    if (device->isAdvertisingService(BLEUUID(VESC_SERVICE_UUID))) return "V";
+    if (device->isAdvertisingService(BLEUUID(PeerCharacteristicJkBms::SERVICE_UUID))) return "B";
+    return "";
+}
+
+BleClient::Advertiser* BleClient::updateAdvertiser(BLEAdvertisedDevice* device, bool* changed) {
+    uint64_t address = device->getAddress().toUint64();
+    if (0 == address) return nullptr;
+    // only the NimBLE host writes the cache, readers use the mux
+    uint32_t hash = (uint32_t)(address ^ (address >> 24)) * 2654435761u;
+    uint8_t home = (hash >> 16) % ATOLL_BLE_CLIENT_ADVERTISERS;
+    Advertiser* slot = nullptr;
+    Advertiser* oldest = nullptr;
+    for (uint8_t i = 0; i < ATOLL_BLE_CLIENT_ADVERTISERS; i++) {
+        Advertiser* a = &advertisers[(home + i) % ATOLL_BLE_CLIENT_ADVERTISERS];
+        if (a->address == address || 0 == a->address) {
+            slot = a;
+            break;
+        }
+        if (nullptr == oldest || (long)(a->lastSeen - oldest->lastSeen) < 0) oldest = a;
+    }
+    if (nullptr == slot) slot = oldest;
+    bool isNew = slot->address != address;
+    const char* type = isNew || !strlen(slot->type) ? advertisedType(device) : slot->type;
+    std::string name = device->haveName() ? device->getName() : "";
+    int16_t rssi = (int16_t)(device->getRSSI() * 16);
+
+    portENTER_CRITICAL(&advertisersMux);
+    if (isNew) {
+        *slot = Advertiser();
+        slot->address = address;
+        slot->addressType = device->getAddress().getType();
+        slot->rssi = rssi;
+        *changed = true;
+    } else
+        slot->rssi += (rssi - slot->rssi) / 4;
+    if (type != slot->type && strlen(type)) {
+        strncpy(slot->type, type, sizeof(slot->type) - 1);
+        *changed = true;
+    }
+    if (name.length() && 0 != strncmp(slot->name, name.c_str(), sizeof(slot->name) - 1)) {
+        strncpy(slot->name, name.c_str(), sizeof(slot->name) - 1);
+        *changed = true;
+    }
+    slot->lastSeen = millis();
+    portEXIT_CRITICAL(&advertisersMux);
+    return slot;
+}
+
+bool BleClient::getAdvertiser(uint64_t address, Advertiser* copy) {
+    bool found = false;
+    portENTER_CRITICAL(&advertisersMux);
+    for (uint8_t i = 0; i < ATOLL_BLE_CLIENT_ADVERTISERS && !found; i++)
+        if (advertisers[i].address == address) {
+            *copy = advertisers[i];
+            found = true;
+        }
+    portEXIT_CRITICAL(&advertisersMux);
+    return found;
+}
+
+void BleClient::reportAdvertiser(BLEAdvertisedDevice* device, Advertiser* advertiser) {
+    if (advertiser->reported || !strlen(advertiser->type) || !strlen(advertiser->name)) return;
+    advertiser->reported = true;
+#if defined(FEATURE_API) && defined(FEATURE_BLE_SERVER)
+    if (nullptr == api) {
+        log_e("api is null");
+        return;
     }
-    return nullptr;
+    char reply[ATOLL_API_MSG_REPLY_LENGTH];
+    snprintf(reply, sizeof(reply), "%d;%d=scanResult:%s,%d,%s,%s",
+             api->success()->code,
+             api->command("peers")->code,
+             device->getAddress().toString().c_str(),
+             advertiser->addressType,
+             advertiser->type,
+             advertiser->name);
+
+    log_i("calling api.notifyTxChar('%s')", reply);
+    api->notifyTxChar(reply);
+#endif
 }
 
 Peer::Saved BleClient::advertisedToSaved(BLEAdvertisedDevice* device) {
@@ -312,7 +467,15 @@ bool BleClient::addPeer(Peer* peer) {
         log_e("cannot add peer %s", peer->saved.name);
         return false;
     }
-    peer->connectedCallback = [this](Peer* peer) { onPeerConnected(peer); };
+    peer->connectedCallback = [this](Peer* peer) {
+        onPeerConnected(peer);
+        taskNotify();
+    };
+    // reconnect without waiting for the next period
+    peer->disconnectedCallback = [this](Peer*) { taskNotify(); };
+    peer->changedCallback = [this](Peer*) { taskNotify(); };
+    peer->dbHashCallback = [this](Peer* peer) { saveDbHash(peer); };
+    taskNotify();
     // log_i("adding peer %s %s(%d)", peer->name, peer->address, peer->addressType);
     peers[index] = peer;
     return true;
@@ -328,6 +491,7 @@ uint8_t BleClient::removePeer(const char* address, bool markOnly) {
             if (markOnly) {
                 peers[i]->markedForRemoval = true;
                 log_d("peer marked for removal: %s", peers[i]->saved.name);
+                taskNotify();
             } else {
                 log_d("deleting peer %s", peers[i]->saved.name);
                 delete peers[i];  // delete nullptr should be safe!
@@ -360,6 +524,7 @@ uint8_t BleClient::setPeerEnabled(const char* name, bool value) {
             changed++;
         }
     }
+    if (0 < changed) taskNotify();
     return changed;
 }
 
@@ -397,46 +562,37 @@ void BleClient::onNotify(BLECharacteristic* pCharacteristic) {
  * device that was found.  During any individual scan, a device will only be detected one time.
  */
 void BleClient::onResult(BLEAdvertisedDevice* advertisedDevice) {
-    log_i("scan found %s", advertisedDevice->toString().c_str());
-
-#ifdef FEATURE_API
-    if (nullptr == api) {
-        log_e("api is null");
-        return;
-    }
-    if (peerExists(advertisedDevice->getAddress().toString().c_str())) {
-        log_i("peer exists");
-        return;
-    }
-    if (advertisedDevice->haveTargetAddress())
-        for (int i = 0; i < advertisedDevice->getTargetAddressCount(); i++)
-            log_i("Target address %i: %s", advertisedDevice->getTargetAddress(i).toString().c_str());
-
-    Peer* peer = createPeer(advertisedDevice);
-    if (nullptr == peer) {
-        log_i("peer %s is null", advertisedDevice->getName().c_str());
+    bool changed = false;
+    Advertiser* advertiser = updateAdvertiser(advertisedDevice, &changed);
+    if (nullptr == advertiser) return;
+    if (changed) log_i("scan found %s", advertisedDevice->toString().c_str());
+
+    // peers waiting for a connection attempt are tried as soon as they are seen
+    bool waiting = false;
+    for (int8_t i = 0; i < peersMax && !waiting; i++)
+        if (nullptr != peers[i] &&
+            peers[i]->enabled &&
+            peers[i]->shouldConnect &&
+            !peers[i]->connecting &&
+            !peers[i]->isConnected())
+            waiting = true;
+    if (!waiting && advertiser->reported) return;
+
+    int8_t index = peerIndex(advertisedDevice->getAddress().toString().c_str());
+    if (0 <= index && nullptr != peers[index]) {
+        advertiser->reported = true;  // nothing to report about peers
+        peers[index]->onSeen();
+        if (peers[index]->connectDue(millis())) taskNotify();
         return;
     }
-
-    char reply[ATOLL_API_MSG_REPLY_LENGTH];
-    snprintf(reply, sizeof(reply), "%d;%d=scanResult:%s,%d,%s,%s",
-             api->success()->code,
-             api->command("peers")->code,
-             peer->saved.address,
-             peer->saved.addressType,
-             peer->saved.type,
-             peer->saved.name);
-
-    log_i("calling api.notifyTxChar('%s')", reply);
-    api->notifyTxChar(reply);
-
-    delete peer;
-#endif
+    reportAdvertiser(advertisedDevice, advertiser);
 }
 
 void BleClient::onScanEnd(BLEScanResults results) {
+    if (passiveScanning) return;  // not reported
     log_i("scan end");
-#ifdef FEATURE_API
+    taskNotify();  // the loop skips the peers while scanning
+#if defined(FEATURE_API) && defined(FEATURE_BLE_SERVER)
     if (nullptr == api) {
         log_e("api is null");
         return;
@@ -475,6 +631,67 @@ Api::Result* BleClient::peersProcessor(Api::Message* msg) {
         snprintf(msg->reply, sizeof(msg->reply), "scan:%d", duration);
         return Api::success();
     }
+    if (msg->argIs("stats")) {
+        // name:state:priority:failures:backoff:reconnects:reconnectTime:firstNotification:discoveries|...
+        msg->reply[0] = '\0';
+        for (int i = 0; i < peersMax; i++) {
+            if (nullptr == peers[i] || peers[i]->markedForRemoval) continue;
+            char token[ATOLL_BLE_PEER_DEVICE_NAME_LENGTH + 64];
+            snprintf(token, sizeof(token), "%s%s:%s:%d:%d:%d:%d:%lu:%lu:%d",
+                     strlen(msg->reply) ? "|" : "",
+                     peers[i]->saved.name,
+                     peers[i]->connectionState(),
+                     peers[i]->priority,
+                     peers[i]->failures.load(),
+                     (int)peers[i]->backoff,
+                     peers[i]->reconnects,
+                     peers[i]->reconnectTime,
+                     peers[i]->firstNotificationTime,
+                     peers[i]->discoveries);
+            if (sizeof(msg->reply) - 1 < strlen(msg->reply) + strlen(token)) {
+                if (msg->log) log_e("no space left for adding '%s'", token);
+                return Api::internalError();
+            }
+            msg->replyAppend(token);
+        }
+        return Api::success();
+    }
+    if (msg->argIs("seen")) {
+        // address,addressType,type,name,rssi,age|...
+        msg->reply[0] = '\0';
+        ulong t = millis();
+        for (uint8_t i = 0; i < ATOLL_BLE_CLIENT_ADVERTISERS; i++) {
+            Advertiser a;
+            portENTER_CRITICAL(&advertisersMux);
+            a = advertisers[i];
+            portEXIT_CRITICAL(&advertisersMux);
+            if (0 == a.address) continue;
+            char token[ATOLL_BLE_PEER_DEVICE_NAME_LENGTH + 48];
+            snprintf(token, sizeof(token), "%s%02x:%02x:%02x:%02x:%02x:%02x,%d,%s,%s,%d,%lu",
+                     strlen(msg->reply) ? "|" : "",
+                     (uint8_t)(a.address >> 40), (uint8_t)(a.address >> 32), (uint8_t)(a.address >> 24),
+                     (uint8_t)(a.address >> 16), (uint8_t)(a.address >> 8), (uint8_t)a.address,
+                     a.addressType,
+                     a.type,
+                     a.name,
+                     a.rssi / 16,
+                     (t - a.lastSeen) / 1000);
+            if (sizeof(msg->reply) - 1 < strlen(msg->reply) + strlen(token)) break;
+            msg->replyAppend(token);
+        }
+        return Api::success();
+    }
+    if (msg->argStartsWith("background")) {
+        if (msg->argIs("background:1") || msg->argIs("background:0")) {
+            backgroundScan = msg->argIs("background:1");
+            taskNotify();
+        } else if (!msg->argIs("background")) {
+            msg->replyAppend("usage: background[:0|1]");
+            return Api::argInvalid();
+        }
+        snprintf(msg->reply, sizeof(msg->reply), "background:%d", (uint8_t)backgroundScan);
+        return Api::success();
+    }
     if (msg->argStartsWith("scanResult")) {
         if (msg->log) log_e("scanResult cannot be called directly, replies are generated after starting a scan");
         return Api::error();
@@ -28,6 +28,18 @@
 #define ATOLL_BLE_CLIENT_PEERS 8
 #endif
 
+#ifndef ATOLL_BLE_CLIENT_ADVERTISERS
+#define ATOLL_BLE_CLIENT_ADVERTISERS 16  // size of the cache of recently seen advertisers
+#endif
+
+#ifndef ATOLL_BLE_CLIENT_PASSIVE_SCAN_INTERVAL
+#define ATOLL_BLE_CLIENT_PASSIVE_SCAN_INTERVAL 1000  // ms
+#endif
+
+#ifndef ATOLL_BLE_CLIENT_PASSIVE_SCAN_WINDOW
+#define ATOLL_BLE_CLIENT_PASSIVE_SCAN_WINDOW 30  // ms of each interval spent listening
+#endif
+
 namespace Atoll {
 
 class BleClient : public Task,
@@ -40,7 +52,8 @@ class BleClient : public Task,
     BLEScan* scan;                                           // pointer to scan object
     Peer* peers[ATOLL_BLE_CLIENT_PEERS];                     // peer devices we want connected
     static const uint8_t peersMax = ATOLL_BLE_CLIENT_PEERS;  // convenience for iterations
-    uint32_t reconnectDelay = 0;                             // delay between connection attempts
+    uint32_t reconnectDelay = 0;                             // min delay between connection attempts of a peer
+    bool backgroundScan = false;                             // scan passively while no connection attempt is due
 #ifdef FEATURE_API
     Api* api = nullptr;
 #endif
@@ -62,6 +75,8 @@ class BleClient : public Task,
 
     virtual void loadSettings();
     virtual void saveSettings();
+    // saves the Database Hash of the peer, keyed by its address
+    virtual void saveDbHash(Peer* peer);
     virtual void printSettings();
 
     virtual void disconnectPeers();
@@ -69,6 +84,28 @@ class BleClient : public Task,
 
     // duration is in milliseconds
     virtual bool startScan(uint32_t duration);
+    // low duty cycle scan without scan requests, runs until stopped
+    virtual bool startPassiveScan();
+    virtual void stopPassiveScan();
+
+    // recently seen advertiser
+    struct Advertiser {
+        uint64_t address = 0;  // 0: unused
+        uint8_t addressType = 0;
+        char type[ATOLL_BLE_PEER_DEVICE_TYPE_LENGTH] = "";  // from the advertised services
+        char name[ATOLL_BLE_PEER_DEVICE_NAME_LENGTH] = "";
+        int16_t rssi = 0;       // moving average in 1/16 dBm
+        ulong lastSeen = 0;     // millis()
+        bool reported = false;  // sent as scanResult
+    };
+    // Open addressed by address hash, without removal. When full, the least
+    // recently seen advertiser is replaced.
+    Advertiser advertisers[ATOLL_BLE_CLIENT_ADVERTISERS];
+    // copies the advertiser, returns false if not in the cache
+    virtual bool getAdvertiser(uint64_t address, Advertiser* copy);
+
+    // peer type by the advertised services, "" if unknown
+    static const char* advertisedType(BLEAdvertisedDevice* device);
 
     virtual Peer* createPeer(Peer::Saved saved);
     virtual Peer* createPeer(BLEAdvertisedDevice* advertisedDevice);
@@ -90,6 +127,15 @@ class BleClient : public Task,
    protected:
     bool shouldStop = false;
 
+    static void dbHashKey(const char* address, char* key, size_t size);
+    bool passiveScanning = false;
+    portMUX_TYPE advertisersMux = portMUX_INITIALIZER_UNLOCKED;
+
+    // called by onResult(), returns the slot of the advertiser, sets *changed if
+    // the advertiser is new or its name or type were learned
+    virtual Advertiser* updateAdvertiser(BLEAdvertisedDevice* device, bool* changed);
+    virtual void reportAdvertiser(BLEAdvertisedDevice* device, Advertiser* advertiser);
+
     // NimBLEScanCallbacks
     virtual void onResult(BLEAdvertisedDevice* advertisedDevice) override;
     virtual void onScanEnd(BLEScanResults results) override;
@@ -5,6 +5,11 @@
     Parts based on https://github.com/ihaque/pelomon/blob/main/pelomon/ble_constants.h
 */
 
+#define GENERIC_ATTRIBUTE_SERVICE_UUID ((uint16_t)0x1801)
+#define SERVICE_CHANGED_CHAR_UUID ((uint16_t)0x2a05)
+#define DATABASE_HASH_CHAR_UUID ((uint16_t)0x2b2a)
+#define DATABASE_HASH_LENGTH 16
+
 #define DEVICE_INFORMATION_SERVICE_UUID ((uint16_t)0x180a)
 #define DEVICE_NAME_CHAR_UUID ((uint16_t)0x2a00)
 #define MANUFACTURER_NAME_STRING_CHAR_UUID ((uint16_t)0x2a29)
@@ -128,6 +133,10 @@
 #define API_TX_CHAR_UUID "422ecb2a-be77-43f2-bf79-f0a62d31fab7"
 #define API_LOG_CHAR_UUID "f6c66fde-3719-457e-bc38-08aa24ca931c"
 #define API_DESC_UUID ((uint16_t)0x2901)
+// API reply fragment header: marker, sequence number, flags
+#define API_FRAGMENT_MARKER ((uint8_t)0x1F)
+#define API_FRAGMENT_HEADER_LENGTH 3
+#define API_FRAGMENT_FLAG_END ((uint8_t)1 << 0)
 
 #define HALL_CHAR_UUID "e43fb4d4-1dc7-4ecd-9409-fb9d65dc7187"
 #define HALL_DESC_UUID ((uint16_t)0x2901)
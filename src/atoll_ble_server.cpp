@@ -18,6 +18,8 @@ void BleServer::setup(const char *deviceName) {
     }
     strncpy(this->deviceName, deviceName, sizeof(this->deviceName));
     enabled = true;
+    // NimBLE calls must not hold up a shared executor
+    taskSetShared(nullptr);
 
     init();
 
@@ -235,6 +237,44 @@ void BleServer::notify(
     c->notify();
 }
 
+// notify a single client without changing the value of the characteristic
+void BleServer::notify(
+    const BLEUUID &serviceUuid,
+    const BLEUUID &charUuid,
+    uint8_t *data,
+    size_t size,
+    uint16_t connHandle) {
+    if (!enabled) {
+        log_d("not enabled, not notifying %s %s",
+              serviceUuid.toString().c_str(), charUuid.toString().c_str());
+        return;
+    }
+    BLECharacteristic *c = getChar(serviceUuid, charUuid);
+    if (nullptr == c) {
+        log_e("could not get %s %s",
+              serviceUuid.toString().c_str(), charUuid.toString().c_str());
+        return;
+    }
+    c->notify(data, size, true, connHandle);
+}
+
+// returns 0 if the mtu is unknown
+uint16_t BleServer::getMTU(uint16_t connHandle) {
+    if (nullptr == server) return 0;
+    return server->getPeerMTU(connHandle);
+}
+
+// returns the smallest mtu of the connected clients, 0 if there are none
+uint16_t BleServer::getMinMTU() {
+    if (nullptr == server) return 0;
+    uint16_t min = 0;
+    for (uint16_t connHandle : server->getPeerDevices()) {
+        uint16_t mtu = server->getPeerMTU(connHandle);
+        if (0 < mtu && (0 == min || mtu < min)) min = mtu;
+    }
+    return min;
+}
+
 // disconnect clients, stop advertising and shutdown AtollBle
 void BleServer::stop() {
     log_i("stopping");
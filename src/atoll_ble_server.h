@@ -74,6 +74,13 @@ class BleServer : public Task,
                         const BLEUUID &charUuid,
                         uint8_t *data,
                         size_t size);
+    virtual void notify(const BLEUUID &serviceUuid,
+                        const BLEUUID &charUuid,
+                        uint8_t *data,
+                        size_t size,
+                        uint16_t connHandle);
+    virtual uint16_t getMTU(uint16_t connHandle);
+    virtual uint16_t getMinMTU();
 
     virtual void stop();
 
@@ -0,0 +1,133 @@
+#include "atoll_event_bus.h"
+
+using namespace Atoll;
+
+EventBus *EventBus::instance = nullptr;
+bool EventBus::autoStart = true;
+bool EventBus::libraryBusStarted = false;
+MpscRing<EventBus::Event, ATOLL_EVENT_BUS_RING_SIZE> EventBus::rings[EventBus::TOPICS];
+EventBus::Subscriber EventBus::subscribers[ATOLL_EVENT_BUS_MAX_SUBSCRIBERS];
+portMUX_TYPE EventBus::subscribersMux = portMUX_INITIALIZER_UNLOCKED;
+
+EventBus::EventBus() {
+    _taskSetFreqAndDelay((float)ATOLL_EVENT_BUS_FREQ);
+    taskSetWakeOnNotify(true);
+}
+
+void EventBus::taskStart(float freq,
+                         uint32_t stack,
+                         int8_t priority,
+                         int8_t core) {
+    // the rings have a single consumer
+    EventBus *running = instance;
+    if (nullptr != running && this != running) {
+        log_w("another bus is running, clear autoStart before subscribing");
+        return;
+    }
+    Task::taskStart(freq, stack, priority, core);
+    if (taskRunning() && nullptr == instance) instance = this;
+}
+
+void EventBus::taskStop() {
+    if (this == instance) instance = nullptr;
+    Task::taskStop();
+}
+
+void EventBus::loop() {
+    dispatch();
+}
+
+bool EventBus::publish(uint8_t topic,
+                       float value,
+                       const void *source,
+                       uint8_t index,
+                       int64_t time) {
+    if (TOPICS <= topic) {
+        log_e("invalid topic %d", topic);
+        return false;
+    }
+    Event event;
+    event.time = 0 == time ? esp_timer_get_time() : time;
+    event.source = source;
+    event.value = value;
+    event.topic = topic;
+    event.index = index;
+    if (!rings[topic].push(event)) return false;
+    EventBus *bus = instance;
+    if (nullptr != bus) bus->taskNotify();
+    return true;
+}
+
+bool EventBus::subscribe(uint32_t topics, Handler handler, void *arg) {
+    if (0 == topics || nullptr == handler) {
+        log_e("invalid subscription");
+        return false;
+    }
+    bool added = false;
+    bool start = false;
+    portENTER_CRITICAL(&subscribersMux);
+    for (uint8_t i = 0; i < ATOLL_EVENT_BUS_MAX_SUBSCRIBERS; i++) {
+        if (0 != subscribers[i].topics) continue;
+        subscribers[i].handler = handler;
+        subscribers[i].arg = arg;
+        subscribers[i].topics = topics;
+        added = true;
+        break;
+    }
+    if (added && autoStart && nullptr == instance && !libraryBusStarted) {
+        libraryBusStarted = true;
+        start = true;
+    }
+    portEXIT_CRITICAL(&subscribersMux);
+    if (!added) log_e("no slot for subscriber");
+    if (start) {
+        log_i("starting the bus");
+        (new EventBus())->taskStart();
+    }
+    return added;
+}
+
+void EventBus::unsubscribe(Handler handler, void *arg) {
+    portENTER_CRITICAL(&subscribersMux);
+    for (uint8_t i = 0; i < ATOLL_EVENT_BUS_MAX_SUBSCRIBERS; i++) {
+        if (subscribers[i].handler != handler || subscribers[i].arg != arg) continue;
+        subscribers[i].topics = 0;
+        subscribers[i].handler = nullptr;
+        subscribers[i].arg = nullptr;
+    }
+    portEXIT_CRITICAL(&subscribersMux);
+}
+
+uint32_t EventBus::dispatch() {
+    // the handlers are called outside the critical section, on a copy of the table
+    Subscriber subs[ATOLL_EVENT_BUS_MAX_SUBSCRIBERS];
+    uint8_t numSubs = 0;
+    uint32_t subscribed = 0;
+    portENTER_CRITICAL(&subscribersMux);
+    for (uint8_t i = 0; i < ATOLL_EVENT_BUS_MAX_SUBSCRIBERS; i++) {
+        if (0 == subscribers[i].topics) continue;
+        subs[numSubs++] = subscribers[i];
+        subscribed |= subscribers[i].topics;
+    }
+    portEXIT_CRITICAL(&subscribersMux);
+    uint32_t delivered = 0;
+    Event event;
+    for (uint8_t topic = 0; topic < TOPICS; topic++) {
+        // events without subscribers are discarded as well
+        while (rings[topic].pop(&event)) {
+            if (!(subscribed & topicBit(topic))) continue;
+            for (uint8_t i = 0; i < numSubs; i++)
+                if (subs[i].topics & topicBit(topic)) subs[i].handler(event, subs[i].arg);
+            delivered++;
+        }
+    }
+    return delivered;
+}
+
+uint32_t EventBus::published(uint8_t topic) {
+    return topic < TOPICS ? rings[topic].pushed() : 0;
+}
+
+uint32_t EventBus::dropped(uint8_t topic) {
+    return topic < TOPICS ? rings[topic].dropped() : 0;
+}
@@ -0,0 +1,119 @@
+#ifndef __atoll_event_bus_h
+#define __atoll_event_bus_h
+
+#include <Arduino.h>
+
+#include "atoll_task.h"
+#include "atoll_mpsc_ring.h"
+
+#ifndef ATOLL_EVENT_BUS_RING_SIZE
+#define ATOLL_EVENT_BUS_RING_SIZE 8  // power of 2, events per topic waiting to be dispatched
+#endif
+
+#ifndef ATOLL_EVENT_BUS_MAX_SUBSCRIBERS
+#define ATOLL_EVENT_BUS_MAX_SUBSCRIBERS 16
+#endif
+
+#ifndef ATOLL_EVENT_BUS_USER_TOPICS
+#define ATOLL_EVENT_BUS_USER_TOPICS 4  // topics for the application, starting at EventBus::USER
+#endif
+
+#ifndef ATOLL_EVENT_BUS_FREQ
+#define ATOLL_EVENT_BUS_FREQ 10  // Hz, the bus is also woken by every publish
+#endif
+
+namespace Atoll {
+
+// Publish-subscribe bus for sensor events.
+// publish() stamps the event with the monotonic time in µs and pushes it to
+// the lock-free ring of its topic, so it never blocks and can be called from
+// the BLE host or any other task. The bus task drains the rings and calls the
+// subscribers of each topic in its own context, one topic at a time; the
+// timestamp, not the order of delivery, tells when an event arrived.
+// The rings and the subscriber table are static, nothing is allocated.
+// The first subscription starts a bus task owned by the library unless one is
+// running or autoStart is cleared, in which case the application either starts
+// the task of one EventBus instance or calls dispatch() from a single task.
+// Events published while the bus is not running are dropped when the ring of
+// the topic is full, see dropped().
+class EventBus : public Task {
+   public:
+    enum Topic : uint8_t {
+        POWER,             // W
+        CADENCE,           // rpm
+        SPEED,             // km/h
+        HEARTRATE,         // bpm
+        RR_INTERVAL,       // ms
+        TEMPERATURE,       // ˚C
+        BATTERY,           // %, battery level of a peer or the device
+        BMS_VOLTAGE,       // V
+        BMS_CURRENT,       // A, charging is positive
+        BMS_SOC,           // %
+        PEER_CONNECTION,   // 1: connected, 0: disconnected, source is the Peer
+        USER,              // first application topic
+        TOPICS = USER + ATOLL_EVENT_BUS_USER_TOPICS,
+    };
+
+    struct Event {
+        int64_t time = 0;              // µs, esp_timer_get_time() on arrival
+        const void *source = nullptr;  // the publishing object, e.g. a Peer or a TemperatureSensor
+        float value = 0.0f;            // in the unit of the topic
+        uint8_t topic = 0;
+        uint8_t index = 0;             // e.g. the channel of a multi-channel source
+    };
+
+    typedef void (*Handler)(const Event &event, void *arg);
+
+    static constexpr uint32_t topicBit(uint8_t topic) { return (uint32_t)1 << topic; }
+
+    const char *taskName() override { return "EventBus"; }
+
+    EventBus();
+    void taskStart(float freq = -1,
+                   uint32_t stack = 0,
+                   int8_t priority = -1,
+                   int8_t core = -1) override;
+    void taskStop() override;
+    void loop() override;
+
+    // returns false if the ring of the topic is full, time 0: now
+    static bool publish(uint8_t topic,
+                        float value,
+                        const void *source = nullptr,
+                        uint8_t index = 0,
+                        int64_t time = 0);
+    // topics is a mask of topicBit()s, returns false if the table is full
+    static bool subscribe(uint32_t topics, Handler handler, void *arg = nullptr);
+    // removes every subscription of the handler with the arg
+    static void unsubscribe(Handler handler, void *arg = nullptr);
+    // delivers the waiting events, returns the number of events delivered;
+    // called by the bus task, call it from a single task if autoStart is
+    // cleared and no bus is started
+    static uint32_t dispatch();
+
+    static uint32_t published(uint8_t topic);
+    static uint32_t dropped(uint8_t topic);
+
+    static EventBus *instance;  // the running bus, woken by publish()
+    // subscribe() starts the library bus if none is running, clear it before
+    // subscribing if the application runs the bus itself
+    static bool autoStart;
+
+   protected:
+    struct Subscriber {
+        uint32_t topics = 0;  // 0: unused slot
+        Handler handler = nullptr;
+        void *arg = nullptr;
+    };
+
+    static_assert(TOPICS <= 32, "too many topics for the subscription mask");
+
+    static MpscRing<Event, ATOLL_EVENT_BUS_RING_SIZE> rings[TOPICS];
+    static Subscriber subscribers[ATOLL_EVENT_BUS_MAX_SUBSCRIBERS];
+    static portMUX_TYPE subscribersMux;
+    static bool libraryBusStarted;  // by subscribe(), the library bus is never deleted
+};
+
+}  // namespace Atoll
+
+#endif
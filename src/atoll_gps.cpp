@@ -19,6 +19,8 @@ void GPS::loop() {
     if (device.failedChecksum() != failedChecksum)
         log_i("checksums failed: %d", device.failedChecksum());
 
+    taskSetActivity(TaskActivity::moving, isMoving());
+
     // if (gps.speed.kmph() < 0.01) return;
     return;
     static ulong lastStatus = millis();
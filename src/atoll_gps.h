@@ -9,6 +9,10 @@
 #include "atoll_touch.h"
 #include "atoll_log.h"
 
+#ifndef ATOLL_GPS_RX_BUFFER_SIZE
+#define ATOLL_GPS_RX_BUFFER_SIZE 1024  // must hold a burst of sentences, the task is woken when the burst ends
+#endif
+
 namespace Atoll {
 
 class GPS : public Atoll::Task {
@@ -29,7 +33,12 @@ class GPS : public Atoll::Task {
         int8_t txPin) {
         // ss.begin(baud, config, rxPin, txPin);
         serial = new HardwareSerial(1);
+        serial->setRxBufferSize(ATOLL_GPS_RX_BUFFER_SIZE);
         serial->begin(baud, config, rxPin, txPin);
+        // read when the receiver pauses instead of polling the uart,
+        // the task freq sets the max time between reads
+        serial->onReceive([this]() { taskNotify(); }, true);
+        taskSetWakeOnNotify(true);
     }
 
     uint32_t satellites() {
@@ -0,0 +1,133 @@
+#include "atoll_hrv.h"
+
+using namespace Atoll;
+
+bool Hrv::add(uint16_t value) {
+    bool accepted = ATOLL_HRV_MIN_RR <= value && value <= ATOLL_HRV_MAX_RR;
+    if (accepted && 0 < last && consecutiveArtifacts < ATOLL_HRV_MAX_ARTIFACTS) {
+        // the rhythm changed if the previous intervals were all rejected
+        uint16_t diff = value < last ? last - value : value - last;
+        accepted = (uint32_t)diff * 100 <= (uint32_t)last * ATOLL_HRV_ARTIFACT_PERCENT;
+    }
+    bool withDiff = accepted && lastAccepted;
+    lastAccepted = accepted;
+    if (!accepted) {
+        artifacts++;
+        if (consecutiveArtifacts < UINT8_MAX) consecutiveArtifacts++;
+        return false;
+    }
+    consecutiveArtifacts = 0;
+    last = value;
+    if (ATOLL_HRV_WINDOW == count) {
+        // drop the oldest interval, head points to it
+        if (diffValid[head]) {
+            sumSquaredDiff -= squaredDiff[head];
+            numDiffs--;
+        }
+    } else
+        count++;
+    uint16_t prev = rr[(head + ATOLL_HRV_WINDOW - 1) % ATOLL_HRV_WINDOW];
+    rr[head] = value;
+    diffValid[head] = withDiff;
+    squaredDiff[head] = 0;
+    if (withDiff) {
+        uint32_t diff = value < prev ? prev - value : value - prev;
+        squaredDiff[head] = diff * diff;
+        sumSquaredDiff += squaredDiff[head];
+        numDiffs++;
+    }
+    // the oldest interval has no predecessor in the window
+    if (ATOLL_HRV_WINDOW == count) {
+        uint16_t oldest = (head + 1) % ATOLL_HRV_WINDOW;
+        if (diffValid[oldest]) {
+            sumSquaredDiff -= squaredDiff[oldest];
+            numDiffs--;
+            diffValid[oldest] = false;
+        }
+    }
+    head = (head + 1) % ATOLL_HRV_WINDOW;
+    beats++;
+    alpha1Valid = false;
+    return true;
+}
+
+void Hrv::reset() {
+    head = 0;
+    count = 0;
+    last = 0;
+    lastAccepted = false;
+    consecutiveArtifacts = 0;
+    sumSquaredDiff = 0;
+    numDiffs = 0;
+    alpha1Valid = false;
+}
+
+float Hrv::rmssd() {
+    if (0 == numDiffs) return -1;
+    return sqrtf((float)sumSquaredDiff / numDiffs);
+}
+
+/// Detrended fluctuation analysis, Peng et al. 1995
+/// The profile is the cumulative sum of the deviations from the mean interval.
+/// For each box size n the profile is split into boxes of n beats, a line is
+/// fitted in each box and F(n) is the root mean square of the residuals.
+/// alpha1 is the slope of log F(n) against log n for n = 4...16 beats.
+/// ~1: correlated (below the aerobic threshold), 0.75: aerobic threshold,
+/// 0.5: uncorrelated (above the anaerobic threshold).
+float Hrv::dfaAlpha1() {
+    if (alpha1Valid) return alpha1;
+    alpha1 = -1;
+    alpha1Valid = true;
+    if (count < ATOLL_HRV_DFA_MIN_BEATS) return alpha1;
+    uint16_t oldest = ATOLL_HRV_WINDOW == count ? head : 0;
+    uint32_t sum = 0;
+    for (uint16_t i = 0; i < count; i++) sum += rr[i];
+    float mean = (float)sum / count;
+    float y = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        y += rr[(oldest + i) % ATOLL_HRV_WINDOW] - mean;
+        profile[i] = y;
+    }
+    // least squares fit of log F(n) = alpha1 * log n + c
+    float sx = 0, sy = 0, sxx = 0, sxy = 0;
+    uint8_t points = 0;
+    for (uint16_t n = ATOLL_HRV_DFA_MIN_BOX; n <= ATOLL_HRV_DFA_MAX_BOX; n++) {
+        float f = fluctuation(count, n);
+        if (f <= 0) continue;
+        float lx = logf((float)n);
+        float ly = logf(f) / 2;  // f is F(n)²
+        sx += lx;
+        sy += ly;
+        sxx += lx * lx;
+        sxy += lx * ly;
+        points++;
+    }
+    if (points < 2) return alpha1;
+    float d = points * sxx - sx * sx;
+    if (d <= 0) return alpha1;
+    alpha1 = (points * sxy - sx * sy) / d;
+    return alpha1;
+}
+
+// Returns F(n)², the boxes are aligned to the newest beat.
+float Hrv::fluctuation(uint16_t length, uint16_t n) {
+    uint16_t boxes = length / n;
+    if (0 == boxes) return 0;
+    float xMean = (n - 1) / 2.0f;
+    float sxx = (float)n * (n * n - 1) / 12;  // sum of (x - xMean)² for x = 0...n-1
+    float residual = 0;
+    for (uint16_t b = 0; b < boxes; b++) {
+        const float* box = profile + length - (b + 1) * n;
+        float yMean = 0;
+        for (uint16_t x = 0; x < n; x++) yMean += box[x];
+        yMean /= n;
+        float syy = 0, sxy = 0;
+        for (uint16_t x = 0; x < n; x++) {
+            float dy = box[x] - yMean;
+            syy += dy * dy;
+            sxy += (x - xMean) * dy;
+        }
+        residual += syy - sxy * sxy / sxx;
+    }
+    return residual / (boxes * n);
+}
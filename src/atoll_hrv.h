@@ -0,0 +1,84 @@
+#ifndef __atoll_hrv_h
+#define __atoll_hrv_h
+
+#include <Arduino.h>
+
+#ifndef ATOLL_HRV_WINDOW
+#define ATOLL_HRV_WINDOW 128  // number of RR intervals kept, ~2 minutes at 60 bpm
+#endif
+
+#ifndef ATOLL_HRV_MIN_RR
+#define ATOLL_HRV_MIN_RR 300  // ms, shorter intervals are artifacts
+#endif
+
+#ifndef ATOLL_HRV_MAX_RR
+#define ATOLL_HRV_MAX_RR 2000  // ms, longer intervals are artifacts
+#endif
+
+#ifndef ATOLL_HRV_ARTIFACT_PERCENT
+#define ATOLL_HRV_ARTIFACT_PERCENT 20  // an interval differing more than this from the previous one is an artifact
+#endif
+
+#ifndef ATOLL_HRV_MAX_ARTIFACTS
+#define ATOLL_HRV_MAX_ARTIFACTS 3  // after this many consecutive artifacts the next interval in range is accepted
+#endif
+
+#ifndef ATOLL_HRV_DFA_MIN_BOX
+#define ATOLL_HRV_DFA_MIN_BOX 4  // beats, smallest box of the short term DFA scaling
+#endif
+
+#ifndef ATOLL_HRV_DFA_MAX_BOX
+#define ATOLL_HRV_DFA_MAX_BOX 16  // beats, largest box of the short term DFA scaling
+#endif
+
+#ifndef ATOLL_HRV_DFA_MIN_BEATS
+#define ATOLL_HRV_DFA_MIN_BEATS 64  // beats in the window needed for DFA-alpha1
+#endif
+
+namespace Atoll {
+
+// Streaming heart rate variability over a sliding window of RR intervals.
+// Intervals out of range or too far from the previous accepted one are counted
+// as artifacts and dropped, no successive difference is formed across them.
+// RMSSD is kept up to date with a running sum of the squared differences in
+// the window. DFA-alpha1 is computed from the window on request in
+// O(window * scales) with fixed memory, and cached until the next interval.
+// Not thread safe, see Recorder::onRrInterval().
+class Hrv {
+   public:
+    uint32_t beats = 0;      // accepted intervals
+    uint32_t artifacts = 0;  // dropped intervals
+
+    // returns false if the interval was dropped as an artifact
+    bool add(uint16_t rr);
+    void reset();
+
+    uint16_t size() { return count; }
+    uint16_t lastRr() { return last; }  // ms, 0: none
+    // ms, -1 if there are no successive differences in the window
+    float rmssd();
+    // short term scaling exponent, -1 if there are too few beats in the window
+    float dfaAlpha1();
+
+   protected:
+    uint16_t rr[ATOLL_HRV_WINDOW];           // ms
+    uint32_t squaredDiff[ATOLL_HRV_WINDOW];  // ms², to the previous interval
+    bool diffValid[ATOLL_HRV_WINDOW];        // the previous interval was accepted
+    uint16_t head = 0;                       // next index to write
+    uint16_t count = 0;                      // intervals in the window
+    uint16_t last = 0;                       // previous accepted interval, 0: none
+    bool lastAccepted = false;               // whether the previous interval was accepted
+    uint8_t consecutiveArtifacts = 0;
+    uint32_t sumSquaredDiff = 0;
+    uint16_t numDiffs = 0;
+    float alpha1 = -1;
+    bool alpha1Valid = false;  // cache of dfaAlpha1()
+    float profile[ATOLL_HRV_WINDOW];  // used by dfaAlpha1()
+
+    // mean squared residual of the linear fits in the boxes of size n
+    float fluctuation(uint16_t length, uint16_t n);
+};
+
+}  // namespace Atoll
+
+#endif
@@ -1,54 +1,451 @@
 #include "atoll_log.h"
+#if 0 != ATOLL_LOG_LEVEL && defined(ATOLL_BOOTLOG_SIZE) && 0 < ATOLL_BOOTLOG_SIZE && defined(ARDUINO_ARCH_ESP32)
+#include "esp_system.h"
+#endif
+#if 0 != ATOLL_LOG_LEVEL && defined(ATOLL_LOG_DEFERRED)
+#include "atoll_task.h"
+#ifdef ARDUINO_ARCH_ESP32
+#include "soc/soc_memory_layout.h"
+#endif
+#endif
 
 using namespace Atoll;
 
 uint8_t Log::level = ATOLL_LOG_LEVEL;
+Log::Tag Log::tags[ATOLL_LOG_MAX_TAGS];
+uint8_t Log::numTags = 0;
+volatile uint32_t Log::tagGeneration = 1;
+Log::TagCache Log::untaggedCache = {0, 0};
+portMUX_TYPE Log::tagMux = portMUX_INITIALIZER_UNLOCKED;
 
 #if 0 != ATOLL_LOG_LEVEL
 char Log::buffer[ATOLL_LOG_BUFFER_SIZE];
 SemaphoreHandle_t Log::mutex = xSemaphoreCreateMutex();
+std::atomic<uint32_t> Log::writeDropped{0};
+uint32_t Log::reportedWriteDropped = 0;
 Log::writeCallback_t Log::writeCallback = nullptr;
+Log::writeCallback_t Log::sinks[ATOLL_LOG_MAX_SINKS];
+uint8_t Log::numSinks = 0;
 #if defined(ATOLL_BOOTLOG_SIZE) && 0 < ATOLL_BOOTLOG_SIZE
-char Log::bootLog[ATOLL_BOOTLOG_SIZE] = "";
-bool Log::bootLogIsFull = false;
+RTC_NOINIT_ATTR Log::BootLog Log::bootLog;
+bool Log::bootLogReady = Log::bootLogInit();
+#endif
 #endif
+
+#if 0 != ATOLL_LOG_LEVEL && defined(ATOLL_LOG_DEFERRED)
+MpscRing<Log::Record, ATOLL_LOG_DEFERRED_QUEUE_LENGTH> Log::ring;
+std::atomic<uint32_t> Log::truncated{0};
+uint16_t Log::maxDepth = 0;
+bool Log::deferredRunning = false;
+uint32_t Log::reportedDropped = 0;
+uint32_t Log::reportedTruncated = 0;
+
+namespace Atoll {
+// formats and writes the queued messages
+class LogTask : public Task {
+   public:
+    const char *taskName() override { return "Log"; }
+    void loop() override { Log::flush(); }
+};
+}  // namespace Atoll
+
+static LogTask logTask;
 #endif
 
-void Log::write(uint8_t level, const char *format, ...) {
+void Log::write(uint8_t, const char *format, ...) {
 #if 0 != ATOLL_LOG_LEVEL
-    if (Log::level < level) return;
-    if (!xSemaphoreTake(mutex, (TickType_t)100) == pdTRUE) return;
+    if (xPortInIsrContext() || pdTRUE != xSemaphoreTake(mutex, (TickType_t)100)) {
+        writeDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
     va_list arg;
     va_start(arg, format);
     vsnprintf(buffer, sizeof(buffer), format, arg);
     va_end(arg);
+    output(buffer);
+    reportWriteDropped();
+    xSemaphoreGive(Log::mutex);
+#else
+    (void)format;
+#endif
+}
+
+uint32_t Log::dropped() {
+#if 0 != ATOLL_LOG_LEVEL
+    return writeDropped.load(std::memory_order_relaxed);
+#else
+    return 0;
+#endif
+}
+
+#if 0 != ATOLL_LOG_LEVEL
+// writes the formatted message to the boot log, Serial, the sinks and the write callback, call with the mutex held
+void Log::output(const char *buffer) {
+    size_t len = strlen(buffer);
 #if defined(ATOLL_BOOTLOG_SIZE) && 0 < ATOLL_BOOTLOG_SIZE
-    if (!bootLogIsFull) {
-        size_t len = strlen(bootLog);
-        if (ATOLL_BOOTLOG_SIZE <= len + strlen(buffer)) {
-            bootLogIsFull = true;
-        }
-        strncat(bootLog, buffer, ATOLL_BOOTLOG_SIZE - len);
-    }
+    bootLogAppend(buffer, len);
 #endif
 #ifdef FEATURE_SERIAL
-    Serial.print(buffer);
+    Serial.write((const uint8_t *)buffer, len);
 #endif
-    if (nullptr != writeCallback) {
-        size_t len = strlen(buffer);
-        // #ifdef FEATURE_SERIAL
-        //    if (3 < len) Serial.printf("%d %d %d", buffer[len-3], buffer[len-2], buffer[len-1]);
-        // #endif
-        if (2 < len && '\r' == buffer[len-2] && '\n' == buffer[len-1]) len -= 2;  // strip last crnl
-        writeCallback(buffer, len);
+    for (uint8_t i = 0; i < numSinks; i++) {
+        sinks[i](buffer, len);
     }
-    xSemaphoreGive(Log::mutex);
+    // the line ending is kept, the callback may coalesce messages
+    if (nullptr != writeCallback) writeCallback(buffer, len);
+}
+
+// writes the number of messages dropped by write() since the last report, call with the mutex held
+void Log::reportWriteDropped() {
+    uint32_t dropped = writeDropped.load(std::memory_order_relaxed);
+    if (reportedWriteDropped == dropped) return;
+    uint32_t count = dropped - reportedWriteDropped;
+    reportedWriteDropped = dropped;
+    snprintf(buffer, sizeof(buffer), "[Log] %u message%s not written\r\n",
+             (unsigned)count, 1 == count ? "" : "s");
+    output(buffer);
+}
 #endif
+
+#if 0 != ATOLL_LOG_LEVEL && defined(ATOLL_LOG_DEFERRED)
+int8_t Log::Record::nextArg() {
+    if (ATOLL_LOG_DEFERRED_PREFIX_ARGS + ATOLL_LOG_DEFERRED_MAX_ARGS <= numArgs) {
+        truncated = true;
+        return -1;
+    }
+    return (int8_t)numArgs++;
 }
 
+void Log::capture(Record *r, const char *str) {
+    int8_t i = r->nextArg();
+    if (i < 0) return;
+    bool isStatic = nullptr == str;
+#ifdef ARDUINO_ARCH_ESP32
+    // string literals in flash don't need to be copied
+    if (!isStatic) isStatic = esp_ptr_in_drom(str);
+#endif
+    if (isStatic) {
+        r->types[i] = Record::argPtr;
+        r->values[i].p = str;
+        return;
+    }
+    r->types[i] = Record::argStr;
+    r->values[i].str = r->strLength;
+    size_t available = sizeof(r->strings) - r->strLength;
+    if (available < 1) {
+        // point to the terminating nul of the previous string
+        r->values[i].str = sizeof(r->strings) - 1;
+        r->truncated = true;
+        return;
+    }
+    size_t len = strlen(str);
+    if (available <= len) {
+        len = available - 1;
+        r->truncated = true;
+    }
+    memcpy(r->strings + r->strLength, str, len);
+    r->strings[r->strLength + len] = '\0';
+    r->strLength += len + 1;
+}
+
+void Log::capture(Record *r, double value) {
+    int8_t i = r->nextArg();
+    if (i < 0) return;
+    r->types[i] = Record::argDouble;
+    r->values[i].d = value;
+}
+
+void Log::capture(Record *r, const void *ptr) {
+    int8_t i = r->nextArg();
+    if (i < 0) return;
+    r->types[i] = Record::argPtr;
+    r->values[i].p = ptr;
+}
+
+// Formats the record like vsnprintf would. The length modifiers in the format
+// are replaced as integers are captured as 64 bit and floats as double.
+size_t Log::format(const Record *r, char *buf, size_t size) {
+    if (size < 1) return 0;
+    const char *f = r->format;
+    size_t len = 0;
+    uint8_t argIndex = 0;
+    while (nullptr != f && '\0' != *f && len < size - 1) {
+        if ('%' != *f) {
+            buf[len++] = *f++;
+            continue;
+        }
+        if ('%' == f[1]) {
+            buf[len++] = '%';
+            f += 2;
+            continue;
+        }
+        // %[flags][width][.precision], the conversion is appended later
+        char spec[24];
+        size_t specLen = 0;
+        spec[specLen++] = *f++;
+        while ('\0' != *f && nullptr != strchr("-+ #0123456789.*", *f) && specLen < sizeof(spec) - 4) {
+            if ('*' == *f) {
+                // width or precision from the arguments
+                int value = 0;
+                if (argIndex < r->numArgs) value = (int)r->values[argIndex++].i;
+                int written = snprintf(spec + specLen, sizeof(spec) - 4 - specLen, "%d", value);
+                if (0 < written) specLen += written;
+                if (sizeof(spec) - 4 < specLen) specLen = sizeof(spec) - 4;
+                f++;
+                continue;
+            }
+            spec[specLen++] = *f++;
+        }
+        while ('\0' != *f && nullptr != strchr("hlLqjzt", *f)) f++;
+        char conversion = *f;
+        if ('\0' == conversion) break;
+        f++;
+        int written = 0;
+        if (r->numArgs <= argIndex) {
+            written = snprintf(buf + len, size - len, "?");
+        } else {
+            uint8_t type = r->types[argIndex];
+            const Record::Value *v = &r->values[argIndex];
+            argIndex++;
+            switch (conversion) {
+                case 'd':
+                case 'i': {
+                    long long value = Record::argDouble == type ? (long long)v->d : v->i;
+                    memcpy(spec + specLen, "lld", 4);
+                    written = snprintf(buf + len, size - len, spec, value);
+                    break;
+                }
+                case 'u':
+                case 'x':
+                case 'X':
+                case 'o': {
+                    unsigned long long value = Record::argDouble == type ? (unsigned long long)v->d : v->u;
+                    spec[specLen] = 'l';
+                    spec[specLen + 1] = 'l';
+                    spec[specLen + 2] = conversion;
+                    spec[specLen + 3] = '\0';
+                    written = snprintf(buf + len, size - len, spec, value);
+                    break;
+                }
+                case 'c':
+                    spec[specLen] = 'c';
+                    spec[specLen + 1] = '\0';
+                    written = snprintf(buf + len, size - len, spec, (int)v->i);
+                    break;
+                case 'f':
+                case 'F':
+                case 'e':
+                case 'E':
+                case 'g':
+                case 'G':
+                case 'a':
+                case 'A': {
+                    double value = Record::argDouble == type  ? v->d
+                                   : Record::argInt == type ? (double)v->i
+                                                            : (double)v->u;
+                    spec[specLen] = conversion;
+                    spec[specLen + 1] = '\0';
+                    written = snprintf(buf + len, size - len, spec, value);
+                    break;
+                }
+                case 's': {
+                    const char *str = Record::argStr == type   ? r->strings + v->str
+                                      : Record::argPtr == type ? (const char *)v->p
+                                                               : "?";
+                    if (nullptr == str) str = "(null)";
+                    spec[specLen] = 's';
+                    spec[specLen + 1] = '\0';
+                    written = snprintf(buf + len, size - len, spec, str);
+                    break;
+                }
+                case 'p':
+                    spec[specLen] = 'p';
+                    spec[specLen + 1] = '\0';
+                    written = snprintf(buf + len, size - len, spec, v->p);
+                    break;
+                default:
+                    written = snprintf(buf + len, size - len, "?");
+            }
+        }
+        if (written < 0) continue;
+        len += (size_t)written < size - len ? (size_t)written : size - len - 1;
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+// formats and writes the queued messages, returns the number of messages written
+uint16_t Log::flush() {
+    uint16_t written = 0;
+    uint32_t depth = ring.size();
+    if (maxDepth < depth) maxDepth = depth;
+    Record r;
+    for (;;) {
+        // the messages stay in the ring until the mutex is available
+        if (pdTRUE != xSemaphoreTake(mutex, (TickType_t)100)) return written;
+        bool popped = ring.pop(&r);
+        if (popped) {
+            format(&r, buffer, sizeof(buffer));
+            output(buffer);
+        } else
+            reportWriteDropped();
+        xSemaphoreGive(mutex);
+        if (!popped) break;
+        written++;
+    }
+    uint32_t dropped = ring.dropped();
+    if (reportedDropped != dropped) {
+        write(1, "[Log] %d message%s dropped\r\n",
+              dropped - reportedDropped, 1 == dropped - reportedDropped ? "" : "s");
+        reportedDropped = dropped;
+    }
+    uint32_t truncatedCount = truncated.load(std::memory_order_relaxed);
+    if (reportedTruncated != truncatedCount) {
+        write(1, "[Log] %d message%s truncated\r\n",
+              truncatedCount - reportedTruncated, 1 == truncatedCount - reportedTruncated ? "" : "s");
+        reportedTruncated = truncatedCount;
+    }
+    return written;
+}
+
+Log::DeferredStats Log::deferredStats() {
+    DeferredStats stats;
+    stats.queued = ring.pushed();
+    stats.dropped = ring.dropped();
+    stats.truncated = truncated.load(std::memory_order_relaxed);
+    stats.maxDepth = maxDepth;
+    return stats;
+}
+
+void Log::startTask(float freq, uint32_t stack, int8_t priority) {
+    logTask.taskStart(freq, stack, priority);
+    deferredRunning = logTask.taskRunning();
+}
+
+// writes the queued messages and switches back to synchronous logging
+void Log::stopTask() {
+    deferredRunning = false;
+    if (logTask.taskRunning()) logTask.taskStop();
+    flush();
+}
+#endif
+
 // 0: none, 1: error, 2: warning, 3, info, 4+: debug
 void Log::setLevel(uint8_t level) {
     Log::level = level;
+    tagGeneration++;
+}
+
+void Log::refresh(TagCache *cache, const char *tag) {
+    // read the generation first so a change during the lookup is not missed
+    uint32_t generation = tagGeneration;
+    cache->level = tagLevel(tag);
+    cache->generation = generation;
+}
+
+bool Log::setTagLevel(const char *tag, uint8_t level) {
+    if (nullptr == tag || 0 == strcmp("*", tag)) {
+        setLevel(level);
+        return true;
+    }
+    if (0 == strlen(tag) || ATOLL_LOG_TAG_LENGTH <= strlen(tag)) return false;
+    bool set = false;
+    portENTER_CRITICAL(&tagMux);
+    for (uint8_t i = 0; i < numTags; i++)
+        if (0 == strcmp(tags[i].name, tag)) {
+            tags[i].level = level;
+            set = true;
+            break;
+        }
+    if (!set && numTags < ATOLL_LOG_MAX_TAGS) {
+        strncpy(tags[numTags].name, tag, sizeof(tags[0].name));
+        tags[numTags].level = level;
+        numTags++;
+        set = true;
+    }
+    tagGeneration++;
+    portEXIT_CRITICAL(&tagMux);
+    return set;
+}
+
+void Log::removeTagLevel(const char *tag) {
+    bool all = nullptr == tag || 0 == strcmp("*", tag);
+    portENTER_CRITICAL(&tagMux);
+    uint8_t kept = 0;
+    for (uint8_t i = 0; i < numTags; i++) {
+        if (all || 0 == strcmp(tags[i].name, tag)) continue;
+        if (kept != i) tags[kept] = tags[i];
+        kept++;
+    }
+    numTags = kept;
+    tagGeneration++;
+    portEXIT_CRITICAL(&tagMux);
+}
+
+uint8_t Log::tagLevel(const char *tag) {
+    uint8_t result = level;
+    if (nullptr == tag || 0 == numTags) return result;
+    portENTER_CRITICAL(&tagMux);
+    for (uint8_t i = 0; i < numTags; i++)
+        if (0 == strcmp(tags[i].name, tag)) {
+            result = tags[i].level;
+            break;
+        }
+    portEXIT_CRITICAL(&tagMux);
+    return result;
+}
+
+size_t Log::levelsToStr(char *buf, size_t size) {
+    if (size < 1) return 0;
+    int written = snprintf(buf, size, "*:%d", level);
+    size_t len = 0 < written ? (size_t)written : 0;
+    portENTER_CRITICAL(&tagMux);
+    for (uint8_t i = 0; i < numTags && len < size - 1; i++) {
+        written = snprintf(buf + len, size - len, ",%s:%d", tags[i].name, tags[i].level);
+        if (written < 0) break;
+        len += (size_t)written < size - len ? (size_t)written : size - len - 1;
+    }
+    portEXIT_CRITICAL(&tagMux);
+    return len;
+}
+
+bool Log::levelsFromStr(const char *str) {
+    if (nullptr == str || !parseLevels(str, false)) return false;
+    return parseLevels(str, true);
+}
+
+// entries: name:level or -name, separated by ',', validates only unless apply is set
+bool Log::parseLevels(const char *str, bool apply) {
+    static const char *nameChars =
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_";
+    const char *entry = str;
+    while ('\0' != *entry) {
+        size_t entryLen = strcspn(entry, ",");
+        bool remove = '-' == *entry;
+        const char *name = remove ? entry + 1 : entry;
+        size_t nameLen = '*' == *name ? 1 : strspn(name, nameChars);
+        if (nameLen < 1 || ATOLL_LOG_TAG_LENGTH <= nameLen) return false;
+        char tag[ATOLL_LOG_TAG_LENGTH];
+        strncpy(tag, name, nameLen);
+        tag[nameLen] = '\0';
+        if (remove) {
+            if (entryLen != nameLen + 1) return false;
+            if (apply) removeTagLevel(tag);
+        } else {
+            // name:level, level is a single digit
+            if (entryLen != nameLen + 2 || ':' != name[nameLen] ||
+                name[nameLen + 1] < '0' || '5' < name[nameLen + 1]) return false;
+            uint8_t value = name[nameLen + 1] - '0';
+            // fails if there are no free slots for a new tag
+            if (apply && !setTagLevel(tag, value)) return false;
+        }
+        entry += entryLen;
+        if (',' == *entry) {
+            entry++;
+            if ('\0' == *entry) return false;
+        }
+    }
+    return true;
 }
 
 void Log::setWriteCallback(Log::writeCallback_t callback) {
@@ -57,26 +454,121 @@ void Log::setWriteCallback(Log::writeCallback_t callback) {
 #endif
 }
 
+bool Log::addSink(Log::writeCallback_t sink) {
+#if 0 != ATOLL_LOG_LEVEL
+    if (pdTRUE != xSemaphoreTake(mutex, (TickType_t)100)) return false;
+    bool added = numSinks < ATOLL_LOG_MAX_SINKS;
+    if (added) sinks[numSinks++] = sink;
+    xSemaphoreGive(mutex);
+    return added;
+#else
+    return false;
+#endif
+}
+
+#if 0 != ATOLL_LOG_LEVEL && defined(ATOLL_BOOTLOG_SIZE) && 0 < ATOLL_BOOTLOG_SIZE
+#define ATOLL_BOOTLOG_MAGIC 0xb0071065
+
+// called during static initialization, before any logging
+bool Log::bootLogInit() {
+    bool valid = ATOLL_BOOTLOG_MAGIC == bootLog.magic &&
+                 bootLog.head < ATOLL_BOOTLOG_SIZE &&
+                 bootLog.length <= ATOLL_BOOTLOG_SIZE;
+    const char *reason = "unknown";
+#ifdef ARDUINO_ARCH_ESP32
+    switch (esp_reset_reason()) {
+        case ESP_RST_POWERON:
+            valid = false;  // RTC memory content is random
+            reason = "power on";
+            break;
+        case ESP_RST_EXT: reason = "external"; break;
+        case ESP_RST_SW: reason = "software"; break;
+        case ESP_RST_PANIC: reason = "panic"; break;
+        case ESP_RST_INT_WDT: reason = "interrupt watchdog"; break;
+        case ESP_RST_TASK_WDT: reason = "task watchdog"; break;
+        case ESP_RST_WDT: reason = "watchdog"; break;
+        case ESP_RST_DEEPSLEEP: reason = "deep sleep"; break;
+        case ESP_RST_BROWNOUT: reason = "brownout"; break;
+        case ESP_RST_SDIO: reason = "sdio"; break;
+        default: break;
+    }
+#endif
+    if (valid)
+        bootLog.resets++;
+    else {
+        bootLog.magic = ATOLL_BOOTLOG_MAGIC;
+        bootLog.head = 0;
+        bootLog.length = 0;
+        bootLog.resets = 0;
+    }
+    char marker[64];
+    int len = snprintf(marker, sizeof(marker), "[BOOT] reset %u, reason: %s\r\n",
+                       bootLog.resets, reason);
+    if (0 < len) bootLogAppend(marker, (size_t)len < sizeof(marker) ? len : sizeof(marker) - 1);
+    return true;
+}
+
+// call with the mutex held
+void Log::bootLogAppend(const char *buf, size_t len) {
+    if (ATOLL_BOOTLOG_SIZE < len) {
+        // only the end of the message fits
+        buf += len - ATOLL_BOOTLOG_SIZE;
+        len = ATOLL_BOOTLOG_SIZE;
+    }
+    size_t first = ATOLL_BOOTLOG_SIZE - bootLog.head;
+    if (len < first) first = len;
+    memcpy(bootLog.data + bootLog.head, buf, first);
+    if (first < len) memcpy(bootLog.data, buf + first, len - first);
+    bootLog.head = (bootLog.head + len) % ATOLL_BOOTLOG_SIZE;
+    bootLog.length += len;
+    if (ATOLL_BOOTLOG_SIZE < bootLog.length) bootLog.length = ATOLL_BOOTLOG_SIZE;
+}
+#endif
+
+size_t Log::bootLogLength() {
+#if 0 != ATOLL_LOG_LEVEL && defined(ATOLL_BOOTLOG_SIZE) && 0 < ATOLL_BOOTLOG_SIZE
+    return bootLog.length;
+#else
+    return 0;
+#endif
+}
+
+size_t Log::readBootLog(char *buf, size_t size, size_t offset) {
+#if 0 != ATOLL_LOG_LEVEL && defined(ATOLL_BOOTLOG_SIZE) && 0 < ATOLL_BOOTLOG_SIZE
+    if (pdTRUE != xSemaphoreTake(mutex, (TickType_t)100)) return 0;
+    size_t copied = 0;
+    if (offset < bootLog.length) {
+        copied = bootLog.length - offset;
+        if (size < copied) copied = size;
+        size_t from = (bootLog.head + ATOLL_BOOTLOG_SIZE - bootLog.length + offset) % ATOLL_BOOTLOG_SIZE;
+        size_t first = ATOLL_BOOTLOG_SIZE - from;
+        if (copied < first) first = copied;
+        memcpy(buf, bootLog.data + from, first);
+        if (first < copied) memcpy(buf + first, bootLog.data, copied - first);
+    }
+    xSemaphoreGive(mutex);
+    return copied;
+#else
+    return 0;
+#endif
+}
+
+// writes the ring in at most two segments per output, oldest first
 void Log::dumpBootLog() {
 #if 0 != ATOLL_LOG_LEVEL && defined(ATOLL_BOOTLOG_SIZE) && 0 < ATOLL_BOOTLOG_SIZE
-    if (nullptr == bootLog) return;
-    size_t len = strlen(bootLog);
-    char *from = bootLog;
-    char out[ATOLL_LOG_BUFFER_SIZE - 32] = "";
-    char *to = out;
-    int count = 0;
-
-    while (from < bootLog + len) {
-        strncpy(to, from, 1);
-        if ('\n' == *to || from == bootLog + len - 1 || out + sizeof(out) - 1 <= to) {
-            if ('\n' != *to) *to = '\n';
-            *(to + 1) = '\0';
-            if (count) delay(100);
-            write(1, "[BOOT %d] %s", count, out);
-            to = out;
-            count++;
-        } else to++;
-        from++;
+    if (pdTRUE != xSemaphoreTake(mutex, (TickType_t)100)) return;
+    size_t from = (bootLog.head + ATOLL_BOOTLOG_SIZE - bootLog.length) % ATOLL_BOOTLOG_SIZE;
+    size_t first = ATOLL_BOOTLOG_SIZE - from;
+    if (bootLog.length < first) first = bootLog.length;
+    size_t second = bootLog.length - first;
+#ifdef FEATURE_SERIAL
+    Serial.write((const uint8_t *)bootLog.data + from, first);
+    if (0 < second) Serial.write((const uint8_t *)bootLog.data, second);
+#endif
+    if (nullptr != writeCallback) {
+        writeCallback(bootLog.data + from, first);
+        if (0 < second) writeCallback(bootLog.data, second);
     }
+    xSemaphoreGive(mutex);
 #endif
 }
\ No newline at end of file
@@ -3,6 +3,8 @@
 
 #include <Arduino.h>
 
+#include <atomic>
+
 #include "atoll_serial.h"
 
 // 0: none, 1: error, 2: warning, 3, info, 4+: debug
@@ -14,17 +16,86 @@
 #ifndef ATOLL_LOG_BUFFER_SIZE
 #define ATOLL_LOG_BUFFER_SIZE 512
 #endif
+#ifndef ATOLL_LOG_MAX_SINKS
+#define ATOLL_LOG_MAX_SINKS 2
+#endif
 #endif
 
+// bytes of RTC slow memory for the last messages, kept across resets except power-on
 #ifndef ATOLL_BOOTLOG_SIZE
-#define ATOLL_BOOTLOG_SIZE 1024
+#define ATOLL_BOOTLOG_SIZE 2048
+#endif
+
+// Per-module logging: define ATOLL_LOG_TAG (a string) and optionally
+// ATOLL_LOG_LOCAL_LEVEL at the top of the .cpp, before any include.
+// Calls above ATOLL_LOG_LOCAL_LEVEL expand to ((void)0), the rest is
+// filtered at runtime by the level of the tag, see Log::setTagLevel().
+// With ATOLL_LOG_LEVEL 0 logging is disabled regardless of the local level.
+#ifndef ATOLL_LOG_LOCAL_LEVEL
+#define ATOLL_LOG_LOCAL_LEVEL ATOLL_LOG_LEVEL
+#endif
+// Tagged translation units keep the level of their tag in a cache of their
+// own, the untagged ones share Log::untaggedCache.
+#ifdef ATOLL_LOG_TAG
+#define ATOLL_LOG_TAGGED
+#define ATOLL_LOG_TAG_CACHE atollLogTagCache
+#else
+#define ATOLL_LOG_TAG nullptr
+#define ATOLL_LOG_TAG_CACHE Atoll::Log::untaggedCache
+#endif
+#ifndef ATOLL_LOG_MAX_TAGS
+#define ATOLL_LOG_MAX_TAGS 8  // max number of tags with a runtime level
+#endif
+#ifndef ATOLL_LOG_TAG_LENGTH
+#define ATOLL_LOG_TAG_LENGTH 16
+#endif
+
+// With ATOLL_LOG_DEFERRED defined, the log_* macros only capture the format
+// pointer and the arguments, formatting and writing is done by the log task
+// started with Log::startTask(). Until the task is running, messages are
+// written synchronously, except the ones logged from an ISR, which wait in the
+// queue for the task.
+#if 0 != ATOLL_LOG_LEVEL && defined(ATOLL_LOG_DEFERRED)
+#include <type_traits>
+#include "atoll_mpsc_ring.h"
+#ifndef ATOLL_LOG_DEFERRED_QUEUE_LENGTH
+#define ATOLL_LOG_DEFERRED_QUEUE_LENGTH 32  // max number of messages waiting to be formatted, power of 2
+#endif
+#ifndef ATOLL_LOG_DEFERRED_MAX_ARGS
+#define ATOLL_LOG_DEFERRED_MAX_ARGS 8  // max number of arguments captured per message, not counting the prefix
+#endif
+// time, file, line and function added by ARDUHAL_LOG_FORMAT
+#define ATOLL_LOG_DEFERRED_PREFIX_ARGS 4
+#ifndef ATOLL_LOG_DEFERRED_STR_LENGTH
+#define ATOLL_LOG_DEFERRED_STR_LENGTH 64  // bytes per message for copying string arguments
+#endif
+#ifndef ATOLL_LOG_TASK_FREQ
+#define ATOLL_LOG_TASK_FREQ 20
+#endif
+#ifndef ATOLL_LOG_TASK_STACK
+#define ATOLL_LOG_TASK_STACK 4096
+#endif
+#ifndef ATOLL_LOG_TASK_PRIORITY
+#define ATOLL_LOG_TASK_PRIORITY 1
+#endif
+#define ATOLL_LOG_WRITE Atoll::Log::defer
+#else
+#define ATOLL_LOG_WRITE Atoll::Log::write
 #endif
 
+// writes the message if the level passes the runtime level of the tag,
+// only used for the levels within the compile time ceiling
+#define ATOLL_LOG_AT(level, format, ...)                                    \
+    do {                                                                    \
+        if (Atoll::Log::enabled(&ATOLL_LOG_TAG_CACHE, ATOLL_LOG_TAG, (level))) \
+            ATOLL_LOG_WRITE((level), format, ##__VA_ARGS__);                \
+    } while (0)
+
 #ifdef log_e
 #undef log_e
 #endif
-#if 0 < ATOLL_LOG_LEVEL
-#define log_e(format, ...) Atoll::Log::write(ARDUHAL_LOG_LEVEL_ERROR, ARDUHAL_LOG_FORMAT(E, format), ##__VA_ARGS__)
+#if 0 != ATOLL_LOG_LEVEL && ARDUHAL_LOG_LEVEL_ERROR <= ATOLL_LOG_LOCAL_LEVEL
+#define log_e(format, ...) ATOLL_LOG_AT(ARDUHAL_LOG_LEVEL_ERROR, ARDUHAL_LOG_FORMAT(E, format), ##__VA_ARGS__)
 #else
 #define log_e(format, ...) ((void)0)
 #endif
@@ -32,8 +103,8 @@
 #ifdef log_w
 #undef log_w
 #endif
-#if 1 < ATOLL_LOG_LEVEL
-#define log_w(format, ...) Atoll::Log::write(ARDUHAL_LOG_LEVEL_WARN, ARDUHAL_LOG_FORMAT(W, format), ##__VA_ARGS__)
+#if 0 != ATOLL_LOG_LEVEL && ARDUHAL_LOG_LEVEL_WARN <= ATOLL_LOG_LOCAL_LEVEL
+#define log_w(format, ...) ATOLL_LOG_AT(ARDUHAL_LOG_LEVEL_WARN, ARDUHAL_LOG_FORMAT(W, format), ##__VA_ARGS__)
 #else
 #define log_w(format, ...) ((void)0)
 #endif
@@ -41,8 +112,8 @@
 #ifdef log_i
 #undef log_i
 #endif
-#if 2 < ATOLL_LOG_LEVEL
-#define log_i(format, ...) Atoll::Log::write(ARDUHAL_LOG_LEVEL_INFO, ARDUHAL_LOG_FORMAT(I, format), ##__VA_ARGS__)
+#if 0 != ATOLL_LOG_LEVEL && ARDUHAL_LOG_LEVEL_INFO <= ATOLL_LOG_LOCAL_LEVEL
+#define log_i(format, ...) ATOLL_LOG_AT(ARDUHAL_LOG_LEVEL_INFO, ARDUHAL_LOG_FORMAT(I, format), ##__VA_ARGS__)
 #else
 #define log_i(format, ...) ((void)0)
 #endif
@@ -50,23 +121,30 @@
 #ifdef log_d
 #undef log_d
 #endif
-#if 3 < ATOLL_LOG_LEVEL
-#define log_d(format, ...) Atoll::Log::write(ARDUHAL_LOG_LEVEL_DEBUG, ARDUHAL_LOG_FORMAT(D, format), ##__VA_ARGS__)
+#if 0 != ATOLL_LOG_LEVEL && ARDUHAL_LOG_LEVEL_DEBUG <= ATOLL_LOG_LOCAL_LEVEL
+#define log_d(format, ...) ATOLL_LOG_AT(ARDUHAL_LOG_LEVEL_DEBUG, ARDUHAL_LOG_FORMAT(D, format), ##__VA_ARGS__)
 #else
 #define log_d(format, ...) ((void)0)
 #endif
 
+// the naked logs are not limited by the local level, only filtered at runtime as info
+#if 0 != ATOLL_LOG_LEVEL
+#define ATOLL_LOG_NAKED(format, ...) ATOLL_LOG_AT(ARDUHAL_LOG_LEVEL_INFO, format, ##__VA_ARGS__)
+#else
+#define ATOLL_LOG_NAKED(format, ...) ((void)0)
+#endif
+
 #ifdef log_s
 #undef log_s
 #endif
 /* naked info log */
-#define log_s(format, ...) Atoll::Log::write(ARDUHAL_LOG_LEVEL_INFO, format "\r\n", ##__VA_ARGS__)
+#define log_s(format, ...) ATOLL_LOG_NAKED(format "\r\n", ##__VA_ARGS__)
 
 #ifdef log_sn
 #undef log_sn
 #endif
 /* naked info log without newline */
-#define log_sn(format, ...) Atoll::Log::write(ARDUHAL_LOG_LEVEL_INFO, format, ##__VA_ARGS__)
+#define log_sn(format, ...) ATOLL_LOG_NAKED(format, ##__VA_ARGS__)
 
 namespace Atoll {
 
@@ -75,27 +153,195 @@ class Log {
     typedef std::function<void(const char *buf, size_t size)> writeCallback_t;
 
    public:
+    // writes the message unconditionally, filtering is done by the log_* macros;
+    // the message is dropped if the log is busy for 100 ticks or if called from an ISR
     static void write(uint8_t level, const char *format, ...);
+    // number of messages dropped by write(), reported with the next message written
+    static uint32_t dropped();
 
     // 0: none, 1: error, 2: warning, 3, info, 4+: debug
     static void setLevel(uint8_t level);
+    static uint8_t getLevel() { return level; }
+
+    // the runtime level of a translation unit, refreshed when a level changes
+    struct TagCache {
+        uint32_t generation;
+        uint8_t level;
+    };
+
+    static inline bool enabled(TagCache *cache, const char *tag, uint8_t level) {
+        if (cache->generation != tagGeneration) refresh(cache, tag);
+        return level <= cache->level;
+    }
+    static TagCache untaggedCache;  // shared by the translation units without a tag
+
+    // sets the runtime level of a tag, overriding the global level
+    static bool setTagLevel(const char *tag, uint8_t level);
+    // removes the level of a tag, nullptr or "*" removes all of them
+    static void removeTagLevel(const char *tag);
+    // the runtime level of a tag, or the global level if the tag has no level set
+    static uint8_t tagLevel(const char *tag);
+    // prints the levels as "*:1,JkBms:4", "*" being the global level
+    static size_t levelsToStr(char *buf, size_t size);
+    // parses levels in the format printed by levelsToStr(), a name prefixed
+    // with '-' removes the level of the tag, "-*" removes all of them;
+    // nothing is changed if any of the entries is invalid
+    static bool levelsFromStr(const char *str);
 
     static void setWriteCallback(writeCallback_t callback);
+    // Adds an output receiving every message including the line ending.
+    // Sinks are called with the log mutex held, they must not block or log.
+    static bool addSink(writeCallback_t sink);
+    // writes the boot log to Serial and the write callback
     static void dumpBootLog();
+    // copies the boot log starting at offset, oldest first, returns the number of bytes copied
+    static size_t readBootLog(char *buf, size_t size, size_t offset = 0);
+    static size_t bootLogLength();
+
+#if 0 != ATOLL_LOG_LEVEL && defined(ATOLL_LOG_DEFERRED)
+    // a log call captured on the caller's task
+    struct Record {
+        enum ArgType : uint8_t {
+            argInt,
+            argUint,
+            argDouble,
+            argStr,  // copied to strings
+            argPtr,  // pointer, also used for static strings
+        };
+        union Value {
+            int64_t i;
+            uint64_t u;
+            double d;
+            const void *p;
+            uint16_t str;  // offset in strings
+        };
+
+        const char *format = nullptr;
+        uint8_t level = 0;
+        uint8_t numArgs = 0;
+        uint16_t strLength = 0;  // bytes used in strings
+        bool truncated = false;  // some arguments did not fit
+        uint8_t types[ATOLL_LOG_DEFERRED_PREFIX_ARGS + ATOLL_LOG_DEFERRED_MAX_ARGS];
+        Value values[ATOLL_LOG_DEFERRED_PREFIX_ARGS + ATOLL_LOG_DEFERRED_MAX_ARGS];
+        char strings[ATOLL_LOG_DEFERRED_STR_LENGTH];
+
+        // returns the index of the next argument slot, or -1 if there are no free slots
+        int8_t nextArg();
+    };
+
+    struct DeferredStats {
+        uint32_t queued = 0;     // number of messages queued
+        uint32_t dropped = 0;    // number of messages dropped because the queue was full
+        uint32_t truncated = 0;  // number of messages with arguments that did not fit
+        uint16_t maxDepth = 0;   // max number of messages waiting
+    };
+
+    static DeferredStats deferredStats();
+
+    template <typename... Args>
+    static void defer(uint8_t level, const char *format, Args... args) {
+        // an ISR must not take the mutex of write()
+        if (!deferredRunning && !xPortInIsrContext()) {
+            write(level, format, args...);
+            return;
+        }
+        Record r;
+        r.format = format;
+        r.level = level;
+        int unused[] = {0, (capture(&r, args), 0)...};
+        (void)unused;
+        if (r.truncated) truncated.fetch_add(1, std::memory_order_relaxed);
+        ring.push(r);
+    }
+
+    static void startTask(float freq = ATOLL_LOG_TASK_FREQ,
+                          uint32_t stack = ATOLL_LOG_TASK_STACK,
+                          int8_t priority = ATOLL_LOG_TASK_PRIORITY);
+    static void stopTask();
+    static uint16_t flush();
+    static size_t format(const Record *r, char *buf, size_t size);
+
+   protected:
+    static MpscRing<Record, ATOLL_LOG_DEFERRED_QUEUE_LENGTH> ring;
+    static std::atomic<uint32_t> truncated;
+    static uint16_t maxDepth;
+    static bool deferredRunning;
+    static uint32_t reportedDropped;
+    static uint32_t reportedTruncated;
+
+    static void capture(Record *r, const char *str);
+    static void capture(Record *r, char *str) { capture(r, (const char *)str); }
+    static void capture(Record *r, double value);
+    static void capture(Record *r, const void *ptr);
+    static void capture(Record *r, std::nullptr_t) { capture(r, (const void *)nullptr); }
+
+    template <typename T>
+    static typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+    capture(Record *r, T value) {
+        int8_t i = r->nextArg();
+        if (i < 0) return;
+        if (std::is_signed<T>::value) {
+            r->types[i] = Record::argInt;
+            r->values[i].i = (int64_t)value;
+        } else {
+            r->types[i] = Record::argUint;
+            r->values[i].u = (uint64_t)value;
+        }
+    }
+#endif
 
    protected:
     static uint8_t level;  // 0: none, 1: error, 2: warning, 3, info, 4+: debug
+
+    struct Tag {
+        char name[ATOLL_LOG_TAG_LENGTH];
+        uint8_t level;
+    };
+    static Tag tags[ATOLL_LOG_MAX_TAGS];
+    static uint8_t numTags;
+    static volatile uint32_t tagGeneration;  // incremented when a level changes
+    static portMUX_TYPE tagMux;
+
+    static void refresh(TagCache *cache, const char *tag);
+    static bool parseLevels(const char *str, bool apply);
+
 #if 0 != ATOLL_LOG_LEVEL
     static char buffer[ATOLL_LOG_BUFFER_SIZE];
     static SemaphoreHandle_t mutex;
+    static std::atomic<uint32_t> writeDropped;
+    static uint32_t reportedWriteDropped;
     static writeCallback_t writeCallback;
+    static writeCallback_t sinks[ATOLL_LOG_MAX_SINKS];
+    static uint8_t numSinks;
+
+    static void output(const char *buf);
+    static void reportWriteDropped();
 #if defined(ATOLL_BOOTLOG_SIZE) && 0 < ATOLL_BOOTLOG_SIZE
-    static char bootLog[ATOLL_BOOTLOG_SIZE];
-    static bool bootLogIsFull;
+    // Ring in RTC memory, must not have initializers as it is not
+    // zeroed on boot. Validated and marked with the reset reason by bootLogInit().
+    struct BootLog {
+        uint32_t magic;
+        uint32_t head;    // next write position
+        uint32_t length;  // number of valid bytes
+        uint32_t resets;  // number of resets since power-on
+        char data[ATOLL_BOOTLOG_SIZE];
+    };
+    static BootLog bootLog;
+    static bool bootLogReady;
+
+    static bool bootLogInit();
+    static void bootLogAppend(const char *buf, size_t len);
 #endif
 #endif
 };
 
 }  // namespace Atoll
 
+#ifdef ATOLL_LOG_TAGGED
+// the tag level cache of the translation unit, used by the log_* macros
+namespace {
+Atoll::Log::TagCache atollLogTagCache __attribute__((unused)) = {0, 0};
+}
+#endif
+
 #endif
\ No newline at end of file
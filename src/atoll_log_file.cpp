@@ -0,0 +1,347 @@
+#ifdef FEATURE_LOG_FILE
+
+#include "atoll_log_file.h"
+
+using namespace Atoll;
+
+LogFile *LogFile::instance = nullptr;
+
+void LogFile::setup(Fs *device,
+                    LogFile *instance,
+#ifdef FEATURE_API
+                    Api *api,
+#endif
+                    const char *basePath) {
+    if (nullptr == device) {
+        log_e("no device");
+        return;
+    }
+    this->device = device;
+    if (!device->mounted) {
+        log_e("device not mounted");
+        return;
+    }
+    this->fs = device->pFs();
+    if (nullptr == fs) {
+        log_e("no fs");
+        return;
+    }
+    if (nullptr != basePath) this->basePath = basePath;
+    if (!device->aquireMutex()) {
+        log_e("could not aquire mutex");
+        return;
+    }
+    if (!fs->exists(this->basePath) && !fs->mkdir(this->basePath)) {
+        device->releaseMutex();
+        log_e("could not create %s", this->basePath);
+        return;
+    }
+    readIndex();
+    // every boot starts a new file
+    current++;
+    if (current < first || 0 == first) first = current;
+    while (ATOLL_LOG_FILE_MAX_FILES <= current - first) {
+        char path[ATOLL_LOG_FILE_PATH_LENGTH];
+        filePath(first, path, sizeof(path));
+        if (fs->exists(path)) fs->remove(path);
+        first++;
+    }
+    bool indexWritten = writeIndex();
+    device->releaseMutex();
+    if (!indexWritten) log_e("could not write index");
+    lastFlush = millis();
+    ready = true;
+    if (!Log::addSink([this](const char *buf, size_t size) { append(buf, size); })) {
+        log_e("could not add log sink");
+        ready = false;
+        return;
+    }
+    taskSetFreq(ATOLL_LOG_FILE_TASK_FREQ);
+    taskSetStack(ATOLL_LOG_FILE_TASK_STACK);
+    taskSetWakeOnNotify(true);
+    if (nullptr == instance) return;
+    this->instance = instance;
+#ifdef FEATURE_API
+    if (nullptr != api)
+        api->addCommand(Api::Command("logfile", logfileProcessor));
+#endif
+}
+
+void LogFile::loop() {
+    if (!ready) return;
+    ulong t = millis();
+    bool swapped = false;
+    portENTER_CRITICAL(&mux);
+    uint8_t other = 1 - active;
+    if (0 == lengths[other] && 0 < lengths[active] &&
+        (flushRequested ||
+         ATOLL_LOG_FILE_FLUSH_SIZE <= lengths[active] ||
+         ATOLL_LOG_FILE_FLUSH_INTERVAL < t - lastFlush)) {
+        active = other;
+        swapped = true;
+    }
+    bool empty = 0 == lengths[active];
+    portEXIT_CRITICAL(&mux);
+    if (swapped || empty) {
+        lastFlush = t;
+        flushRequested = false;
+    }
+    writePending();
+    if (rotateRequested) {
+        rotateRequested = false;
+        rotateFile();
+    }
+    if (reportedDropped != dropped) {
+        log_e("%d bytes dropped", dropped - reportedDropped);
+        reportedDropped = dropped;
+    }
+}
+
+void LogFile::flush() {
+    flushRequested = true;
+    taskNotify();
+}
+
+void LogFile::rotate() {
+    rotateRequested = true;
+    taskNotify();
+}
+
+// log sink, called with the log mutex held, must not log
+void LogFile::append(const char *buf, size_t size) {
+    if (!ready || 0 == size) return;
+    portENTER_CRITICAL(&mux);
+    if (sizeof(buffers[0]) - lengths[active] < size && 0 == lengths[1 - active])
+        active = 1 - active;  // nothing is being written, swap early
+    if (sizeof(buffers[0]) - lengths[active] < size)
+        dropped += size;
+    else {
+        memcpy(buffers[active] + lengths[active], buf, size);
+        lengths[active] += size;
+    }
+    // keep waking the task while the buffer is over the limit, the previous
+    // write may have failed to get the fs mutex
+    bool full = ATOLL_LOG_FILE_FLUSH_SIZE <= lengths[active];
+    portEXIT_CRITICAL(&mux);
+    if (full) taskNotify();
+}
+
+// Writes the inactive buffer to the current file in chunks, taking the fs mutex
+// for each chunk. Returns false if the mutex was not available or on error,
+// the rest of the buffer is written on the next loop.
+bool LogFile::writePending() {
+    portENTER_CRITICAL(&mux);
+    uint8_t pending = 1 - active;
+    size_t length = lengths[pending];
+    portEXIT_CRITICAL(&mux);
+    if (0 == length) return true;
+    char path[ATOLL_LOG_FILE_PATH_LENGTH];
+    while (written < length) {
+        // not using aquireMutex(), it logs on timeout
+        if (pdTRUE != xSemaphoreTake(*device->mutex, (TickType_t)ATOLL_LOG_FILE_MUTEX_TIMEOUT))
+            return false;
+        filePath(current, path, sizeof(path));
+        File f = fs->open(path, FILE_APPEND);
+        if (!f) {
+            device->releaseMutex();
+            log_e("could not open %s, dropping %d bytes", path, length - written);
+            break;
+        }
+        size_t toWrite = length - written;
+        if (ATOLL_LOG_FILE_WRITE_CHUNK < toWrite) toWrite = ATOLL_LOG_FILE_WRITE_CHUNK;
+        size_t wrote = f.write((uint8_t *)buffers[pending] + written, toWrite);
+        size_t fileSize = f.size();
+        f.close();
+        device->releaseMutex();
+        if (0 == wrote) {
+            log_e("could not write to %s, dropping %d bytes", path, length - written);
+            break;
+        }
+        written += wrote;
+        if (ATOLL_LOG_FILE_MAX_SIZE <= fileSize) rotateFile();
+        // give the recorder a chance to take the mutex
+        if (written < length) delay(1);
+    }
+    portENTER_CRITICAL(&mux);
+    lengths[pending] = 0;
+    portEXIT_CRITICAL(&mux);
+    written = 0;
+    return true;
+}
+
+bool LogFile::rotateFile() {
+    if (!ready) return false;
+    if (!device->aquireMutex()) {
+        log_e("could not aquire mutex");
+        return false;
+    }
+    current++;
+    char path[ATOLL_LOG_FILE_PATH_LENGTH];
+    while (ATOLL_LOG_FILE_MAX_FILES <= current - first) {
+        filePath(first, path, sizeof(path));
+        if (fs->exists(path) && !fs->remove(path))
+            log_e("could not remove %s", path);
+        first++;
+    }
+    bool indexWritten = writeIndex();
+    device->releaseMutex();
+    if (!indexWritten) log_e("could not write index");
+    return indexWritten;
+}
+
+// reads the first and the last sequence number from the index,
+// falls back to scanning the directory, call with the fs mutex held
+bool LogFile::readIndex() {
+    first = 0;
+    current = 0;
+    char path[ATOLL_LOG_FILE_PATH_LENGTH];
+    snprintf(path, sizeof(path), "%s/%s", basePath, ATOLL_LOG_FILE_INDEX_NAME);
+    File f = fs->open(path);
+    if (f) {
+        char line[16];
+        uint32_t seq;
+        while (f.available()) {
+            size_t len = f.readBytesUntil('\n', line, sizeof(line) - 1);
+            line[len] = '\0';
+            if (!seqFromName(line, &seq)) continue;
+            if (0 == first) first = seq;
+            current = seq;
+        }
+        f.close();
+        if (0 < current) return true;
+    }
+    File dir = fs->open(basePath);
+    if (!dir || !dir.isDirectory()) return false;
+    File entry;
+    uint32_t seq;
+    while (entry = dir.openNextFile()) {
+        const char *name = strrchr(entry.name(), '/');
+        name = nullptr == name ? entry.name() : name + 1;
+        if (seqFromName(name, &seq)) {
+            if (0 == first || seq < first) first = seq;
+            if (current < seq) current = seq;
+        }
+        entry.close();
+    }
+    dir.close();
+    return 0 < current;
+}
+
+// writes the names of the kept files, oldest first, call with the fs mutex held
+bool LogFile::writeIndex() {
+    char path[ATOLL_LOG_FILE_PATH_LENGTH];
+    snprintf(path, sizeof(path), "%s/%s", basePath, ATOLL_LOG_FILE_INDEX_NAME);
+    File f = fs->open(path, FILE_WRITE);
+    if (!f) return false;
+    char name[16];
+    bool ok = true;
+    for (uint32_t seq = first; seq <= current && ok; seq++) {
+        fileName(seq, name, sizeof(name));
+        ok = 0 < f.print(name) && 0 < f.print('\n');
+    }
+    f.close();
+    return ok;
+}
+
+void LogFile::filePath(uint32_t seq, char *buf, size_t size) {
+    snprintf(buf, size, "%s/%08u.log", basePath, seq);
+}
+
+void LogFile::fileName(uint32_t seq, char *buf, size_t size) {
+    snprintf(buf, size, "%08u.log", seq);
+}
+
+// accepts only names in the form 00000123.log
+bool LogFile::seqFromName(const char *name, uint32_t *seq) {
+    if (12 != strlen(name) || 8 != strspn(name, "0123456789") || 0 != strcmp(name + 8, ".log"))
+        return false;
+    *seq = (uint32_t)strtoul(name, nullptr, 10);
+    return 0 < *seq;
+}
+
+#ifdef FEATURE_API
+// logfile[=files|flush|rotate|get:<name>;offset:<n>]
+// files: files:name:size;...
+// get: get:name:offset;<binary data>, argInvalid when offset is past the end
+Api::Result *LogFile::logfileProcessor(Api::Message *msg) {
+    if (nullptr == instance || !instance->ready) return Api::error();
+    if (0 == strlen(msg->arg) || msg->argIs("files")) {
+        snprintf(msg->reply, sizeof(msg->reply), "files:");
+        char path[ATOLL_LOG_FILE_PATH_LENGTH];
+        char name[16];
+        char entry[32];
+        for (uint32_t seq = instance->first; seq <= instance->current; seq++) {
+            if (!instance->device->aquireMutex()) {
+                log_e("mutex error");
+                return Api::internalError();
+            }
+            instance->filePath(seq, path, sizeof(path));
+            File f = instance->fs->open(path);
+            size_t size = f ? f.size() : 0;
+            bool exists = (bool)f;
+            if (f) f.close();
+            instance->device->releaseMutex();
+            if (!exists) continue;
+            instance->fileName(seq, name, sizeof(name));
+            snprintf(entry, sizeof(entry), "%s%s:%u",
+                     6 < strlen(msg->reply) ? ";" : "", name, size);
+            if (sizeof(msg->reply) - 1 <= strlen(msg->reply) + strlen(entry)) break;
+            msg->replyAppend(entry);
+        }
+        return Api::success();
+    }
+    if (msg->argIs("flush")) {
+        instance->flush();
+        return Api::success();
+    }
+    if (msg->argIs("rotate")) {
+        instance->rotate();
+        return Api::success();
+    }
+    if (msg->argStartsWith("get:")) {
+        char name[16] = "";
+        uint32_t seq;
+        if (!msg->argGetParam("get:", name, sizeof(name)) || !instance->seqFromName(name, &seq))
+            return Api::argInvalid();
+        char offsetStr[sizeof(int) * 8 + 1];
+        if (!msg->argGetParam("offset:", offsetStr, sizeof(offsetStr))) {
+            log_e("missing offset in '%s'", msg->arg);
+            return Api::argInvalid();
+        }
+        int offset = atoi(offsetStr);
+        char offsetCmp[sizeof(offsetStr)];
+        snprintf(offsetCmp, sizeof(offsetCmp), "%d", offset);
+        if (offset < 0 || 0 != strcmp(offsetStr, offsetCmp)) {
+            log_e("invalid offset %s", offsetStr);
+            return Api::argInvalid();
+        }
+        if (!instance->device->aquireMutex()) {
+            log_e("mutex error");
+            return Api::internalError();
+        }
+        char path[ATOLL_LOG_FILE_PATH_LENGTH];
+        instance->filePath(seq, path, sizeof(path));
+        File f = instance->fs->open(path);
+        if (!f) {
+            instance->device->releaseMutex();
+            log_e("could not open %s", path);
+            return Api::argInvalid();
+        }
+        if (f.size() <= (size_t)offset || !f.seek((uint32_t)offset)) {
+            f.close();
+            instance->device->releaseMutex();
+            return Api::argInvalid();
+        }
+        snprintf(msg->reply, sizeof(msg->reply), "get:%s:%s;", name, offsetStr);
+        size_t replyTextLen = strlen(msg->reply);
+        size_t read = f.readBytes(msg->reply + replyTextLen, sizeof(msg->reply) - replyTextLen - 9);
+        f.close();
+        instance->device->releaseMutex();
+        msg->replyLength = replyTextLen + read;
+        return Api::success();
+    }
+    return Api::argInvalid();
+}
+#endif
+
+#endif
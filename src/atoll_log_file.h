@@ -0,0 +1,115 @@
+#if !defined(__atoll_log_file_h) && defined(FEATURE_LOG_FILE)
+#define __atoll_log_file_h
+
+#include <Arduino.h>
+#include "FS.h"
+
+#include "atoll_task.h"
+#include "atoll_fs.h"
+#include "atoll_log.h"
+#ifdef FEATURE_API
+#include "atoll_api.h"
+#endif
+
+#ifndef ATOLL_LOG_FILE_BASE_PATH
+#define ATOLL_LOG_FILE_BASE_PATH "/log"
+#endif
+#ifndef ATOLL_LOG_FILE_INDEX_NAME
+#define ATOLL_LOG_FILE_INDEX_NAME "index"
+#endif
+#ifndef ATOLL_LOG_FILE_PATH_LENGTH
+#define ATOLL_LOG_FILE_PATH_LENGTH 32
+#endif
+#ifndef ATOLL_LOG_FILE_BUFFER_SIZE
+#define ATOLL_LOG_FILE_BUFFER_SIZE 4096  // bytes per buffer, there are two
+#endif
+#ifndef ATOLL_LOG_FILE_FLUSH_SIZE
+#define ATOLL_LOG_FILE_FLUSH_SIZE 2048  // write the buffer when it has this many bytes
+#endif
+#ifndef ATOLL_LOG_FILE_FLUSH_INTERVAL
+#define ATOLL_LOG_FILE_FLUSH_INTERVAL 10000  // ms, write the buffer at least this often
+#endif
+#ifndef ATOLL_LOG_FILE_WRITE_CHUNK
+#define ATOLL_LOG_FILE_WRITE_CHUNK 512  // max bytes written while holding the fs mutex
+#endif
+#ifndef ATOLL_LOG_FILE_MUTEX_TIMEOUT
+#define ATOLL_LOG_FILE_MUTEX_TIMEOUT 5  // ticks to wait for the fs mutex, retry on the next loop
+#endif
+#ifndef ATOLL_LOG_FILE_MAX_SIZE
+#define ATOLL_LOG_FILE_MAX_SIZE 131072  // bytes, start a new file when the current one reaches this size
+#endif
+#ifndef ATOLL_LOG_FILE_MAX_FILES
+#define ATOLL_LOG_FILE_MAX_FILES 16  // number of files to keep, the oldest is deleted on rotation
+#endif
+#ifndef ATOLL_LOG_FILE_TASK_FREQ
+#define ATOLL_LOG_FILE_TASK_FREQ 0.2  // Hz, max time between loops, the sink wakes the task when a buffer is ready
+#endif
+#ifndef ATOLL_LOG_FILE_TASK_STACK
+#define ATOLL_LOG_FILE_TASK_STACK 4096
+#endif
+
+namespace Atoll {
+
+// Writes the log to numbered files in ATOLL_LOG_FILE_BASE_PATH.
+// Messages are collected in RAM by a log sink and written by the task in
+// chunks of ATOLL_LOG_FILE_WRITE_CHUNK bytes, the fs mutex is released between
+// chunks so the recorder is not delayed. Every boot starts a new file, files
+// are rotated when they reach ATOLL_LOG_FILE_MAX_SIZE and only the newest
+// ATOLL_LOG_FILE_MAX_FILES are kept. The index file lists the kept files,
+// oldest first.
+class LogFile : public Task {
+   public:
+    const char *taskName() override { return "LogFile"; }
+
+    void setup(Fs *device,
+               LogFile *instance,
+#ifdef FEATURE_API
+               Api *api = nullptr,
+#endif
+               const char *basePath = ATOLL_LOG_FILE_BASE_PATH);
+    void loop() override;
+
+    // requests writing the buffered messages on the next loop
+    void flush();
+    // requests starting a new file on the next loop
+    void rotate();
+
+    uint32_t first = 0;    // sequence number of the oldest file
+    uint32_t current = 0;  // sequence number of the file being written
+    uint32_t dropped = 0;  // number of bytes dropped because the buffers were full
+
+   protected:
+    static LogFile *instance;
+    Fs *device = nullptr;
+    fs::FS *fs = nullptr;
+    const char *basePath = ATOLL_LOG_FILE_BASE_PATH;
+    bool ready = false;
+
+    char buffers[2][ATOLL_LOG_FILE_BUFFER_SIZE];
+    size_t lengths[2] = {0, 0};
+    uint8_t active = 0;           // index of the buffer the sink appends to
+    size_t written = 0;           // bytes of the inactive buffer already written
+    bool flushRequested = false;  //
+    bool rotateRequested = false;  // rotate() was called, handled by the task
+    ulong lastFlush = 0;          // millis() when the active buffer was last swapped
+    uint32_t reportedDropped = 0;
+    portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+
+    void append(const char *buf, size_t size);
+    bool writePending();
+    // closes the current file and starts a new one, called by the task
+    bool rotateFile();
+    bool readIndex();
+    bool writeIndex();
+    void filePath(uint32_t seq, char *buf, size_t size);
+    void fileName(uint32_t seq, char *buf, size_t size);
+    bool seqFromName(const char *name, uint32_t *seq);
+
+#ifdef FEATURE_API
+    static Api::Result *logfileProcessor(Api::Message *msg);
+#endif
+};
+
+}  // namespace Atoll
+
+#endif
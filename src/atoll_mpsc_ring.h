@@ -0,0 +1,92 @@
+#ifndef __atoll_mpsc_ring_h
+#define __atoll_mpsc_ring_h
+
+#include <Arduino.h>
+#include <atomic>
+
+namespace Atoll {
+
+// Bounded lock-free multi-producer single-consumer ring.
+// Producers reserve a slot by advancing the head atomically, copy the item and
+// commit the slot by publishing its sequence number, so push() never blocks
+// and can be used from any task or ISR. When the ring is full the new item
+// is dropped and counted. pop() must only be called from a single task.
+// Size must be a power of 2.
+template <typename T, uint32_t Size>
+class MpscRing {
+    static_assert(1 < Size && 0 == (Size & (Size - 1)), "size must be a power of 2");
+
+   public:
+    MpscRing() {
+        for (uint32_t i = 0; i < Size; i++)
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    // returns false if the ring is full
+    bool push(const T &item) {
+        uint32_t pos = head.load(std::memory_order_relaxed);
+        Slot *slot;
+        for (;;) {
+            slot = &slots[pos & (Size - 1)];
+            int32_t diff = (int32_t)(slot->sequence.load(std::memory_order_acquire) - pos);
+            if (0 == diff) {
+                // slot is free, try to reserve it
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                // the consumer has not released the slot yet
+                droppedCount.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                // another producer has reserved the slot
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+        slot->item = item;
+        // commit
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        pushedCount.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // returns false if the ring is empty or the next item has not been committed yet
+    bool pop(T *item) {
+        Slot *slot = &slots[tail & (Size - 1)];
+        int32_t diff = (int32_t)(slot->sequence.load(std::memory_order_acquire) - (tail + 1));
+        if (diff < 0) return false;
+        *item = slot->item;
+        // release the slot for the next round
+        slot->sequence.store(tail + Size, std::memory_order_release);
+        tail++;
+        return true;
+    }
+
+    // number of reserved slots, approximate when called from a producer
+    uint32_t size() {
+        return head.load(std::memory_order_relaxed) - tail;
+    }
+
+    uint32_t capacity() { return Size; }
+
+    // number of items pushed successfully
+    uint32_t pushed() { return pushedCount.load(std::memory_order_relaxed); }
+
+    // number of items dropped because the ring was full
+    uint32_t dropped() { return droppedCount.load(std::memory_order_relaxed); }
+
+   protected:
+    struct Slot {
+        std::atomic<uint32_t> sequence;
+        T item;
+    };
+
+    Slot slots[Size];
+    std::atomic<uint32_t> head{0};  // next position to reserve, shared by the producers
+    uint32_t tail = 0;              // next position to pop, owned by the consumer
+    std::atomic<uint32_t> pushedCount{0};
+    std::atomic<uint32_t> droppedCount{0};
+};
+
+}  // namespace Atoll
+
+#endif
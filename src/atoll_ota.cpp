@@ -40,6 +40,8 @@ void Ota::setup(const char *hostName, uint16_t port, bool mdnsEnabled) {
         .onError([this](ota_error_t error) {
             onError(error);
         });
+    // the freq is raised while uploading
+    taskSetGovernor(ATOLL_OTA_TASK_FREQ, ATOLL_OTA_TASK_FREQ_WHEN_UPLOADING, TaskActivity::uploading);
     // start();
     serving = true;
 }
@@ -83,9 +85,7 @@ void Ota::onStart() {
     // log_i("setting cpu freq to 240 MHz");
     // setCpuFrequencyMhz(240);
 
-    log_i("setting task freq to %d Hz", ATOLL_OTA_TASK_FREQ_WHEN_UPLOADING);
-    savedTaskFreq = _taskFreq;
-    taskSetFreq(ATOLL_OTA_TASK_FREQ_WHEN_UPLOADING);
+    taskSetActivity(TaskActivity::uploading, true);
 
     // log_i("Disabling sleep");
     //  board.sleepEnabled = false;
@@ -95,7 +95,7 @@ void Ota::onEnd() {
     // log_i("Enabling sleep");
     // board.sleepEnabled = true;
 
-    taskSetFreq(savedTaskFreq);
+    taskSetActivity(TaskActivity::uploading, false);
     log_i("end");
     if (100 == lastPercent) {
         log_i("rebooting...");
@@ -126,6 +126,7 @@ void Ota::onError(ota_error_t error) {
     else
         log_e("%d", error);
     log_e("Free heap: %d", ESP.getFreeHeap());
+    taskSetActivity(TaskActivity::uploading, false);
 }
 
 #endif
\ No newline at end of file
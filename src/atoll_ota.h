@@ -33,7 +33,6 @@ class Ota : public Task {
     virtual void onError(ota_error_t error);
 
    protected:
-    uint16_t savedTaskFreq = ATOLL_OTA_TASK_FREQ;
     uint8_t lastPercent = 0;
 };
 
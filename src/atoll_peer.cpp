@@ -31,6 +31,7 @@ void Peer::loop() {
         log_d("%s setting conn params", saved.name);
         setConnectionParams(connParamsProfile);
     }
+    checkAttributes();
 }
 
 // format: address,addressType,type,name[,passkey]
@@ -276,23 +277,76 @@ connect:
     lastConnectionAttempt = millis();
     connParamsProfile = APCPP_INITIAL;
     setConnectionParams(connParamsProfile);
-    client->setConnectTimeout(2000);
+    client->setConnectTimeout(ATOLL_BLE_PEER_CONNECT_TIMEOUT);
+    firstNotificationTime = 0;
+    reusingAttributes = canReuseAttributes();
     beforeConnect();
-    if (!connectClient()) {
+    if (!connectClient(!reusingAttributes)) {
         // log_d("%s failed to connect client", saved.name);
         afterConnect();
         goto fail;
     }
-    log_i("%s connected", saved.name);
-    afterConnect();
-    goto end;
+    log_d("%s connecting", saved.name);
+    return;  // onConnect() or onConnectFail() follows
 
 fail:
     unsetClient();
-
-end:
-    // log_d("end");
     connecting = false;
+    scheduleConnect(true);
+}
+
+void Peer::setupConnection() {
+    setupPending = false;
+    afterConnect();
+    if (!isConnected()) return;
+    log_i("%s connected", saved.name);
+    onConnected(client);
+    if (0 < disconnectedAt) {
+        reconnectTime = millis() - disconnectedAt;
+        reconnects++;
+        disconnectedAt = 0;
+        log_i("%s reconnected in %lums", saved.name, reconnectTime);
+    }
+    failures = 0;
+    backoff = 0;
+}
+
+void Peer::scheduleConnect(bool failed) {
+    ulong t = millis();
+    if (!failed) {
+        nextConnectionAttempt = t;
+        return;
+    }
+    failures++;
+    backoff = 0 == backoff ? ATOLL_BLE_PEER_BACKOFF_MIN : backoff * 2;
+    if (ATOLL_BLE_PEER_BACKOFF_MAX < backoff) backoff = ATOLL_BLE_PEER_BACKOFF_MAX;
+    // spread the attempts of peers that failed together
+    long jitter = (long)backoff * ATOLL_BLE_PEER_BACKOFF_JITTER / 100;
+    nextConnectionAttempt = t + backoff + random(-jitter, jitter + 1);
+    log_d("%s attempt %d failed, next in %ldms", saved.name, failures.load(), (long)(nextConnectionAttempt - t));
+}
+
+bool Peer::connectDue(ulong t) {
+    return enabled &&
+           shouldConnect &&
+           !connecting &&
+           !setupPending &&
+           !isConnected() &&
+           0 <= (long)(t - nextConnectionAttempt);
+}
+
+void Peer::onSeen() {
+    if (0 == failures || connecting || isConnected()) return;
+    log_d("%s seen, skipping backoff", saved.name);
+    nextConnectionAttempt = millis();
+}
+
+const char* Peer::connectionState() {
+    if (!enabled || !shouldConnect) return "disabled";
+    if (setupPending) return "setup";
+    if (isConnected()) return "connected";
+    if (connecting) return "connecting";
+    return "waiting";
 }
 
 void Peer::beforeConnect() {}
@@ -300,6 +354,9 @@ void Peer::afterConnect() {}
 
 void Peer::disconnect() {
     shouldConnect = false;
+    disconnectedAt = 0;
+    if (connecting && hasClient())
+        client->cancelConnect();
     if (isConnected()) {
         // setConnectionParams(APCPP_INITIAL);  // speed up unsub // E NimBLEDevice: ble_gap_security_initiate: rc=19 HCI request timed out; controller unresponsive.
         // unsubscribeChars(client);
@@ -329,6 +386,12 @@ void Peer::unsetClient() {
     if (nullptr != client)
         client->setClientCallbacks(nullptr);  // set default callbacks
     client = nullptr;
+    forgetRemoteChars();
+}
+
+void Peer::forgetAttributes() {
+    attributesClient = nullptr;
+    dbHashKnown = false;
 }
 
 bool Peer::hasClient() {
@@ -344,7 +407,9 @@ bool Peer::connectClient(bool deleteAttributes) {
         log_d("%s is disabled", saved.name);
         return false;
     }
-    return hasClient() && client->connect(BLEAddress(saved.address, saved.addressType), deleteAttributes);
+    if (!hasClient()) return false;
+    if (deleteAttributes) forgetRemoteChars();
+    return client->connect(BLEAddress(saved.address, saved.addressType), deleteAttributes, true);
 }
 
 void Peer::subscribeChars(BLEClient* client) {
@@ -356,11 +421,12 @@ void Peer::subscribeChars(BLEClient* client) {
         log_e("not connected");
         return;
     }
+    // resolves the remote chars, the chars in the table subscribe through onNotify()
+    buildHandleTable(client);
     for (int8_t i = 0; i < charsMax; i++)
         if (nullptr != chars[i]) {
             if (!chars[i]->subscribeOnConnect()) {
                 log_i("%s not subscribing %s", saved.name, chars[i]->label);
-                chars[i]->getRemoteChar(client);  // get remote service and char
                 continue;
             }
             log_i("%s subscribing %s", saved.name, chars[i]->label);
@@ -368,6 +434,45 @@ void Peer::subscribeChars(BLEClient* client) {
         }
 }
 
+// resolves the remote chars once per connection and indexes them by handle
+void Peer::buildHandleTable(BLEClient* client) {
+    clearHandleTable();
+    HandleTable* table = &handleTables[nextHandleTable];
+    nextHandleTable = (nextHandleTable + 1) % 2;
+    for (uint16_t i = 0; i < ATOLL_BLE_PEER_HANDLE_TABLE_SIZE; i++)
+        table->index[i] = -1;
+    uint16_t lowest = 0;
+    for (int8_t i = 0; i < charsMax; i++) {
+        if (nullptr == chars[i]) continue;
+        BLERemoteCharacteristic* rc = chars[i]->getRemoteChar(client);
+        if (nullptr == rc) continue;
+        if (0 == lowest || rc->getHandle() < lowest) lowest = rc->getHandle();
+    }
+    table->base = lowest;
+    for (int8_t i = 0; i < charsMax; i++) {
+        if (nullptr == chars[i]) continue;
+        BLERemoteCharacteristic* rc = chars[i]->getRemoteChar(client);
+        if (nullptr == rc) continue;
+        uint16_t offset = rc->getHandle() - table->base;
+        if (ATOLL_BLE_PEER_HANDLE_TABLE_SIZE <= offset) {
+            log_w("%s %s handle %d is out of the table", saved.name, chars[i]->label, rc->getHandle());
+            continue;
+        }
+        table->index[offset] = i;
+    }
+    handleTable.store(table, std::memory_order_release);
+}
+
+void Peer::clearHandleTable() {
+    handleTable.store(nullptr, std::memory_order_release);
+}
+
+void Peer::forgetRemoteChars() {
+    clearHandleTable();
+    for (int8_t i = 0; i < charsMax; i++)
+        if (nullptr != chars[i]) chars[i]->forgetRemoteChar();
+}
+
 void Peer::unsubscribeChars(BLEClient* client) {
     if (!isConnected()) {
         log_e("not connected");
@@ -434,6 +539,9 @@ PeerCharacteristic* Peer::getChar(const char* label) {
 // remove char at index
 bool Peer::removeCharAt(int8_t index) {
     if (charsMax <= index) return false;
+    for (HandleTable& table : handleTables)
+        for (uint16_t i = 0; i < ATOLL_BLE_PEER_HANDLE_TABLE_SIZE; i++)
+            if (index == table.index[i]) table.index[i] = -1;
     if (nullptr != chars[index]) chars[index]->peer = nullptr;
     chars[index] = nullptr;
     return true;
@@ -471,15 +579,35 @@ bool Peer::isJkBms() {
     return nullptr != strchr(saved.type, 'B');
 }
 
+// called by the NimBLE host, the setup is left to the task of BleClient
 void Peer::onConnect(BLEClient* client) {
+    setupPending = true;  // before clearing connecting, connectDue() must never see neither
+    connecting = false;
+    changedCallback(this);
+}
+
+void Peer::onConnectFail(BLEClient* client, int reason) {
+    log_i("%s could not connect, reason %d", saved.name, reason);
+    connecting = false;
+    afterConnect();
+    scheduleConnect(true);
+    changedCallback(this);
+}
+
+void Peer::onConnected(BLEClient* client) {
     if (!isConnected()) {
         log_i("%s not connected", saved.name);
         return;
     }
     log_d("%s connected", saved.name);
 
-    log_d("%s discovering attributes...", saved.name);
-    client->discoverAttributes();
+    notifications = 0;
+    attributesCached = reusingAttributes && attributesValid(client);
+    if (attributesCached)
+        log_d("%s reusing attributes", saved.name);
+    else
+        discoverAttributes(client);
+    subscribeServiceChanged(client);
 
     // log_d("%s subscribing...", name);
     subscribeChars(client);
@@ -487,16 +615,117 @@ void Peer::onConnect(BLEClient* client) {
     // log_d("%s requesting conn param update...", saved.name);
     // setConnectionParams(client, APCPP_ESTABLISHED);
 
+    EventBus::publish(EventBus::PEER_CONNECTION, 1, this);
     log_d("calling connectedCallback");
     connectedCallback(this);
 }
 
+bool Peer::canReuseAttributes() {
+    return attributeCache &&
+           hasClient() &&
+           client == attributesClient &&
+           client->getPeerAddress() == BLEAddress(saved.address, saved.addressType);
+}
+
+// call after connecting without deleting the attributes
+bool Peer::attributesValid(BLEClient* client) {
+    BLERemoteService* gatt = client->getService(BLEUUID(GENERIC_ATTRIBUTE_SERVICE_UUID));
+    // without Service Changed the server database must not change
+    if (nullptr == gatt || nullptr == gatt->getCharacteristic(BLEUUID(SERVICE_CHANGED_CHAR_UUID)))
+        return true;
+    uint8_t hash[DATABASE_HASH_LENGTH];
+    if (dbHashKnown && readDbHash(client, hash)) {
+        if (0 == memcmp(hash, dbHash, sizeof(hash))) return true;
+        log_i("%s database hash changed", saved.name);
+        return false;
+    }
+    // changes are only indicated to bonded clients
+    return client->getConnInfo().isBonded();
+}
+
+void Peer::discoverAttributes(BLEClient* client) {
+    log_d("%s discovering attributes...", saved.name);
+    forgetRemoteChars();  // discovery replaces the remote chars
+    client->discoverAttributes();
+    discoveries++;
+    attributesClient = client;
+    dbHashKnown = readDbHash(client, dbHash);
+    dbHashUnchanged = dbHashKnown && savedDbHashKnown && 0 == memcmp(dbHash, savedDbHash, DATABASE_HASH_LENGTH);
+    if (dbHashUnchanged)
+        log_i("%s database hash unchanged since it was saved", saved.name);
+    else if (dbHashKnown) {
+        setSavedDbHash(dbHash);
+        dbHashCallback(this);
+    }
+}
+
+void Peer::setSavedDbHash(const uint8_t* hash) {
+    memcpy(savedDbHash, hash, DATABASE_HASH_LENGTH);
+    savedDbHashKnown = true;
+}
+
+bool Peer::getSavedDbHash(uint8_t* hash) {
+    if (!savedDbHashKnown) return false;
+    memcpy(hash, savedDbHash, DATABASE_HASH_LENGTH);
+    return true;
+}
+
+bool Peer::readDbHash(BLEClient* client, uint8_t* hash) {
+    BLERemoteService* gatt = client->getService(BLEUUID(GENERIC_ATTRIBUTE_SERVICE_UUID));
+    if (nullptr == gatt) return false;
+    BLERemoteCharacteristic* rc = gatt->getCharacteristic(BLEUUID(DATABASE_HASH_CHAR_UUID));
+    if (nullptr == rc || !rc->canRead()) return false;
+    NimBLEAttValue value = rc->readValue();
+    if (DATABASE_HASH_LENGTH != value.length()) {
+        log_e("%s invalid database hash length %d", saved.name, value.length());
+        return false;
+    }
+    memcpy(hash, value.data(), DATABASE_HASH_LENGTH);
+    return true;
+}
+
+void Peer::subscribeServiceChanged(BLEClient* client) {
+    BLERemoteService* gatt = client->getService(BLEUUID(GENERIC_ATTRIBUTE_SERVICE_UUID));
+    if (nullptr == gatt) return;
+    BLERemoteCharacteristic* rc = gatt->getCharacteristic(BLEUUID(SERVICE_CHANGED_CHAR_UUID));
+    if (nullptr == rc || !rc->canIndicate()) return;
+    // called by the NimBLE host, discovery is left to loop()
+    if (!rc->subscribe(false, [this](BLERemoteCharacteristic*, uint8_t*, size_t, bool) {
+            attributesChanged = true;
+        }))
+        log_e("%s could not subscribe to service changed", saved.name);
+}
+
+// rediscovers the attributes after a Service Changed indication
+void Peer::checkAttributes() {
+    if (!attributesChanged) return;
+    attributesChanged = false;
+    if (!isConnected()) {
+        forgetAttributes();
+        return;
+    }
+    log_i("%s service changed, discovering attributes", saved.name);
+    attributesCached = false;
+    discoverAttributes(client);
+    subscribeServiceChanged(client);
+    subscribeChars(client);
+}
+
 /**
  * @brief Called when disconnected from the server.
  * @param [in] device->client A pointer to the calling client object.
  */
 void Peer::onDisconnect(BLEClient* client, int reason) {
     log_i("%s disconnected, reason %d", saved.name, reason);
+    clearHandleTable();
+    setupPending = false;
+    connecting = false;
+    if (enabled && shouldConnect) {
+        if (0 == disconnectedAt) disconnectedAt = millis();
+        scheduleConnect(false);
+    }
+    EventBus::publish(EventBus::PEER_CONNECTION, 0, this);
+    disconnectedCallback(this);
 }
 
 /**
@@ -554,9 +783,21 @@ bool Peer::onConfirmPIN(uint32_t pin) {
 }
 
 void Peer::onNotify(BLERemoteCharacteristic* c, uint8_t* data, size_t length, bool isNotify) {
-    char buf[length];
-    strncpy(buf, (char*)data, length);
-    log_d("%s uuid: %s, data: '%s', len: %d", saved.name, c->getUUID().toString().c_str(), buf, length);
+    onNotification();
+    PeerCharacteristic* pc = charByHandle(c->getHandle());
+    if (nullptr == pc) {
+        log_d("%s no char for handle %d, len: %d", saved.name, c->getHandle(), length);
+        return;
+    }
+    pc->onNotify(c, data, length, isNotify);
+}
+
+void Peer::onNotification() {
+    if (0 == notifications++) {
+        firstNotificationTime = millis() - lastConnectionAttempt;
+        log_i("%s first notification after %lums%s", saved.name, firstNotificationTime,
+              attributesCached ? ", attributes reused" : "");
+    }
 }
 
 PowerMeter::PowerMeter(
@@ -566,6 +807,7 @@ PowerMeter::PowerMeter(
     : Peer(
           saved,
           customBattChar) {
+    priority = 3;
     addChar(nullptr != customPowerChar
                 ? customPowerChar
                 : new PeerCharacteristicPower());
@@ -596,10 +838,12 @@ ESPM::ESPM(
     addChar(nullptr != customTemperatureChar
                 ? customTemperatureChar
                 : new PeerCharacteristicTemperature());
+    // looked up once, loop() and sendApiCommand() use them often
+    apiTx = (PeerCharacteristicApiTX*)getChar("ApiTX");
+    apiRx = (PeerCharacteristicApiRX*)getChar("ApiRX");
 }
 
 void ESPM::loop() {
-    PeerCharacteristicApiTX* apiTx = (PeerCharacteristicApiTX*)getChar("ApiTX");
     if (nullptr == apiTx)
         log_e("%s apiTx is null", saved.name);
     else
@@ -629,15 +873,17 @@ void ESPM::afterConnect() {
         Ble::setMTU(savedMtu);
 }
 
-void ESPM::onConnect(BLEClient* client) {
-    PowerMeter::onConnect(client);
+void ESPM::onConnected(BLEClient* client) {
+    PowerMeter::onConnected(client);
+    // request fragmented replies, so that long replies arrive complete without an extra read
+    if (!sendApiCommand("system=frag:1"))
+        log_e("%s could not send frag request", saved.name);
     if (!sendApiCommand("init"))
         log_e("%s could not send init request", saved.name);
 }
 
 bool ESPM::sendApiCommand(const char* command) {
-    PeerCharacteristicApiRX* apiRX = (PeerCharacteristicApiRX*)getChar("ApiRX");
-    if (nullptr == apiRX) {
+    if (nullptr == apiRx) {
         log_e("api rx char is null");
         return false;
     }
@@ -647,7 +893,7 @@ bool ESPM::sendApiCommand(const char* command) {
     }
     log_d("%s sending command '%s'", saved.name, command);
     auto sc = String(command);
-    if (!apiRX->write(client, sc, sc.length())) {
+    if (!apiRx->write(client, sc, sc.length())) {
         log_e("%s could not write char", saved.name);
         return false;
     }
@@ -661,6 +907,7 @@ HeartrateMonitor::HeartrateMonitor(
     PeerCharacteristicBattery* customBattChar)
     : Peer(saved,
            customBattChar) {
+    priority = 2;
     addChar(nullptr != customHrChar
                 ? customHrChar
                 : new PeerCharacteristicHeartrate());
@@ -671,14 +918,16 @@ Vesc::Vesc(Saved saved,
            PeerCharacteristicVescTX* customVescTX)
     : Peer(saved) {
     deleteChars("Battery");
-    addChar(nullptr != customVescRX
-                ? customVescRX
-                : new PeerCharacteristicVescRX());
+    PeerCharacteristicVescRX* vescRX = nullptr != customVescRX
+                                           ? customVescRX
+                                           : new PeerCharacteristicVescRX();
+    addChar(vescRX);
     PeerCharacteristicVescTX* vescTX = nullptr != customVescTX
                                            ? customVescTX
                                            : new PeerCharacteristicVescTX();
     uart = new VescUart(250);  // 250 ms timeout on waiting for reply
     uartBleStream = new VescUartBleStream();
+    uartBleStream->vescRX = vescRX;
     vescTX->stream = uartBleStream;
     addChar(vescTX);
     uart->setSerialPort(uartBleStream);
@@ -3,6 +3,7 @@
 
 #include <Arduino.h>
 #include <NimBLEDevice.h>
+#include <atomic>
 
 #include "atoll_log.h"
 
@@ -27,6 +28,26 @@
 #define ATOLL_BLE_PEER_DEVICE_MAX_CHARACTERISTICS 8
 #endif
 
+#ifndef ATOLL_BLE_PEER_HANDLE_TABLE_SIZE
+#define ATOLL_BLE_PEER_HANDLE_TABLE_SIZE 64  // attribute handles covered by the notification dispatch table
+#endif
+
+#ifndef ATOLL_BLE_PEER_CONNECT_TIMEOUT
+#define ATOLL_BLE_PEER_CONNECT_TIMEOUT 2000  // ms
+#endif
+
+#ifndef ATOLL_BLE_PEER_BACKOFF_MIN
+#define ATOLL_BLE_PEER_BACKOFF_MIN 500  // ms to wait after the first failed connection attempt
+#endif
+
+#ifndef ATOLL_BLE_PEER_BACKOFF_MAX
+#define ATOLL_BLE_PEER_BACKOFF_MAX 60000  // ms, the wait doubles on each failed attempt up to this
+#endif
+
+#ifndef ATOLL_BLE_PEER_BACKOFF_JITTER
+#define ATOLL_BLE_PEER_BACKOFF_JITTER 25  // +-% randomization of the wait
+#endif
+
 #ifndef ATOLL_BLE_PEER_DEVICE_ADDRESS_LENGTH
 #define ATOLL_BLE_PEER_DEVICE_ADDRESS_LENGTH 18
 #endif
@@ -56,10 +77,24 @@ class Peer : public BLEClientCallbacks {
 
     bool enabled = true;  // TODO is there a good reason for having both enabled and shouldConnect?
     bool shouldConnect = true;
-    bool connecting = false;
+    // written by the NimBLE host and the BleClient task
+    std::atomic<bool> connecting{false};    // an asynchronous connection attempt is in progress
+    std::atomic<bool> setupPending{false};  // connected, setupConnection() has not run yet
     ulong lastConnectionAttempt = 0;
+    uint8_t priority = 1;        // peers with higher priority connect first
+    std::atomic<ulong> nextConnectionAttempt{0};  // millis() after which the next attempt is due
+    uint32_t backoff = 0;        // ms waited after the last failed attempt
+    std::atomic<uint16_t> failures{0};  // consecutive failed attempts
+    ulong disconnectedAt = 0;    // millis() of the last dropout, 0 if none pending
+    uint16_t reconnects = 0;     // reconnections after dropouts
+    ulong reconnectTime = 0;     // ms from the last dropout to the connection set up
     bool markedForRemoval = false;
     uint8_t connParamsProfile = APCPP_INITIAL;
+    bool attributeCache = true;      // reuse the attributes discovered on the previous connection if still valid
+    bool attributesCached = false;   // the current connection reused the attributes
+    uint16_t discoveries = 0;        // full attribute discoveries
+    ulong firstNotificationTime = 0;  // ms from the connection attempt to the first notification, 0: none yet
+    bool dbHashUnchanged = false;    // the hash read after the last discovery matched the saved one
     static const uint8_t packedMaxLength = ATOLL_BLE_PEER_DEVICE_PACKED_LENGTH;  // for convenience
 
     enum ConnectionParamsProfile {
@@ -82,14 +117,26 @@ class Peer : public BLEClientCallbacks {
         Saved* saved);
 
     virtual void setConnectionParams(uint8_t profile);
+    // starts an asynchronous connection attempt, see onConnect() and onConnectFail()
     virtual void connect();
     virtual void disconnect();
+    // called by BleClient from its task after onConnect()
+    virtual void setupConnection();
+    // schedules the next attempt after a failed one with exponential backoff and jitter,
+    // or right away after a dropout
+    virtual void scheduleConnect(bool failed);
+    virtual bool connectDue(ulong t);
+    // the peer was seen advertising, skip the backoff
+    virtual void onSeen();
+    virtual const char* connectionState();
 
     virtual bool setClient(BLEClient* client);
     virtual BLEClient* getClient();
     virtual void unsetClient();
     virtual bool hasClient();
     virtual bool isConnected();
+    // drops the attributes discovered on the previous connection
+    virtual void forgetAttributes();
 
     virtual void subscribeChars(BLEClient* client);
     virtual void unsubscribeChars(BLEClient* client);
@@ -99,6 +146,21 @@ class Peer : public BLEClientCallbacks {
     virtual PeerCharacteristic* getChar(const char* label);
     virtual bool removeCharAt(int8_t index);
     virtual uint8_t deleteChars(const char* label);
+    // char of the value handle on the current connection, nullptr if unknown
+    PeerCharacteristic* charByHandle(uint16_t handle) {
+        const HandleTable* table = handleTable.load(std::memory_order_acquire);
+        if (nullptr == table) return nullptr;
+        uint16_t offset = handle - table->base;  // wraps for handles below the base
+        if (ATOLL_BLE_PEER_HANDLE_TABLE_SIZE <= offset) return nullptr;
+        int8_t index = table->index[offset];
+        return index < 0 ? nullptr : chars[index];
+    }
+
+    // notification callback of the chars in the handle table, dispatches by handle
+    virtual void onNotify(BLERemoteCharacteristic* c, uint8_t* data, size_t length, bool isNotify);
+    // counts the notification, called by the chars outside the handle table
+    void onNotification();
+    uint32_t notifications = 0;  // received on the current connection
 
     virtual bool isPowerMeter();
     virtual bool isESPM();
@@ -108,6 +170,16 @@ class Peer : public BLEClientCallbacks {
 
     typedef std::function<void(Peer*)> Callback;
     Callback connectedCallback = [](Peer*) {};
+    Callback disconnectedCallback = [](Peer*) {};
+    // called by the NimBLE host when the state of the connection changes, must not block
+    Callback changedCallback = [](Peer*) {};
+    // called by discoverAttributes() when the Database Hash differs from the saved one
+    Callback dbHashCallback = [](Peer*) {};
+
+    // the Database Hash persisted across reboots, loaded by BleClient
+    void setSavedDbHash(const uint8_t* hash);
+    // copies the saved hash, returns false if none
+    bool getSavedDbHash(uint8_t* hash);
 
    protected:
     BLEClient* client = nullptr;                                           // our NimBLE client
@@ -115,11 +187,34 @@ class Peer : public BLEClientCallbacks {
     int8_t charsMax = ATOLL_BLE_PEER_DEVICE_MAX_CHARACTERISTICS;           // convenience for iterating
 
     virtual bool connectClient(bool deleteAttributes = true);
+
+    // Attribute cache: the NimBLE client keeps the discovered services after a
+    // disconnect, they are reused on reconnect when the server reports no
+    // change: it has no Service Changed char (its database is static), or its
+    // Database Hash matches the one read after the last discovery, or it is
+    // bonded and would indicate Service Changed.
+    BLEClient* attributesClient = nullptr;  // the client holding the discovered attributes
+    bool reusingAttributes = false;         // connecting without deleting the attributes
+    uint8_t dbHash[DATABASE_HASH_LENGTH];
+    bool dbHashKnown = false;
+    uint8_t savedDbHash[DATABASE_HASH_LENGTH];
+    bool savedDbHashKnown = false;
+    volatile bool attributesChanged = false;  // set by the Service Changed indication
+    virtual bool canReuseAttributes();
+    virtual bool attributesValid(BLEClient* client);
+    virtual void discoverAttributes(BLEClient* client);
+    virtual bool readDbHash(BLEClient* client, uint8_t* hash);
+    virtual void subscribeServiceChanged(BLEClient* client);
+    virtual void checkAttributes();
     virtual void beforeConnect();
     virtual void afterConnect();
 
+    // discovers, subscribes and calls connectedCallback, called by setupConnection()
+    virtual void onConnected(BLEClient* client);
+
     // client callbacks
     virtual void onConnect(BLEClient* pClient) override;
+    virtual void onConnectFail(BLEClient* pClient, int reason) override;
     virtual void onDisconnect(BLEClient* pClient, int reason) override;
     virtual bool onConnParamsUpdateRequest(BLEClient* pClient, const ble_gap_upd_params* params) override;
     virtual uint32_t onPassKeyRequest() override;
@@ -128,8 +223,25 @@ class Peer : public BLEClientCallbacks {
     virtual void onAuthenticationComplete(NimBLEConnInfo& connInfo) override;
     virtual bool onConfirmPIN(uint32_t pin) override;
 
-    // notification callback
-    virtual void onNotify(BLERemoteCharacteristic* c, uint8_t* data, size_t length, bool isNotify);
+    // Handle table of the current connection, built by subscribeChars() on the
+    // BleClient task and read by the NimBLE host in the notification callbacks:
+    // index[handle - base] is the index of the char in chars, -1 if none.
+    // A new table is built in the one not published last and published with a
+    // single store, a reader still holding the previous one is not affected.
+    struct HandleTable {
+        uint16_t base = 0;
+        int8_t index[ATOLL_BLE_PEER_HANDLE_TABLE_SIZE];
+    };
+    HandleTable handleTables[2];
+    uint8_t nextHandleTable = 0;
+    std::atomic<HandleTable*> handleTable{nullptr};  // published table, nullptr: none
+    virtual void buildHandleTable(BLEClient* client);
+    // unpublishes the table, safe from the NimBLE host
+    virtual void clearHandleTable();
+
+    // Drops the handle table and the remote chars cached by the chars, call
+    // from the BleClient task before the attributes of the client are deleted.
+    virtual void forgetRemoteChars();
 };
 
 class PowerMeter : public Peer {
@@ -157,9 +269,12 @@ class ESPM : public PowerMeter {
     virtual void beforeConnect() override;
     virtual void afterConnect() override;
 
-    virtual void onConnect(BLEClient* pClient) override;
+    virtual void onConnected(BLEClient* client) override;
 
     virtual bool sendApiCommand(const char* command);
+
+    PeerCharacteristicApiTX* apiTx = nullptr;
+    PeerCharacteristicApiRX* apiRx = nullptr;
 };
 
 class HeartrateMonitor : public Peer {
@@ -195,6 +310,7 @@ class JkBms : public Peer {
     JkBms(
         Saved saved,
         PeerCharacteristicJkBms* customJkBmsChar = nullptr) : Peer(saved) {
+        priority = 0;
         deleteChars("Battery");
         addChar(nullptr != customJkBmsChar
                     ? customJkBmsChar
@@ -214,6 +330,7 @@ class JkBms : public Peer {
 
     void loop() override {
         // don't set established conn params
+        checkAttributes();
     }
 
     PeerCharacteristicJkBms* characteristic = nullptr;
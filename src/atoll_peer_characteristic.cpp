@@ -32,6 +32,9 @@ BLERemoteCharacteristic* PeerCharacteristic::getRemoteChar(BLEClient* client) {
     if (nullptr == client) {
         client = getClient();
     }
+    // skip walking the services and chars of the client while the connection lasts
+    if (nullptr != remoteChar && client == remoteCharClient && client->isConnected())
+        return remoteChar;
     BLERemoteService* rs = getRemoteService(client);
     if (nullptr == rs) {
         log_e("%s could not get remote service", label);
@@ -52,9 +55,16 @@ BLERemoteCharacteristic* PeerCharacteristic::getRemoteChar(BLEClient* client) {
         return rc;
     }
     // log_i("%s got remote char", label);
+    remoteChar = rc;
+    remoteCharClient = client;
     return rc;
 }
 
+void PeerCharacteristic::forgetRemoteChar() {
+    remoteChar = nullptr;
+    remoteCharClient = nullptr;
+}
+
 bool PeerCharacteristic::subscribe(BLEClient* client) {
     log_d("%s subscribing", label);
     BLERemoteCharacteristic* rc = getRemoteChar(client);
@@ -64,15 +74,24 @@ bool PeerCharacteristic::subscribe(BLEClient* client) {
         return false;
     }
     // log_i("%s can notify: %d, can indicate: %d", label, rc->canNotify(), rc->canIndicate());
+    // chars in the handle table of the peer are dispatched by the peer
+    bool viaPeer = nullptr != peer && this == peer->charByHandle(rc->getHandle());
     remoteOpStart(client);
     bool res = rc->subscribe(
         rc->canNotify(),
-        [this](
+        [this, viaPeer](
             BLERemoteCharacteristic* c,
             uint8_t* data,
             size_t length,
             bool isNotify) {
-            onNotify(c, data, length, isNotify);
+            if (nullptr == peer)
+                onNotify(c, data, length, isNotify);
+            else if (viaPeer)
+                peer->onNotify(c, data, length, isNotify);
+            else {
+                peer->onNotification();
+                onNotify(c, data, length, isNotify);
+            }
         });
     remoteOpEnd(client);
     if (!res) {
@@ -6,6 +6,7 @@
 
 #include "atoll_ble_constants.h"
 #include "atoll_log.h"
+#include "atoll_event_bus.h"
 
 #ifndef SETTINGS_STR_LENGTH
 #define SETTINGS_STR_LENGTH 32
@@ -26,6 +27,8 @@ class PeerCharacteristic {
 
     virtual BLERemoteService* getRemoteService(BLEClient* client = nullptr);
     virtual BLERemoteCharacteristic* getRemoteChar(BLEClient* client = nullptr);
+    // drops the remote char cached for the connection, call when the attributes of the client change
+    virtual void forgetRemoteChar();
 
     virtual bool subscribe(BLEClient* client);
     virtual bool unsubscribe(BLEClient* client);
@@ -38,6 +41,10 @@ class PeerCharacteristic {
 
     virtual void remoteOpStart(BLEClient* client);
     virtual void remoteOpEnd(BLEClient* client);
+
+   protected:
+    BLERemoteCharacteristic* remoteChar = nullptr;  // cached by getRemoteChar()
+    BLEClient* remoteCharClient = nullptr;          // the client remoteChar belongs to
 };
 
 }  // namespace Atoll
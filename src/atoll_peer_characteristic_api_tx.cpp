@@ -27,6 +27,13 @@ bool PeerCharacteristicApiTX::encode(const String value, uint8_t* data, size_t l
 }
 
 void PeerCharacteristicApiTX::onNotify(BLERemoteCharacteristic* rc, uint8_t* data, size_t length, bool isNotify) {
+    if (API_FRAGMENT_HEADER_LENGTH <= length && API_FRAGMENT_MARKER == data[0]) {
+        if (!assemble(data, length)) return;
+        lastValue = decode((uint8_t*)fragmentBuf, fragmentLength);
+        fragmentValid = false;
+        notify();
+        return;
+    }
     {
         // log_d("%s length: %d", label, length);
         BLERemoteService* rs = rc->getRemoteService();
@@ -73,6 +80,35 @@ decode:
     notify();
 }
 
+// Fragment format: [API_FRAGMENT_MARKER][sequence number][flags]data...
+bool PeerCharacteristicApiTX::assemble(const uint8_t* data, size_t length) {
+    uint8_t seq = data[1];
+    uint8_t flags = data[2];
+    if (0 == seq) {
+        if (fragmentValid)
+            log_w("%s discarding incomplete reply (%d bytes)", label, fragmentLength);
+        fragmentLength = 0;
+        fragmentSeq = 0;
+        fragmentValid = true;
+    }
+    if (!fragmentValid) return false;
+    if (seq != fragmentSeq) {
+        log_e("%s fragment %d missing, got %d, discarding reply", label, fragmentSeq, seq);
+        fragmentValid = false;
+        return false;
+    }
+    size_t dataLength = length - API_FRAGMENT_HEADER_LENGTH;
+    if (sizeof(fragmentBuf) < fragmentLength + dataLength) {
+        log_e("%s reply too long, discarding", label);
+        fragmentValid = false;
+        return false;
+    }
+    memcpy(fragmentBuf + fragmentLength, data + API_FRAGMENT_HEADER_LENGTH, dataLength);
+    fragmentLength += dataLength;
+    fragmentSeq++;
+    return flags & API_FRAGMENT_FLAG_END;
+}
+
 void PeerCharacteristicApiTX::notify() {
     log_d("%s received '%s'", label, lastValue.c_str());
 }
@@ -3,6 +3,10 @@
 
 #include "atoll_peer_characteristic_api.h"
 
+#ifndef ATOLL_PEER_API_TX_FRAGMENT_BUF_LENGTH
+#define ATOLL_PEER_API_TX_FRAGMENT_BUF_LENGTH 1024  // max length of a reassembled reply
+#endif
+
 namespace Atoll {
 
 class PeerCharacteristicApiTX : public PeerCharacteristicApi {
@@ -19,6 +23,15 @@ class PeerCharacteristicApiTX : public PeerCharacteristicApi {
     virtual bool readOnSubscribe() override;
 
     virtual void loop();
+
+   protected:
+    char fragmentBuf[ATOLL_PEER_API_TX_FRAGMENT_BUF_LENGTH];  // reassembly buffer for fragmented replies
+    size_t fragmentLength = 0;                                // length of the data in fragmentBuf
+    uint8_t fragmentSeq = 0;                                  // next expected sequence number
+    bool fragmentValid = false;                               // whether fragmentBuf holds a valid partial reply
+
+    // returns true when the last fragment of a reply has been received
+    virtual bool assemble(const uint8_t* data, size_t length);
 };
 
 }  // namespace Atoll
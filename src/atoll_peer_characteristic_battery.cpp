@@ -18,9 +18,14 @@ uint8_t PeerCharacteristicBattery::decode(const uint8_t* data, const size_t leng
     /// [Level: 1] The current charge level of a battery. 100 represents fully charged while
     /// 0 represents fully discharged.
     ///
+    if (length < 1) {
+        log_e("length < 1");
+        return lastValue;
+    }
     uint8_t level = data[0];
     // log_i("decoded %d%", level);
     if (100 < level) log_e("level too high: %d", level);
+    EventBus::publish(EventBus::BATTERY, level, this);
     return level;
 }
 
@@ -1,6 +1,9 @@
 #if !defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL_DISABLED) && defined(FEATURE_BLE_CLIENT)
 
 #include "atoll_peer_characteristic_heartrate.h"
+#ifdef FEATURE_RECORDER
+#include "atoll_recorder.h"
+#endif
 
 using namespace Atoll;
 
@@ -12,19 +15,14 @@ PeerCharacteristicHeartrate::PeerCharacteristicHeartrate() {
 }
 
 uint16_t PeerCharacteristicHeartrate::decode(const uint8_t* data, const size_t length) {
-    if (length < 2) {
-        log_e("reading length < 2");
-        return 0;
-    }
-
     /// https://github.com/oesmith/gatt-xml/blob/master/org.bluetooth.characteristic.heart_rate_measurement.xml
     ///
-    /// Format: little-endian (but NimBLE converts it to big-endian?)
+    /// Format: little-endian
     /// Bytes:
     /// [Flags: 1]
     /// [Heart rate: 1 or 2, depending on bit 0 of the Flags field]
     /// [Energy Expended: 2, presence dependent upon bit 3 of the Flags field]
-    /// [RR-Interval: 2, presence dependent upon bit 4 of the Flags field]
+    /// [RR-Interval: 2, any number of them until the end, presence dependent upon bit 4 of the Flags field]
     ///
     /// Flags: 0b00000001  // 0: Heart Rate Value Format is set to UINT8, 1: HRVF is UINT16
     /// Flags: 0b00000010  // Sensor Contact Status bit 1
@@ -34,15 +32,37 @@ uint16_t PeerCharacteristicHeartrate::decode(const uint8_t* data, const size_t l
     /// Flags: 0b00100000 // ReservedForFutureUse
     /// Flags: 0b01000000 // ReservedForFutureUse
     /// Flags: 0b10000000 // ReservedForFutureUse
+    /// RR-Interval unit: 1/1024 s
 
-    uint8_t flags = data[0];
-    bool format16bit = 0b00000001 & flags;
-    uint16_t heartrate;
-    if (format16bit)
-        heartrate = data[1] | (data[2] << 8);
-    else
-        heartrate = data[1] | (0b00000000 << 8);
-
+    int64_t arrival = esp_timer_get_time();
+    if (length < 2) {
+        log_e("reading length < 2");
+        return lastValue;
+    }
+    uint8_t f = data[0];
+    size_t offset = (FORMAT_UINT16 & f) ? 3 : 2;
+    if (length < offset + ((ENERGY_PRESENT & f) ? 2 : 0)) {
+        log_e("reading length %d too short for flags 0x%02x", length, f);
+        return lastValue;
+    }
+    flags = f;
+    uint16_t heartrate = (FORMAT_UINT16 & f) ? data[1] | (data[2] << 8) : data[1];
+    if (ENERGY_PRESENT & f) {
+        energyExpended = data[offset] | (data[offset + 1] << 8);
+        offset += 2;
+    }
+    EventBus::publish(EventBus::HEARTRATE, heartrate, this, 0, arrival);
+    if (RR_PRESENT & f) {
+        for (; offset + 1 < length; offset += 2) {
+            uint32_t rr = data[offset] | (data[offset + 1] << 8);
+            uint16_t ms = (uint16_t)((rr * 1000 + 512) / 1024);
+            rrReceived++;
+#ifdef FEATURE_RECORDER
+            if (nullptr != Recorder::instance) Recorder::instance->onRrInterval(ms);
+#endif
+            EventBus::publish(EventBus::RR_INTERVAL, ms, this, 0, arrival);
+        }
+    }
     return heartrate;
 }
 
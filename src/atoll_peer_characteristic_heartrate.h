@@ -7,6 +7,21 @@ namespace Atoll {
 
 class PeerCharacteristicHeartrate : public PeerCharacteristicTemplate<uint16_t> {
    public:
+    enum Flag : uint8_t {
+        FORMAT_UINT16 = 1 << 0,
+        CONTACT_DETECTED = 1 << 1,
+        CONTACT_SUPPORTED = 1 << 2,
+        ENERGY_PRESENT = 1 << 3,
+        RR_PRESENT = 1 << 4,
+    };
+
+    // lastValue is heartrate in bpm
+    uint8_t flags = 0;
+    uint16_t energyExpended = 0;  // kJ, cumulative
+    // RR intervals in ms are fed to Recorder::onRrInterval() and published on
+    // EventBus::RR_INTERVAL in the order they were received
+    uint32_t rrReceived = 0;  // number of RR intervals decoded
+
     PeerCharacteristicHeartrate();
 
     virtual uint16_t decode(const uint8_t* data, const size_t length) override;
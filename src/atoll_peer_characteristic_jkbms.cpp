@@ -1,5 +1,10 @@
 #if !defined(CONFIG_BT_NIMBLE_ROLE_CENTRAL_DISABLED) && defined(FEATURE_BLE_CLIENT)
 
+#define ATOLL_LOG_TAG "JkBms"
+#ifdef ATOLL_LOG_LEVEL_JKBMS
+#define ATOLL_LOG_LOCAL_LEVEL ATOLL_LOG_LEVEL_JKBMS
+#endif
+
 #include "atoll_peer_characteristic_jkbms.h"
 
 using namespace Atoll;
@@ -64,58 +69,68 @@ bool PeerCharacteristicJkBms::requestCellInfo() {
 }
 
 void PeerCharacteristicJkBms::assemble(const uint8_t* data, uint16_t length) {
-    if (frameBuffer.size() > MAX_RESPONSE_SIZE) {
-        log_w("Frame dropped because of invalid length");
-        frameBuffer.clear();
-    }
-
     // Flush buffer on every preamble
-    if (data[0] == 0x55 && data[1] == 0xAA && data[2] == 0xEB && data[3] == 0x90) {
-        frameBuffer.clear();
+    if (4 <= length && data[0] == 0x55 && data[1] == 0xAA && data[2] == 0xEB && data[3] == 0x90) {
+        frameLength = 0;
+    } else if (0 == frameLength) {
+        // the rest of a frame that was dropped or already decoded
+        return;
     }
 
-    frameBuffer.insert(frameBuffer.end(), data, data + length);
+    if (MAX_RESPONSE_SIZE < frameLength + length) {
+        log_w("Frame dropped because of invalid length");
+        frameLength = 0;
+        return;
+    }
+    memcpy(frameBuffer + frameLength, data, length);
+    frameLength += length;
 
-    if (frameBuffer.size() < MIN_RESPONSE_SIZE) return;
+    if (frameLength < MIN_RESPONSE_SIZE) return;
 
-    const uint8_t* raw = &frameBuffer[0];
     // Even if the frame is 320 bytes long the CRC is at position 300 in front of 0xAA 0x55 0x90 0xEB
-    const uint16_t frameSize = 300;  // frameBuffer.size();
+    const uint16_t frameSize = 300;
 
-    uint8_t computed_crc = crc(raw, frameSize - 1);
-    uint8_t remote_crc = raw[frameSize - 1];
+    uint8_t computed_crc = crc(frameBuffer, frameSize - 1);
+    uint8_t remote_crc = frameBuffer[frameSize - 1];
     if (computed_crc != remote_crc) {
         log_w("CRC check failed! 0x%02X != 0x%02X", computed_crc, remote_crc);
-        frameBuffer.clear();
+        frameLength = 0;
         return;
     }
 
-    decode(std::vector<uint8_t>(frameBuffer.begin(), frameBuffer.end()));
-    frameBuffer.clear();
+    decodeFrame(frameBuffer, frameLength);
+    frameLength = 0;
 }
 
-void PeerCharacteristicJkBms::decode(const std::vector<uint8_t>& data) {
+void PeerCharacteristicJkBms::decodeFrame(const uint8_t* data, size_t length) {
+    if (length < MIN_RESPONSE_SIZE) {
+        log_e("frame too short: %d", length);
+        return;
+    }
     uint8_t frameType = data[4];
     switch (frameType) {
         case 0x01:
             if (protocolVersion == PROTOCOL_VERSION_JK04) {
-                decodeJk04Settings(data);
+                decodeJk04Settings(data, length);
             } else {
-                decodeJk02Settings(data);
+                decodeJk02Settings(data, length);
             }
             if (nullptr != onSettingsUpdate) onSettingsUpdate(this);
             printSettings();
             break;
         case 0x02:
             if (protocolVersion == PROTOCOL_VERSION_JK04) {
-                decodeJk04CellInfo(data);
+                decodeJk04CellInfo(data, length);
             } else {
-                decodeJk02CellInfo(data);
+                decodeJk02CellInfo(data, length);
             }
+            EventBus::publish(EventBus::BMS_VOLTAGE, cellInfo.voltage, this);
+            EventBus::publish(EventBus::BMS_CURRENT, cellInfo.chargeCurrent, this);
+            EventBus::publish(EventBus::BMS_SOC, cellInfo.soc, this);
             if (nullptr != onCellInfoUpdate) onCellInfoUpdate(this);
             break;
         case 0x03:
-            decodeDeviceInfo(data);
+            decodeDeviceInfo(data, length);
             if (nullptr != onDeviceInfoUpdate) onDeviceInfoUpdate(this);
             printDeviceInfo();
             break;
@@ -124,15 +139,15 @@ void PeerCharacteristicJkBms::decode(const std::vector<uint8_t>& data) {
     }
 }
 
-void PeerCharacteristicJkBms::decodeDeviceInfo(const std::vector<uint8_t>& data) {
+void PeerCharacteristicJkBms::decodeDeviceInfo(const uint8_t* data, size_t length) {
     auto get16 = [&](size_t i) -> uint16_t { return (uint16_t(data[i + 1]) << 8) | (uint16_t(data[i + 0]) << 0); };
     auto get32 = [&](size_t i) -> uint32_t {
         return (uint32_t(get16(i + 2)) << 16) | (uint32_t(get16(i + 0)) << 0);
     };
 
-    // log_i("Device info frame (%d bytes) received", data.size());
-    // log_d("  %s", format_hex_pretty(&data.front(), 160).c_str());
-    // log_d("  %s", format_hex_pretty(&data.front() + 160, data.size() - 160).c_str());
+    // log_i("Device info frame (%d bytes) received", length);
+    // log_d("  %s", format_hex_pretty(data, 160).c_str());
+    // log_d("  %s", format_hex_pretty(data + 160, length - 160).c_str());
 
     // JK04 (JK-B2A16S v3) response example:
     //
@@ -182,50 +197,40 @@ void PeerCharacteristicJkBms::decodeDeviceInfo(const std::vector<uint8_t>& data)
     // 0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00 0x00
     // 0x65
 
-    snprintf(deviceInfo.vendorId, sizeof(deviceInfo.vendorId),
-             std::string(data.begin() + 6, data.begin() + 6 + 16).c_str());
+    copyString(deviceInfo.vendorId, sizeof(deviceInfo.vendorId), data + 6, 16);
 
-    snprintf(deviceInfo.hardwareVersion, sizeof(deviceInfo.hardwareVersion),
-             std::string(data.begin() + 22, data.begin() + 22 + 8).c_str());
+    copyString(deviceInfo.hardwareVersion, sizeof(deviceInfo.hardwareVersion), data + 22, 8);
 
-    snprintf(deviceInfo.softwareVersion, sizeof(deviceInfo.softwareVersion),
-             std::string(data.begin() + 30, data.begin() + 30 + 8).c_str());
+    copyString(deviceInfo.softwareVersion, sizeof(deviceInfo.softwareVersion), data + 30, 8);
 
     deviceInfo.uptime = get32(38);
 
     deviceInfo.powerOnCount = get32(42);
 
-    snprintf(deviceInfo.deviceName, sizeof(deviceInfo.deviceName),
-             std::string(data.begin() + 46, data.begin() + 46 + 16).c_str());
+    copyString(deviceInfo.deviceName, sizeof(deviceInfo.deviceName), data + 46, 16);
 
-    snprintf(deviceInfo.devicePasscode, sizeof(deviceInfo.devicePasscode),
-             std::string(data.begin() + 62, data.begin() + 62 + 16).c_str());
+    copyString(deviceInfo.devicePasscode, sizeof(deviceInfo.devicePasscode), data + 62, 16);
 
-    snprintf(deviceInfo.manufacturingDate, sizeof(deviceInfo.manufacturingDate),
-             std::string(data.begin() + 78, data.begin() + 78 + 8).c_str());
+    copyString(deviceInfo.manufacturingDate, sizeof(deviceInfo.manufacturingDate), data + 78, 8);
 
-    snprintf(deviceInfo.serialNumber, sizeof(deviceInfo.serialNumber),
-             std::string(data.begin() + 86, data.begin() + 86 + 11).c_str());
+    copyString(deviceInfo.serialNumber, sizeof(deviceInfo.serialNumber), data + 86, 11);
 
-    snprintf(deviceInfo.passcode, sizeof(deviceInfo.passcode),
-             std::string(data.begin() + 97, data.begin() + 97 + 5).c_str());
+    copyString(deviceInfo.passcode, sizeof(deviceInfo.passcode), data + 97, 5);
 
-    snprintf(deviceInfo.userData, sizeof(deviceInfo.userData),
-             std::string(data.begin() + 102, data.begin() + 102 + 16).c_str());
+    copyString(deviceInfo.userData, sizeof(deviceInfo.userData), data + 102, 16);
 
-    snprintf(deviceInfo.setupPasscode, sizeof(deviceInfo.setupPasscode),
-             std::string(data.begin() + 118, data.begin() + 118 + 16).c_str());
+    copyString(deviceInfo.setupPasscode, sizeof(deviceInfo.setupPasscode), data + 118, 16);
 }
 
-void PeerCharacteristicJkBms::decodeJk02Settings(const std::vector<uint8_t>& data) {
+void PeerCharacteristicJkBms::decodeJk02Settings(const uint8_t* data, size_t length) {
     auto get16 = [&](size_t i) -> uint16_t { return (uint16_t(data[i + 1]) << 8) | (uint16_t(data[i + 0]) << 0); };
     auto get32 = [&](size_t i) -> uint32_t {
         return (uint32_t(get16(i + 2)) << 16) | (uint32_t(get16(i + 0)) << 0);
     };
 
-    // log_i("Settings frame (%d bytes) received", data.size());
-    // log_d("  %s", format_hex_pretty(&data.front(), 160).c_str());
-    // log_d("  %s", format_hex_pretty(&data.front() + 160, data.size() - 160).c_str());
+    // log_i("Settings frame (%d bytes) received", length);
+    // log_d("  %s", format_hex_pretty(data, 160).c_str());
+    // log_d("  %s", format_hex_pretty(data + 160, length - 160).c_str());
 
     // JK02 response example:
     //
@@ -378,7 +383,7 @@ void PeerCharacteristicJkBms::decodeJk02Settings(const std::vector<uint8_t>& dat
     // 299   1   0x40                   CRC
 }
 
-void PeerCharacteristicJkBms::decodeJk04Settings(const std::vector<uint8_t>& data) {
+void PeerCharacteristicJkBms::decodeJk04Settings(const uint8_t* data, size_t length) {
     log_e("not impl");
     /*
     auto get16 = [&](size_t i) -> uint16_t { return (uint16_t(data[i + 1]) << 8) | (uint16_t(data[i + 0]) << 0); };
@@ -386,9 +391,9 @@ void PeerCharacteristicJkBms::decodeJk04Settings(const std::vector<uint8_t>& dat
         return (uint32_t(get16(i + 2)) << 16) | (uint32_t(get16(i + 0)) << 0);
     };
 
-    log_i("Settings frame (%d bytes) received", data.size());
-    log_d("  %s", format_hex_pretty(&data.front(), 160).c_str());
-    log_d("  %s", format_hex_pretty(&data.front() + 160, data.size() - 160).c_str());
+    log_i("Settings frame (%d bytes) received", length);
+    log_d("  %s", format_hex_pretty(data, 160).c_str());
+    log_d("  %s", format_hex_pretty(data + 160, length - 160).c_str());
 
     // JK04 (JK-B2A16S v3) response example:
     //
@@ -472,7 +477,7 @@ void PeerCharacteristicJkBms::decodeJk04Settings(const std::vector<uint8_t>& dat
     */
 }
 
-void PeerCharacteristicJkBms::decodeJk02CellInfo(const std::vector<uint8_t>& data) {
+void PeerCharacteristicJkBms::decodeJk02CellInfo(const uint8_t* data, size_t length) {
     auto get16 = [&](size_t i) -> uint16_t { return (uint16_t(data[i + 1]) << 8) | (uint16_t(data[i + 0]) << 0); };
 
     // get unsigned int32
@@ -508,9 +513,9 @@ void PeerCharacteristicJkBms::decodeJk02CellInfo(const std::vector<uint8_t>& dat
         offset = 16;
     }
 
-    // log_i("Cell info frame (version %d, %d bytes) received", frameVersion, data.size());
-    //  printHex(&data.front(), 150);
-    //  printHex(&data.front() + 150, data.size() - 150);
+    // log_i("Cell info frame (version %d, %d bytes) received", frameVersion, length);
+    //  printHex(data, 150);
+    //  printHex(data + 150, length - 150);
 
     // 6 example responses (128+128+44 = 300 bytes per frame)
     //
@@ -666,7 +671,7 @@ void PeerCharacteristicJkBms::decodeJk02CellInfo(const std::vector<uint8_t>& dat
     if (frameVersion != FRAME_VERSION_JK02_32S) {
         uint16_t raw_errors_bitmask = (uint16_t(data[136 + offset]) << 8) |
                                       (uint16_t(data[136 + 1 + offset]) << 0);
-        strncpy(cellInfo.errors, errorToString(raw_errors_bitmask).c_str(), sizeof(cellInfo.errors));
+        errorToString(raw_errors_bitmask, cellInfo.errors, sizeof(cellInfo.errors));
         // log_d("errors: %s", errors);
     }
 
@@ -713,7 +718,7 @@ void PeerCharacteristicJkBms::decodeJk02CellInfo(const std::vector<uint8_t>& dat
     cellInfo.dischargingEnabled = (bool)data[167 + offset];
     // log_d("%s   %s", chargingEnabled ? "charging" : "", dischargingEnabled ? "discharging" : "");
 
-    // log_d("Unknown168: %s",   format_hex_pretty(&data.front() + 168 + offset, data.size() - (168 + offset) - 4 - 81 - 1).c_str());
+    // log_d("Unknown168: %s",   format_hex_pretty(data + 168 + offset, length - (168 + offset) - 4 - 81 - 1).c_str());
 
     // 168   1   0xAA                   Unknown168
     // 169   2   0x06 0x00              Unknown169
@@ -752,7 +757,7 @@ void PeerCharacteristicJkBms::decodeJk02CellInfo(const std::vector<uint8_t>& dat
     // 299   1   0xCD                   CRC
 }
 
-void PeerCharacteristicJkBms::decodeJk04CellInfo(const std::vector<uint8_t>& data) {
+void PeerCharacteristicJkBms::decodeJk04CellInfo(const uint8_t* data, size_t length) {
     log_e("not impl");
     /*
     auto get16 = [&](size_t i) -> uint16_t { return (uint16_t(data[i + 1]) << 8) | (uint16_t(data[i + 0]) << 0); };
@@ -766,9 +771,9 @@ void PeerCharacteristicJkBms::decodeJk04CellInfo(const std::vector<uint8_t>& dat
     }
     lastCellInfo = now;
 
-    log_i("Cell info frame (%d bytes) received", data.size());
-    log_d("  %s", format_hex_pretty(&data.front(), 150).c_str());
-    log_d("  %s", format_hex_pretty(&data.front() + 150, data.size() - 150).c_str());
+    log_i("Cell info frame (%d bytes) received", length);
+    log_d("  %s", format_hex_pretty(data, 150).c_str());
+    log_d("  %s", format_hex_pretty(data + 150, length - 150).c_str());
 
     // 0x55 0xAA 0xEB 0x90 0x02 0x4B 0xC0 0x61 0x56 0x40 0x1F 0xAA 0x56 0x40 0xFF 0x91 0x56 0x40 0xFF 0x91 0x56 0x40 0x1F
     // 0xAA 0x56 0x40 0xFF 0x91 0x56 0x40 0xFF 0x91 0x56 0x40 0xFF 0x91 0x56 0x40 0x1F 0xAA 0x56 0x40 0xFF 0x91 0x56 0x40
@@ -1038,7 +1043,15 @@ void PeerCharacteristicJkBms::printCellInfo() {
         cellInfo.errors);
 }
 
-std::string PeerCharacteristicJkBms::errorToString(const uint16_t mask) {
+void PeerCharacteristicJkBms::copyString(char* dst, size_t size, const uint8_t* src, size_t fieldLength) {
+    if (0 == size) return;
+    size_t len = 0;
+    while (len < fieldLength && len < size - 1 && '\0' != src[len]) len++;
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+}
+
+void PeerCharacteristicJkBms::errorToString(const uint16_t mask, char* buf, size_t size) {
     static const uint8_t numItems = 16;
     static const char items[numItems][40] = {
         "Charge Overtemperature",               // 0000 0000 0000 0001
@@ -1058,18 +1071,18 @@ std::string PeerCharacteristicJkBms::errorToString(const uint16_t mask) {
         "Charge overcurrent protection",        // 0100 0000 0000 0000
         "Error 0x80 0x00",                      // 1000 0000 0000 0000
     };
-    std::string ret = "";
-    if (!mask) return ret;
-    for (int i = 0; i < numItems; i++) {
-        if (mask & (1 << i)) {
-            if (0 != i) ret.append(", ");
-            ret.append(items[i]);
-        }
+    if (0 == size) return;
+    buf[0] = '\0';
+    size_t len = 0;
+    for (int i = 0; i < numItems && len < size - 1; i++) {
+        if (!(mask & (1 << i))) continue;
+        int written = snprintf(buf + len, size - len, "%s%s", 0 < len ? ", " : "", items[i]);
+        if (written < 0) break;
+        len += written;
     }
-    return ret;
 }
 
-std::string PeerCharacteristicJkBms::modeToString(const uint16_t mask) {
+void PeerCharacteristicJkBms::modeToString(const uint16_t mask, char* buf, size_t size) {
     static const uint8_t numItems = 4;
     static const char items[numItems][32] = {
         "Charging enabled",     // 0x00
@@ -1077,15 +1090,15 @@ std::string PeerCharacteristicJkBms::modeToString(const uint16_t mask) {
         "Balancer enabled",     // 0x02
         "Battery dropped"       // 0x03
     };
-    std::string ret = "";
-    if (!mask) return ret;
-    for (int i = 0; i < numItems; i++) {
-        if (mask & (1 << i)) {
-            if (0 != i) ret.append(", ");
-            ret.append(items[i]);
-        }
+    if (0 == size) return;
+    buf[0] = '\0';
+    size_t len = 0;
+    for (int i = 0; i < numItems && len < size - 1; i++) {
+        if (!(mask & (1 << i))) continue;
+        int written = snprintf(buf + len, size - len, "%s%s", 0 < len ? ", " : "", items[i]);
+        if (written < 0) break;
+        len += written;
     }
-    return ret;
 }
 
 uint8_t PeerCharacteristicJkBms::crc(const uint8_t data[], const uint16_t len) {
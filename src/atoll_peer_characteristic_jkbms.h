@@ -169,26 +169,31 @@ class PeerCharacteristicJkBms : public PeerCharacteristicTemplate<String> {
         };
     */
 
-    std::vector<uint8_t> frameBuffer;
-    uint32_t cellInfoMinDelay = 1000;
-
     static const uint8_t COMMAND_CELL_INFO = 0x96;
     static const uint8_t COMMAND_DEVICE_INFO = 0x97;
     static const uint16_t MIN_RESPONSE_SIZE = 300;
     static const uint16_t MAX_RESPONSE_SIZE = 320;
 
+    uint8_t frameBuffer[MAX_RESPONSE_SIZE];  // the frame being assembled
+    uint16_t frameLength = 0;                // bytes in frameBuffer, 0: waiting for a preamble
+    uint32_t cellInfoMinDelay = 1000;
+
     bool writeRegister(uint8_t address, uint32_t value, uint8_t length);
     void assemble(const uint8_t* data, uint16_t length);
 
-    void decode(const std::vector<uint8_t>& data);
-    void decodeDeviceInfo(const std::vector<uint8_t>& data);
-    void decodeJk02Settings(const std::vector<uint8_t>& data);
-    void decodeJk04Settings(const std::vector<uint8_t>& data);
-    void decodeJk02CellInfo(const std::vector<uint8_t>& data);
-    void decodeJk04CellInfo(const std::vector<uint8_t>& data);
-
-    std::string errorToString(const uint16_t mask);
-    std::string modeToString(const uint16_t mask);
+    // the decoders read the fields in place, length must be at least MIN_RESPONSE_SIZE
+    void decodeFrame(const uint8_t* data, size_t length);
+    void decodeDeviceInfo(const uint8_t* data, size_t length);
+    void decodeJk02Settings(const uint8_t* data, size_t length);
+    void decodeJk04Settings(const uint8_t* data, size_t length);
+    void decodeJk02CellInfo(const uint8_t* data, size_t length);
+    void decodeJk04CellInfo(const uint8_t* data, size_t length);
+
+    // copies a zero-padded string field, truncated to fit into size
+    static void copyString(char* dst, size_t size, const uint8_t* src, size_t fieldLength);
+    // comma separated names of the set bits
+    static void errorToString(const uint16_t mask, char* buf, size_t size);
+    static void modeToString(const uint16_t mask, char* buf, size_t size);
     uint8_t crc(const uint8_t data[], const uint16_t len);
     void printHex(const uint8_t* s, size_t size, const char* pre = "");
 };
@@ -11,81 +11,139 @@ PeerCharacteristicPower::PeerCharacteristicPower() {
     // log_d("PeerCharacteristicPower construct, label: %s, char: %s", label, charUuid.toString().c_str());
 }
 
-uint16_t PeerCharacteristicPower::decode(const uint8_t* data, const size_t length) {
-    if (length < 8) {
-        log_w("power reading length < 8");
-        return 0;
+/// https://github.com/sputnikdev/bluetooth-gatt-parser/blob/master/src/main/resources/gatt/characteristic/org.bluetooth.characteristic.cycling_power_measurement.xml
+///
+/// Format: little-endian
+/// Bytes: [flags: 2][power: 2(int16)] followed by the fields present, in the order of the table below
+/// Flags: 0b00000000 00000001;  // Pedal Power Balance Present
+/// Flags: 0b00000000 00000010;  // Pedal Power Balance Reference
+/// Flags: 0b00000000 00000100;  // Accumulated Torque Present
+/// Flags: 0b00000000 00001000;  // Accumulated Torque Source
+/// Flags: 0b00000000 00010000;  // Wheel Revolution Data Present
+/// Flags: 0b00000000 00100000;  // Crank Revolution Data Present
+/// Flags: 0b00000000 01000000;  // Extreme Force Magnitudes Present
+/// Flags: 0b00000000 10000000;  // Extreme Torque Magnitudes Present
+/// Flags: 0b00000001 00000000;  // Extreme Angles Present
+/// Flags: 0b00000010 00000000;  // Top Dead Spot Angle Present
+/// Flags: 0b00000100 00000000;  // Bottom Dead Spot Angle Present
+/// Flags: 0b00001000 00000000;  // Accumulated Energy Present
+/// Flags: 0b00010000 00000000;  // Offset Compensation Indicator
+/// wheel event time unit: 1/2048s, crank event time unit: 1/1024s, both roll over
+///
+bool PeerCharacteristicPower::parse(const uint8_t* data, size_t length, Measurement* m) {
+    // size of the field of each present flag, the fields follow in the order of the flags
+    static const uint8_t sizes[] = {
+        1,  // BALANCE_PRESENT
+        0,  // BALANCE_REFERENCE_LEFT
+        2,  // TORQUE_PRESENT
+        0,  // TORQUE_SOURCE_CRANK
+        6,  // WHEEL_PRESENT
+        4,  // CRANK_PRESENT
+        4,  // EXTREME_FORCE_PRESENT
+        4,  // EXTREME_TORQUE_PRESENT
+        3,  // EXTREME_ANGLES_PRESENT
+        2,  // TOP_DEAD_SPOT_PRESENT
+        2,  // BOTTOM_DEAD_SPOT_PRESENT
+        2,  // ENERGY_PRESENT
+    };
+    if (length < 4) return false;
+    m->flags = data[0] | (data[1] << 8);
+    m->power = (int16_t)(data[2] | (data[3] << 8));
+    size_t offset = 4;
+    uint16_t present = m->flags & (BALANCE_PRESENT | TORQUE_PRESENT | WHEEL_PRESENT | CRANK_PRESENT |
+                                   EXTREME_FORCE_PRESENT | EXTREME_TORQUE_PRESENT | EXTREME_ANGLES_PRESENT |
+                                   TOP_DEAD_SPOT_PRESENT | BOTTOM_DEAD_SPOT_PRESENT | ENERGY_PRESENT);
+    while (present) {
+        uint8_t bit = __builtin_ctz(present);
+        present &= present - 1;
+        if (length < offset + sizes[bit]) return false;
+        const uint8_t* d = data + offset;
+        offset += sizes[bit];
+        switch (1 << bit) {
+            case BALANCE_PRESENT:
+                m->balance = d[0];
+                break;
+            case TORQUE_PRESENT:
+                m->accumulatedTorque = d[0] | (d[1] << 8);
+                break;
+            case WHEEL_PRESENT:
+                m->wheelRevolutions = d[0] | (d[1] << 8) | (d[2] << 16) | ((uint32_t)d[3] << 24);
+                m->lastWheelEvent = d[4] | (d[5] << 8);
+                break;
+            case CRANK_PRESENT:
+                m->crankRevolutions = d[0] | (d[1] << 8);
+                m->lastCrankEvent = d[2] | (d[3] << 8);
+                break;
+            case EXTREME_FORCE_PRESENT:
+                m->maxForce = (int16_t)(d[0] | (d[1] << 8));
+                m->minForce = (int16_t)(d[2] | (d[3] << 8));
+                break;
+            case EXTREME_TORQUE_PRESENT:
+                m->maxTorque = (int16_t)(d[0] | (d[1] << 8));
+                m->minTorque = (int16_t)(d[2] | (d[3] << 8));
+                break;
+            case EXTREME_ANGLES_PRESENT:
+                m->maxAngle = d[0] | ((d[1] & 0x0f) << 8);
+                m->minAngle = (d[1] >> 4) | (d[2] << 4);
+                break;
+            case TOP_DEAD_SPOT_PRESENT:
+                m->topDeadSpot = d[0] | (d[1] << 8);
+                break;
+            case BOTTOM_DEAD_SPOT_PRESENT:
+                m->bottomDeadSpot = d[0] | (d[1] << 8);
+                break;
+            case ENERGY_PRESENT:
+                m->accumulatedEnergy = d[0] | (d[1] << 8);
+                break;
+        }
     }
-    /// https://github.com/sputnikdev/bluetooth-gatt-parser/blob/master/src/main/resources/gatt/characteristic/org.bluetooth.characteristic.cycling_power_measurement.xml
-    ///
-    /// Format: little-endian (but NimBLE converts it to big-endian?)
-    /// Bytes: [flags: 2][power: 2(int16)]...[revolutions: 2(uint16)][last crank event: 2(uint16)]
-    /// Flags: 0b00000000 00000001;  // Pedal Power Balance Present
-    /// Flags: 0b00000000 00000010;  // Pedal Power Balance Reference
-    /// Flags: 0b00000000 00000100;  // Accumulated Torque Present
-    /// Flags: 0b00000000 00001000;  // Accumulated Torque Source
-    /// Flags: 0b00000000 00010000;  // Wheel Revolution Data Present
-    /// Flags: 0b00000000 00100000;  // *** Crank Revolution Data Present
-    /// Flags: 0b00000000 01000000;  // Extreme Force Magnitudes Present
-    /// Flags: 0b00000000 10000000;  // Extreme Torque Magnitudes Present
-    /// Flags: 0b00000001 00000000;  // Extreme Angles Present
-    /// Flags: 0b00000010 00000000;  // Top Dead Spot Angle Present
-    /// Flags: 0b00000100 00000000;  // Bottom Dead Spot Angle Present
-    /// Flags: 0b00001000 00000000;  // Accumulated Energy Present
-    /// Flags: 0b00010000 00000000;  // Offset Compensation Indicator
-    /// Flags: 0b00100000 00000000;  // ReservedForFutureUse
-    /// Flags: 0b01000000 00000000;  // ReservedForFutureUse
-    /// Flags: 0b10000000 00000000;  // ReservedForFutureUse
-    /// crank event time unit: 1/1024s, rolls over
-    ///
-
-    uint16_t flags = data[0] | (data[1] << 8);
-    // TODO power should be int16_t
-    uint16_t power = data[2] | (data[3] << 8);
-    // log_d("power: %d", power);
-
-    bool crankRevDataPresent = 0b00100000 & flags;
-    // log_d("flags: 0x%02X%s", flags, crankRevDataPresent ? " (crank rev data present)" : "");
-    if (!crankRevDataPresent) return power;
-
-    uint8_t offset = 4;
-    if (0b00000001 & flags) offset += 2;
-    if (0b00000100 & flags) offset += 2;
-    if (0b0001000 & flags) offset += 2;
-    if (length < offset + 4) {
-        log_e("power reading is missing crank rev data");
-        return power;
-    }
-    uint16_t revsIn = data[offset] | (data[offset + 1] << 8);
-    // log_d("revsIn: %d", revsIn);
-    uint16_t lceIn = data[offset + 2] | (data[offset + 3] << 8);
-    // log_d("last crank event: %d", lceIn);
+    return true;
+}
 
-    double dTime = 0.0;
-    if (lastCrankEvent > 0) {
-        dTime = (lceIn - ((lceIn < lastCrankEvent) ? (lastCrankEvent - UINT16_MAX) : lastCrankEvent)) / 1.024 / 60000;  // 1 minute
+uint16_t PeerCharacteristicPower::decode(const uint8_t* data, const size_t length) {
+    int64_t arrival = esp_timer_get_time();
+    Measurement m;
+    if (!parse(data, length, &m)) {
+        log_w("power reading too short (%d) for flags 0x%04x", length, m.flags);
+        return lastValue;
     }
+    measurement = m;
+    ulong t = millis();
 
-    uint16_t cadence = 0;
-    uint16_t dRev = 0;
-    if (revolutions > 0 && dTime > 0) {
-        dRev = revsIn - ((revsIn < revolutions) ? (revolutions - UINT16_MAX) : revolutions);
-        cadence = dRev / dTime;
+    if (m.flags & CRANK_PRESENT) {
+        // the unsigned differences take care of the rollover
+        uint16_t dTime = m.lastCrankEvent - lastCrankEvent;  // 1/1024 s
+        uint16_t dRevs = m.crankRevolutions - revolutions;
+        if (crankEventKnown && 0 < dTime) lastCadence = (uint16_t)(((uint32_t)dRevs * 60 * 1024 + dTime / 2) / dTime);
+        if (!crankEventKnown || 0 < dTime) {
+            lastCrankEvent = m.lastCrankEvent;
+            lastCrankEventTime = t;
+        }
+        revolutions = m.crankRevolutions;
+        crankEventKnown = true;
     }
+    if (ATOLL_POWER_EVENT_TIMEOUT < t - lastCrankEventTime) lastCadence = 0;
 
-    ulong t = millis();
-    if (lastCrankEventTime < t - 2000) cadence = 0;
-    if (lastCrankEvent != lceIn) {
-        lastCrankEvent = lceIn;
-        lastCrankEventTime = t;
+    if (m.flags & WHEEL_PRESENT) {
+        uint16_t dTime = m.lastWheelEvent - lastWheelEvent;  // 1/2048 s
+        uint32_t dRevs = m.wheelRevolutions - wheelRevolutions;
+        // 1/100 km/h = mm/s * 36 / 100
+        if (wheelEventKnown && 0 < dTime)
+            lastSpeed = (uint16_t)((uint64_t)dRevs * wheelCircumference * 2048 * 36 / ((uint32_t)dTime * 100));
+        if (!wheelEventKnown || 0 < dTime) {
+            lastWheelEvent = m.lastWheelEvent;
+            lastWheelEventTime = t;
+        }
+        wheelRevolutions = m.wheelRevolutions;
+        wheelEventKnown = true;
     }
+    if (ATOLL_POWER_EVENT_TIMEOUT < t - lastWheelEventTime) lastSpeed = 0;
 
-    // if ((lastCadence != cadence && cadence > 0) || (lastCrankEventTime < t - 2000)) {
-    //     log_d("TODO notify new cadence: %d", cadence);
-    // }
-    lastCadence = cadence;
-    revolutions = revsIn;
-
+    // TODO power should be int16_t
+    uint16_t power = m.power < 0 ? 0 : (uint16_t)m.power;
+    EventBus::publish(EventBus::POWER, power, this, 0, arrival);
+    if (m.flags & CRANK_PRESENT) EventBus::publish(EventBus::CADENCE, lastCadence, this, 0, arrival);
+    if (m.flags & WHEEL_PRESENT) EventBus::publish(EventBus::SPEED, lastSpeed / 100.0f, this, 0, arrival);
     return power;
 }
 
@@ -3,23 +3,81 @@
 
 #include "atoll_peer_characteristic_template.h"
 
+#ifndef ATOLL_POWER_WHEEL_CIRCUMFERENCE
+#define ATOLL_POWER_WHEEL_CIRCUMFERENCE 2105  // mm, 700x25c
+#endif
+
+#ifndef ATOLL_POWER_EVENT_TIMEOUT
+#define ATOLL_POWER_EVENT_TIMEOUT 2000  // ms without a new crank or wheel event after which cadence or speed is 0
+#endif
+
 namespace Atoll {
 
 class PeerCharacteristicPower : public PeerCharacteristicTemplate<uint16_t> {
    public:
+    // Cycling Power Measurement fields in the units of the spec
+    struct Measurement {
+        uint16_t flags = 0;
+        int16_t power = 0;                // W
+        uint8_t balance = 0;              // 1/2 %
+        uint16_t accumulatedTorque = 0;   // 1/32 Nm
+        uint32_t wheelRevolutions = 0;    // cumulative
+        uint16_t lastWheelEvent = 0;      // 1/2048 s, rolls over
+        uint16_t crankRevolutions = 0;    // cumulative
+        uint16_t lastCrankEvent = 0;      // 1/1024 s, rolls over
+        int16_t maxForce = 0;             // N
+        int16_t minForce = 0;             // N
+        int16_t maxTorque = 0;            // 1/32 Nm
+        int16_t minTorque = 0;            // 1/32 Nm
+        uint16_t maxAngle = 0;            // degrees, 12 bits
+        uint16_t minAngle = 0;            // degrees, 12 bits
+        uint16_t topDeadSpot = 0;         // degrees
+        uint16_t bottomDeadSpot = 0;      // degrees
+        uint16_t accumulatedEnergy = 0;   // kJ
+    };
+
+    enum Flag : uint16_t {
+        BALANCE_PRESENT = 1 << 0,
+        BALANCE_REFERENCE_LEFT = 1 << 1,
+        TORQUE_PRESENT = 1 << 2,
+        TORQUE_SOURCE_CRANK = 1 << 3,
+        WHEEL_PRESENT = 1 << 4,
+        CRANK_PRESENT = 1 << 5,
+        EXTREME_FORCE_PRESENT = 1 << 6,
+        EXTREME_TORQUE_PRESENT = 1 << 7,
+        EXTREME_ANGLES_PRESENT = 1 << 8,
+        TOP_DEAD_SPOT_PRESENT = 1 << 9,
+        BOTTOM_DEAD_SPOT_PRESENT = 1 << 10,
+        ENERGY_PRESENT = 1 << 11,
+        OFFSET_COMPENSATION = 1 << 12,
+    };
+
     // lastValue is power
+    Measurement measurement;
     uint16_t revolutions = 0;
     uint16_t lastCrankEvent = 0;
     ulong lastCrankEventTime = 0;
-    uint16_t lastCadence = 0;
+    uint16_t lastCadence = 0;      // rpm
+    uint32_t wheelRevolutions = 0;
+    uint16_t lastWheelEvent = 0;
+    ulong lastWheelEventTime = 0;
+    uint16_t lastSpeed = 0;        // 1/100 km/h
+    uint16_t wheelCircumference = ATOLL_POWER_WHEEL_CIRCUMFERENCE;  // mm
 
     PeerCharacteristicPower();
     // virtual ~PeerCharacteristicPower();
 
+    // Parses every field present in the frame, returns false if the frame is
+    // shorter than its flags require. Needs no state.
+    static bool parse(const uint8_t* data, size_t length, Measurement* m);
     virtual uint16_t decode(const uint8_t* data, const size_t length);
     virtual bool encode(const uint16_t value, uint8_t* data, size_t length);
+
+   protected:
+    bool crankEventKnown = false;
+    bool wheelEventKnown = false;
 };
 
 }  // namespace Atoll
 
-#endif
\ No newline at end of file
+#endif
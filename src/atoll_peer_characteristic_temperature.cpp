@@ -21,7 +21,9 @@ float PeerCharacteristicTemperature::decode(const uint8_t* data, const size_t le
     /// Format: sint16 little-endian
     /// Bytes:
     /// [Temperature: 2] ˚C * 100
-    return (float)(((int16_t)data[0] | ((int16_t)data[1] << 8))) / 100;
+    float value = (float)(((int16_t)data[0] | ((int16_t)data[1] << 8))) / 100;
+    EventBus::publish(EventBus::TEMPERATURE, value, this);
+    return value;
 }
 
 bool PeerCharacteristicTemperature::encode(const float value, uint8_t* data, size_t length) {
@@ -15,6 +15,8 @@ void Recorder::setup(GPS *gps,
     powerBuf.clear();
     cadenceBuf.clear();
     heartrateBuf.clear();
+    EventBus::unsubscribe(onEvent, this);
+    if (0 != eventTopics) EventBus::subscribe(eventTopics, onEvent, this);
 
     if (nullptr == gps) {
         log_e("no gps");
@@ -34,8 +36,22 @@ void Recorder::setup(GPS *gps,
     if (nullptr == instance) return;
     this->instance = instance;
     this->api = api;
-    if (nullptr != api)
+    if (nullptr != api) {
         api->addCommand(Api::Command("rec", recProcessor));
+        api->addChannel(Api::Channel("rec", [this](char *buf, size_t size, float *value) {
+            snprintf(buf, size, "%d|%.0f", isRecording ? 1 : 0, stats.distance);
+            *value = stats.distance;
+            return true;
+        }));
+        api->addCommand(Api::Command("hrv", hrvProcessor));
+        api->addChannel(Api::Channel("hrv", [this](char *buf, size_t size, float *value) {
+            float rmssd, alpha1;
+            if (!hrvValues(&rmssd, &alpha1)) return false;
+            snprintf(buf, size, "%.1f|%.2f", rmssd, alpha1);
+            *value = alpha1;
+            return true;
+        }));
+    }
 }
 
 void Recorder::loop() {
@@ -445,7 +461,9 @@ bool Recorder::start() {
     currentPath(true);  // reset
     resetBuffer(true);
     isRecording = true;
+    taskSetActivity(TaskActivity::recording, true);
     loadStats(false);
+    Api::channelChanged("rec");
     return true;
 }
 
@@ -477,6 +495,8 @@ bool Recorder::stop(bool forgetLast) {
         }
     }
     isRecording = false;
+    taskSetActivity(TaskActivity::recording, false);
+    Api::channelChanged("rec");
     resetBuffer();
     currentPath(true);       // reset
     currentStatsPath(true);  // reset
@@ -586,6 +606,51 @@ int16_t Recorder::avgHeartrate(bool clearBuffer) {
     return (int16_t)avg;
 }
 
+void Recorder::onEvent(const EventBus::Event &event, void *arg) {
+    Recorder *recorder = (Recorder *)arg;
+    const void *source = recorder->eventSources[event.topic];
+    if (nullptr != source && source != event.source) return;
+    switch (event.topic) {
+        case EventBus::POWER:
+            recorder->onPower((uint16_t)event.value);
+            break;
+        case EventBus::CADENCE:
+            recorder->onCadence((uint8_t)event.value);
+            break;
+        case EventBus::HEARTRATE:
+            recorder->onHeartrate((uint8_t)event.value);
+            break;
+        case EventBus::RR_INTERVAL:
+            recorder->onRrInterval((uint16_t)event.value);
+            break;
+        case EventBus::TEMPERATURE:
+            recorder->onTemperature((int16_t)lroundf(event.value * 10));
+            break;
+    }
+}
+
+void Recorder::onRrInterval(uint16_t value) {
+    if (!aquireMutex(hrvMutex)) {
+        log_e("could not aquire hrvMutex to add %d", value);
+        return;
+    }
+    hrv.add(value);
+    releaseMutex(hrvMutex);
+}
+
+bool Recorder::hrvValues(float *rmssd, float *alpha1, uint32_t *beats, uint32_t *artifacts) {
+    if (!aquireMutex(hrvMutex)) {
+        log_e("could not aquire hrvMutex");
+        return false;
+    }
+    *rmssd = hrv.rmssd();
+    *alpha1 = hrv.dfaAlpha1();
+    if (nullptr != beats) *beats = hrv.beats;
+    if (nullptr != artifacts) *artifacts = hrv.artifacts;
+    releaseMutex(hrvMutex);
+    return true;
+}
+
 void Recorder::onTemperature(int16_t value) {
     temperature = value;
 }
@@ -1222,4 +1287,22 @@ Api::Result *Recorder::recProcessor(Api::Message *msg) {
     return result;
 }
 
+// hrv: rmssd:alpha1:beats:artifacts, rmssd in ms, -1: unknown
+// hrv=reset: clears the window
+Api::Result *Recorder::hrvProcessor(Api::Message *msg) {
+    if (nullptr == instance) return Api::error();
+    if (msg->argIs("reset")) {
+        if (!instance->aquireMutex(instance->hrvMutex)) return Api::internalError();
+        instance->hrv.reset();
+        instance->releaseMutex(instance->hrvMutex);
+    } else if (0 < strlen(msg->arg))
+        return Api::argInvalid();
+    float rmssd, alpha1;
+    uint32_t beats, artifacts;
+    if (!instance->hrvValues(&rmssd, &alpha1, &beats, &artifacts)) return Api::internalError();
+    snprintf(msg->reply, sizeof(msg->reply), "%.1f:%.2f:%u:%u",
+             rmssd, alpha1, beats, artifacts);
+    return Api::success();
+}
+
 #endif
\ No newline at end of file
@@ -9,6 +9,8 @@
 #include "atoll_fs.h"
 #include "atoll_api.h"
 #include "atoll_log.h"
+#include "atoll_hrv.h"
+#include "atoll_event_bus.h"
 
 #ifndef ATOLL_RECORDER_BUFFER_SIZE
 #define ATOLL_RECORDER_BUFFER_SIZE 60
@@ -152,6 +154,18 @@ class Recorder : public Task {
     virtual bool end();
     virtual bool stop(bool forgetLast = false);
 
+    // Topics received from the event bus, set before setup(), subscribing
+    // starts the bus, see EventBus. By default cadence, which applications do
+    // not feed by hand; power, heart rate and temperature are left to the
+    // on...() methods and the heart rate characteristic calls onRrInterval(),
+    // do not do both for a topic.
+    uint32_t eventTopics = EventBus::topicBit(EventBus::CADENCE);
+    // the publisher to record for each topic, nullptr: any, e.g. a TemperatureSensor
+    // when the temperature characteristic of a peer publishes to the same topic
+    const void *eventSources[EventBus::TOPICS] = {};
+    // calls the on...() method of the topic
+    static void onEvent(const EventBus::Event &event, void *arg);
+
     virtual void onDistanceChanged(double value) {}
     virtual void onAltGainChanged(uint16_t value) {}
 
@@ -170,6 +184,13 @@ class Recorder : public Task {
     virtual void onHeartrate(uint8_t value);
     int16_t avgHeartrate(bool clearBuffer = false);
 
+    Hrv hrv;  // use hrvMutex
+    SemaphoreHandle_t hrvMutex = xSemaphoreCreateMutex();
+    // unit: ms, called by PeerCharacteristicHeartrate from the BLE host
+    virtual void onRrInterval(uint16_t value);
+    // returns false on error, -1: unknown
+    bool hrvValues(float *rmssd, float *alpha1, uint32_t *beats = nullptr, uint32_t *artifacts = nullptr);
+
     int16_t temperature = INT16_MIN;  // unit: ˚C / 10, INT16_MIN: unknown
     // unit: ˚C / 10, INT16_MIN: unknown
     virtual void onTemperature(int16_t value);
@@ -180,6 +201,7 @@ class Recorder : public Task {
     virtual bool rec2gpx(const char *in, const char *out, bool overwrite = false);
 
     static Api::Result *recProcessor(Api::Message *reply);
+    static Api::Result *hrvProcessor(Api::Message *msg);
 };
 
 }  // namespace Atoll
@@ -1,12 +1,25 @@
 #include "atoll_task.h"
+#include "atoll_task_executor.h"
 
 using namespace Atoll;
 
+Task *Task::_tasks[ATOLL_TASK_MAX_TASKS];
+uint8_t Task::_numTasks = 0;
+portMUX_TYPE Task::_tasksMux = portMUX_INITIALIZER_UNLOCKED;
+volatile uint32_t Task::_taskActivity = 0;
+uint64_t Task::_taskModeTimes[2] = {0, 0};
+ulong Task::_taskModeSince = 0;
+SemaphoreHandle_t Task::_taskGovernorMutex = xSemaphoreCreateMutex();
+
 void Task::taskStart(float freq,
                      uint32_t stack,
                      int8_t priority,
                      int8_t core) {
-    if (0 < freq) _taskFreq = freq;
+    if (_taskGoverned) _taskGovern();
+    if (0 < freq) {
+        _taskFreq = freq;
+        if (_taskGoverned) _taskFreqs[_taskActive] = freq;
+    }
     if (0 < stack) taskSetStack(stack);
     if (0 <= priority) _taskPriority = (uint8_t)priority;
     if (0 <= core) _taskCore = (uint8_t)core;
@@ -19,6 +32,25 @@ void Task::taskStart(float freq,
         log_e("not creating task for %s because freq is %.2fHz", taskName(), _taskFreq);
         return;
     }
+    TaskExecutor *executor = _taskExecutor;
+#if 0 < ATOLL_TASK_SHARE_MAX_FREQ
+    if (nullptr == executor && _taskAutoShare && _taskFreq <= ATOLL_TASK_SHARE_MAX_FREQ)
+        executor = TaskExecutor::defaultExecutor;
+#endif
+    if (nullptr != executor && executor != this && executor->taskRunning()) {
+        if (executor->add(this)) {
+            _taskRegister(this);
+            log_i("Started task '%s' at %.2fHz (delay: %dms) on %s",
+                  taskName(), _taskFreq, taskDelayMs(), executor->taskName());
+            return;
+        }
+        log_w("could not add %s to %s, starting a dedicated thread", taskName(), executor->taskName());
+    }
+    if (nullptr == _taskWakeup) _taskWakeup = xSemaphoreCreateBinary();
+    if (nullptr == _taskWakeup) {
+        log_e("Failed to create semaphore for '%s'", taskName());
+        return;
+    }
     uint32_t heap = xPortGetFreeHeapSize();
     BaseType_t err = xTaskCreatePinnedToCore(
         _taskLoop,
@@ -32,12 +64,13 @@ void Task::taskStart(float freq,
         log_e("Failed to start task '%s', error %d", taskName(), err);
         return;
     }
+    _taskRegister(this);
     log_i("Started task '%s' at %.2fHz (delay: %dms), stack: %d, heap: %d before, %d after",
           taskName(), _taskFreq, taskDelayMs(), _taskStack, heap, xPortGetFreeHeapSize());
 }
 
 bool Task::taskRunning() {
-    return NULL != taskHandle;
+    return NULL != taskHandle || _taskScheduled;
 }
 
 void Task::taskStop() {
@@ -46,12 +79,19 @@ void Task::taskStop() {
         return;
     }
     log_i("Stopping %s", taskName());
+    if (_taskScheduled) {
+        if (nullptr != _taskExecutor) _taskExecutor->remove(this);
+        _taskScheduled = false;
+        _taskUnregister(this);
+        return;
+    }
     if (NULL == taskHandle) {
         log_w("%s taskHandle is null", taskName());
         return;
     }
     TaskHandle_t t = taskHandle;
     taskHandle = NULL;
+    _taskUnregister(this);
     vTaskDelete(t);
 }
 
@@ -60,6 +100,7 @@ void Task::taskSetFreq(const float freq) {
         // log_d("%s not setting zero freq", taskName());
         return;
     }
+    if (_taskGoverned) _taskFreqs[_taskActive] = freq;
     _taskSetFreqAndDelay(freq);
     _taskDebug("taskSetFreq");
 }
@@ -93,35 +134,243 @@ int Task::taskGetLowestStackLevel() {
 
 void Task::loop(){};
 Task::Task(){};
-Task::~Task() {}
+Task::~Task() {
+    if (_taskScheduled && nullptr != _taskExecutor) _taskExecutor->remove(this);
+    _taskUnregister(this);
+    if (nullptr != _taskWakeup) vSemaphoreDelete(_taskWakeup);
+}
+
+void Task::taskSetShared(TaskExecutor *executor) {
+    if (taskRunning()) log_w("%s is running, restart it to apply", taskName());
+    _taskExecutor = executor;
+    _taskAutoShare = false;
+}
+
+void Task::taskNotify() {
+    if (!_taskWakeOnNotify) return;
+    if (_taskScheduled) {
+        if (nullptr != _taskExecutor) _taskExecutor->wake(this);
+        return;
+    }
+    if (nullptr != taskHandle && nullptr != _taskWakeup) xSemaphoreGive(_taskWakeup);
+}
+
+void Task::taskSetWakeOnNotify(bool enable) {
+    _taskWakeOnNotify = enable;
+}
+
+void Task::taskSetGovernor(float idleFreq, float activeFreq, uint32_t signals) {
+    if (idleFreq <= 0.0f || activeFreq <= 0.0f) {
+        log_e("%s invalid freq %.2f/%.2f", taskName(), idleFreq, activeFreq);
+        return;
+    }
+    _taskFreqs[0] = idleFreq;
+    _taskFreqs[1] = activeFreq;
+    _taskActivitySignals = signals;
+    _taskGoverned = true;
+    _taskGovern();
+}
+
+void Task::taskSetActivity(uint32_t signals, bool active) {
+    ulong t = millis();
+    portENTER_CRITICAL(&_tasksMux);
+    uint32_t activity = active ? _taskActivity | signals : _taskActivity & ~signals;
+    bool changed = activity != _taskActivity;
+    if ((0 != activity) != (0 != _taskActivity)) {
+        _taskModeTimes[0 != _taskActivity] += t - _taskModeSince;
+        _taskModeSince = t;
+    }
+    _taskActivity = activity;
+    portEXIT_CRITICAL(&_tasksMux);
+    if (!changed) return;
+    for (uint8_t i = 0; i < _numTasks; i++) {
+        Task *task = taskAt(i);
+        if (nullptr != task && task->_taskGoverned) task->_taskGovern();
+    }
+}
+
+uint64_t Task::taskModeTime(bool active) {
+    ulong t = millis();
+    portENTER_CRITICAL(&_tasksMux);
+    uint64_t time = _taskModeTimes[active];
+    if (active == (0 != _taskActivity)) time += t - _taskModeSince;
+    portEXIT_CRITICAL(&_tasksMux);
+    return time;
+}
+
+void Task::taskModeTimeReset() {
+    ulong t = millis();
+    portENTER_CRITICAL(&_tasksMux);
+    _taskModeTimes[0] = 0;
+    _taskModeTimes[1] = 0;
+    _taskModeSince = t;
+    portEXIT_CRITICAL(&_tasksMux);
+}
+
+// Applies the freq of the current mode. When switching to a higher freq, the
+// task is woken so it does not sleep out the rest of the slow period.
+void Task::_taskGovern() {
+    if (!_taskGoverned) return;
+    if (pdTRUE != xSemaphoreTake(_taskGovernorMutex, portMAX_DELAY)) return;
+    _taskActive = 0 != (_taskActivity & _taskActivitySignals);
+    float freq = _taskFreqs[_taskActive];
+    bool faster = _taskFreq < freq;
+    if (freq != _taskFreq) {
+        _taskFreq = freq;
+        TickType_t delay = pdMS_TO_TICKS(1000 / freq);
+        _taskDelay = 0 < delay ? delay : 1;
+    }
+    xSemaphoreGive(_taskGovernorMutex);
+    if (!faster) return;
+    if (_taskScheduled) {
+        if (nullptr != _taskExecutor) _taskExecutor->wake(this, false);
+    } else if (nullptr != taskHandle && nullptr != _taskWakeup && xTaskGetCurrentTaskHandle() != taskHandle)
+        xSemaphoreGive(_taskWakeup);
+}
 
 void Task::_taskLoop(void *p) {
     Task *thisPtr = (Task *)p;
     thisPtr->_taskLastWakeTime = xTaskGetTickCount();
+#if 0 < ATOLL_TASK_STATS_LOG_INTERVAL
+    static ulong lastStatsLog = 0;
+#endif
     for (;;) {
         // log_d("%s loop %d", thisPtr->taskName(), thisPtr->_taskLoopCount);
         if (1 != thisPtr->_taskLoopCount) {  // skip loop #1
-            ulong start = millis();
+            int64_t start = esp_timer_get_time();
             thisPtr->loop();
-            ulong loopTime = millis() - start;
-            /*
-            if (thisPtr->_taskDelay < loopTime) {
-                log_w("%s loop time %dms > taskDelay %dms (taskFreq %.2fHz)",
-                      thisPtr->taskName(), loopTime,
-                      pdTICKS_TO_MS(thisPtr->_taskDelay), thisPtr->_taskFreq);
-            }
-            */
+            thisPtr->_taskRecordLoop((uint32_t)(esp_timer_get_time() - start));
+        }
+#if 0 < ATOLL_TASK_STATS_LOG_INTERVAL
+        ulong t = millis();
+        bool logStats = false;
+        portENTER_CRITICAL(&_tasksMux);
+        if (ATOLL_TASK_STATS_LOG_INTERVAL <= t - lastStatsLog) {
+            lastStatsLog = t;
+            logStats = true;
         }
+        portEXIT_CRITICAL(&_tasksMux);
+        if (logStats) taskLogStats();
+#endif
         thisPtr->_taskLastWakeTime = xTaskGetTickCount();
         thisPtr->_taskNextWakeTime = thisPtr->_taskLastWakeTime + thisPtr->_taskDelay;
         // log_i("%s delaying for %dms", thisPtr->taskName(),
         //       pdTICKS_TO_MS(thisPtr->_taskNextWakeTime) - millis());
-        if (thisPtr->_taskLoopCount)  // don't delay first loop
-            xTaskDelayUntil(&(thisPtr->_taskLastWakeTime), thisPtr->_taskDelay);
+        if (thisPtr->_taskLoopCount && thisPtr->_taskWakeOnNotify) {
+            // the semaphore is binary, notifications that arrived during the
+            // loop result in one immediate wakeup
+            if (pdTRUE == xSemaphoreTake(thisPtr->_taskWakeup, thisPtr->_taskDelay))
+                thisPtr->taskStats.notified++;
+        } else if (thisPtr->_taskLoopCount) {  // don't delay first loop
+            // only the governor gives the semaphore of a periodic task
+            if (pdTRUE != xSemaphoreTake(thisPtr->_taskWakeup, thisPtr->_taskDelay)) {
+                TickType_t woke = xTaskGetTickCount();
+                if (thisPtr->_taskNextWakeTime < woke) {
+                    uint32_t jitter = pdTICKS_TO_MS(woke - thisPtr->_taskNextWakeTime);
+                    thisPtr->taskStats.jitterTotal += jitter;
+                    if (thisPtr->taskStats.jitterMax < jitter) thisPtr->taskStats.jitterMax = jitter;
+                }
+            }
+        }
         thisPtr->_taskLoopCount++;
     }
 }
 
+// Tasks that block inside loop(), e.g. waiting on a queue, are measured
+// including the time spent blocked.
+void Task::_taskRecordLoop(uint32_t loopTimeUs) {
+    taskStats.loops++;
+    taskStats.loopTimeTotal += loopTimeUs;
+    taskStats.awakeTime[0 != _taskActivity] += loopTimeUs;
+    if (taskStats.loopTimeMax < loopTimeUs) taskStats.loopTimeMax = loopTimeUs;
+    if ((uint64_t)pdTICKS_TO_MS(_taskDelay) * 1000 < loopTimeUs) {
+        taskStats.overruns++;
+        // log_w("%s loop time %dus > taskDelay %dms (taskFreq %.2fHz)",
+        //       taskName(), loopTimeUs, pdTICKS_TO_MS(_taskDelay), _taskFreq);
+    }
+    uint8_t bucket = 0;
+    uint32_t limit = 64;
+    while (bucket < ATOLL_TASK_STATS_BUCKETS - 1 && limit <= loopTimeUs) {
+        bucket++;
+        limit <<= 2;
+    }
+    taskStats.histogram[bucket]++;
+}
+
+void Task::taskStatsReset() {
+    taskStats = Stats();
+}
+
+size_t Task::taskStatsToStr(char *buf, size_t size) {
+    int written = snprintf(buf, size, "%s:%u:%u:%u:%u:%u:%d:%u",
+                           taskName(),
+                           taskStats.loops,
+                           0 < taskStats.loops ? (uint32_t)(taskStats.loopTimeTotal / taskStats.loops) : 0,
+                           taskStats.loopTimeMax,
+                           taskStats.overruns,
+                           taskStats.jitterMax,
+                           taskGetLowestStackLevel(),
+                           taskStats.notified);
+    if (written < 0) return 0;
+    return (size_t)written < size ? written : size - 1;
+}
+
+uint8_t Task::taskCount() {
+    return _numTasks;
+}
+
+Task *Task::taskAt(uint8_t index) {
+    Task *task = nullptr;
+    portENTER_CRITICAL(&_tasksMux);
+    if (index < _numTasks) task = _tasks[index];
+    portEXIT_CRITICAL(&_tasksMux);
+    return task;
+}
+
+Task *Task::taskFind(const char *name) {
+    for (uint8_t i = 0; i < _numTasks; i++) {
+        Task *task = taskAt(i);
+        if (nullptr != task && 0 == strcmp(task->taskName(), name)) return task;
+    }
+    return nullptr;
+}
+
+void Task::taskLogStats() {
+    log_i("activity: 0x%x, idle: %llums, active: %llums",
+          _taskActivity, taskModeTime(false), taskModeTime(true));
+    log_i("name:loops:avgUs:maxUs:overruns:jitterMaxMs:stackFree:notified");
+    char buf[64];
+    for (uint8_t i = 0; i < _numTasks; i++) {
+        Task *task = taskAt(i);
+        if (nullptr == task) continue;
+        task->taskStatsToStr(buf, sizeof(buf));
+        log_i("%s", buf);
+    }
+}
+
+void Task::_taskRegister(Task *task) {
+    bool added = false;
+    portENTER_CRITICAL(&_tasksMux);
+    for (uint8_t i = 0; i < _numTasks; i++)
+        if (task == _tasks[i]) added = true;
+    if (!added && _numTasks < ATOLL_TASK_MAX_TASKS) {
+        _tasks[_numTasks++] = task;
+        added = true;
+    }
+    portEXIT_CRITICAL(&_tasksMux);
+    if (!added) log_w("registry full, not tracking %s", task->taskName());
+}
+
+void Task::_taskUnregister(Task *task) {
+    portENTER_CRITICAL(&_tasksMux);
+    for (uint8_t i = 0; i < _numTasks; i++)
+        if (task == _tasks[i]) {
+            _tasks[i] = _tasks[--_numTasks];
+            break;
+        }
+    portEXIT_CRITICAL(&_tasksMux);
+}
+
 void Task::_taskSetFreqAndDelay(const float freq) {
     _taskFreq = 0.0001f < freq ? freq : 0.0001f;
     if (_taskFreq <= 0.0001f) {
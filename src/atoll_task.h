@@ -22,8 +22,35 @@
 #define ATOLL_TASK_DEFAULT_CORE 1
 #endif
 
+#ifndef ATOLL_TASK_SHARE_MAX_FREQ
+#define ATOLL_TASK_SHARE_MAX_FREQ 0  // Hz, tasks up to this freq run on the default executor, 0: disabled
+#endif
+
+#ifndef ATOLL_TASK_MAX_TASKS
+#define ATOLL_TASK_MAX_TASKS 24  // max number of running tasks in the registry
+#endif
+
+#ifndef ATOLL_TASK_STATS_BUCKETS
+#define ATOLL_TASK_STATS_BUCKETS 8  // loop time histogram buckets: <64us, <256us, <1ms, <4ms, <16ms, <65ms, <262ms, more
+#endif
+
+#ifndef ATOLL_TASK_STATS_LOG_INTERVAL
+#define ATOLL_TASK_STATS_LOG_INTERVAL 0  // ms between logging a summary of the task stats, 0: never
+#endif
+
 namespace Atoll {
 
+class TaskExecutor;
+
+// activity signals for the governor, see Task::taskSetGovernor()
+struct TaskActivity {
+    static const uint32_t moving = 1;     // gps speed over the walking speed
+    static const uint32_t peers = 2;      // a ble peer is connected
+    static const uint32_t recording = 4;  // the recorder is recording
+    static const uint32_t uploading = 8;  // ota update in progress
+    static const uint32_t any = 0xffffffff;
+};
+
 class Task {
    public:
     TaskHandle_t taskHandle = nullptr;
@@ -44,10 +71,66 @@ class Task {
     ulong taskDelayMs();
     virtual void loop();
 
+    // Runs the loop on the executor's thread instead of a dedicated one,
+    // nullptr: always use a dedicated thread. Call before taskStart().
+    virtual void taskSetShared(TaskExecutor *executor);
+    bool taskShared() { return _taskScheduled; }
+
+    // Wakes the task before its next period, e.g. from a data received or a
+    // connection event, the task delay becomes the max time between loops.
+    // Notifications while the loop is running wake it once more, only
+    // effective after taskSetWakeOnNotify(true). Not for use in an ISR.
+    // Uses a semaphore of the task, not the FreeRTOS task notification, which
+    // blocking calls in the loop (e.g. NimBLE client calls) wait on.
+    void taskNotify();
+    virtual void taskSetWakeOnNotify(bool enable);
+    bool taskWakeOnNotify() { return _taskWakeOnNotify; }
+
+    // Runs the task at activeFreq while any of the signals is set and at
+    // idleFreq otherwise. taskStart(freq) and taskSetFreq() change the freq
+    // of the current mode.
+    void taskSetGovernor(float idleFreq, float activeFreq, uint32_t signals = TaskActivity::any);
+    bool taskGoverned() { return _taskGoverned; }
+    bool taskGovernorActive() { return _taskActive; }
+    float taskGovernorFreq(bool active) { return _taskFreqs[active]; }
+    // sets or clears activity signals, the governed tasks are updated on change
+    static void taskSetActivity(uint32_t signals, bool active);
+    static uint32_t taskActivity() { return _taskActivity; }
+    // ms spent with no activity signal set / with any activity signal set
+    static uint64_t taskModeTime(bool active);
+    static void taskModeTimeReset();
+
+    // loop statistics, updated by the task itself
+    struct Stats {
+        uint32_t loops = 0;                                 // number of measured loops
+        uint32_t overruns = 0;                              // number of loops that took longer than the task delay
+        uint64_t loopTimeTotal = 0;                         // us
+        uint32_t loopTimeMax = 0;                           // us
+        uint32_t histogram[ATOLL_TASK_STATS_BUCKETS] = {};  // number of loops per loop time bucket
+        uint64_t jitterTotal = 0;                           // ms, late wakeups against the scheduled wake time
+        uint32_t jitterMax = 0;                             // ms
+        uint32_t notified = 0;                              // number of loops woken by taskNotify()
+        uint64_t awakeTime[2] = {};                         // us spent in loop() while the system was idle / active
+    };
+
+    Stats taskStats;
+    void taskStatsReset();
+    // name:loops:avgUs:maxUs:overruns:jitterMaxMs:stackFree:notified
+    size_t taskStatsToStr(char *buf, size_t size);
+
+    // running tasks
+    static uint8_t taskCount();
+    static Task *taskAt(uint8_t index);
+    static Task *taskFind(const char *name);
+    // logs the stats of all running tasks
+    static void taskLogStats();
+
     Task();
     virtual ~Task();
 
    protected:
+    friend class TaskExecutor;
+
     float _taskFreq = ATOLL_TASK_DEFAULT_FREQ;
     uint32_t _taskStack = ATOLL_TASK_DEFAULT_STACK;
     uint8_t _taskPriority = ATOLL_TASK_DEFAULT_PRIORITY;
@@ -56,6 +139,16 @@ class Task {
     TickType_t _taskNextWakeTime = 0;
     TickType_t _taskDelay = 0;
     ulong _taskLoopCount = 0;
+    TaskExecutor *_taskExecutor = nullptr;  // the executor to run on, nullptr: dedicated thread
+    bool _taskScheduled = false;            // whether the task is running on an executor
+    bool _taskAutoShare = true;             // whether ATOLL_TASK_SHARE_MAX_FREQ applies
+    bool _taskWakeOnNotify = false;         // whether to wait for taskNotify() instead of the fixed period
+    bool _taskNotified = false;             // notified while running on the executor, use the executor mutex
+    bool _taskGoverned = false;             // whether the freq is set by the governor
+    bool _taskActive = false;               // governor mode, use _taskGovernorMutex
+    float _taskFreqs[2] = {0, 0};           // governor freq when idle / active
+    uint32_t _taskActivitySignals = 0;      // signals that switch the task to active
+    SemaphoreHandle_t _taskWakeup = nullptr;  // given to end the wait between loops of a dedicated thread
 
     static void _taskLoop(void *p);
     void _taskSetFreqAndDelay(const float freq);
@@ -64,6 +157,19 @@ class Task {
     void _taskSetDelay();
     void _taskAbortDelay();
     void _taskDebug(const char *tag = "");
+    void _taskRecordLoop(uint32_t loopTimeUs);
+    void _taskGovern();
+
+    static Task *_tasks[ATOLL_TASK_MAX_TASKS];
+    static uint8_t _numTasks;
+    static portMUX_TYPE _tasksMux;
+    static void _taskRegister(Task *task);
+    static void _taskUnregister(Task *task);
+
+    static volatile uint32_t _taskActivity;
+    static uint64_t _taskModeTimes[2];
+    static ulong _taskModeSince;
+    static SemaphoreHandle_t _taskGovernorMutex;
 };
 
 }  // namespace Atoll
@@ -0,0 +1,214 @@
+#include "atoll_task_executor.h"
+
+using namespace Atoll;
+
+TaskExecutor *TaskExecutor::defaultExecutor = nullptr;
+
+TaskExecutor::TaskExecutor() {
+    // the loop sleeps until the next deadline itself
+    _taskSetFreqAndDelay((TickType_t)1);
+    _taskStack = ATOLL_TASK_EXECUTOR_STACK;
+    _taskPriority = ATOLL_TASK_EXECUTOR_PRIORITY;
+}
+
+TaskExecutor::~TaskExecutor() {
+    vSemaphoreDelete(mutex);
+    vSemaphoreDelete(wakeup);
+}
+
+void TaskExecutor::taskStart(float freq,
+                             uint32_t stack,
+                             int8_t priority,
+                             int8_t core) {
+    Task::taskStart(freq, stack, priority, core);
+    if (taskRunning() && nullptr == defaultExecutor) defaultExecutor = this;
+}
+
+void TaskExecutor::loop() {
+    // collect the due tasks
+    Entry due[ATOLL_TASK_EXECUTOR_MAX_TASKS];
+    uint8_t numDue = 0;
+    ulong t = millis();
+    if (pdTRUE != xSemaphoreTake(mutex, (TickType_t)100)) return;
+    while (0 < numEntries && (long)(heap[0].due - t) <= 0)
+        due[numDue++] = pop();
+    xSemaphoreGive(mutex);
+    // run them by priority
+    for (uint8_t i = 1; i < numDue; i++)
+        for (uint8_t j = i; 0 < j && due[j - 1].task->_taskPriority < due[j].task->_taskPriority; j--) {
+            Entry tmp = due[j];
+            due[j] = due[j - 1];
+            due[j - 1] = tmp;
+        }
+    for (uint8_t i = 0; i < numDue; i++) run(&due[i]);
+    // sleep until the next deadline or until a task is added
+    ulong wait = ATOLL_TASK_EXECUTOR_IDLE_WAIT;
+    if (pdTRUE == xSemaphoreTake(mutex, (TickType_t)100)) {
+        if (0 < numEntries) {
+            long next = (long)(heap[0].due - millis());
+            wait = next < 0 ? 0 : (ulong)next;
+        }
+        xSemaphoreGive(mutex);
+    }
+    if (0 < wait) xSemaphoreTake(wakeup, pdMS_TO_TICKS(wait));
+}
+
+void TaskExecutor::run(Entry *entry) {
+    Task *task = entry->task;
+    if (pdTRUE != xSemaphoreTake(mutex, portMAX_DELAY)) return;
+    bool skip = !task->_taskScheduled;  // removed while waiting to run
+    for (uint8_t i = 0; i < numEntries && !skip; i++)
+        if (heap[i].task == task) skip = true;  // removed and added again
+    if (skip) {
+        xSemaphoreGive(mutex);
+        return;
+    }
+    running = task;
+    xSemaphoreGive(mutex);
+
+    if (entry->notified) task->taskStats.notified++;
+    entry->notified = false;
+    int64_t start = esp_timer_get_time();
+    task->loop();
+    uint32_t loopTime = (uint32_t)(esp_timer_get_time() - start);
+    task->_taskRecordLoop(loopTime);
+    task->_taskLoopCount++;
+
+    if (ATOLL_TASK_EXECUTOR_BUDGET * 1000 < loopTime)
+        entry->overruns++;
+    else
+        entry->overruns = 0;
+    ulong t = millis();
+    ulong period = task->taskDelayMs();
+    entry->due += period;
+    if ((long)(entry->due - t) < 0) entry->due = t + period;  // missed, don't catch up
+
+    bool isolate = false;
+    xSemaphoreTake(mutex, portMAX_DELAY);
+    running = nullptr;
+    if (task->_taskNotified) {  // woken while running
+        task->_taskNotified = false;
+        entry->due = t;
+        entry->notified = true;
+    }
+    if (task->_taskScheduled) {
+        if (ATOLL_TASK_EXECUTOR_MAX_OVERRUNS <= entry->overruns) {
+            task->_taskScheduled = false;
+            task->_taskExecutor = nullptr;
+            task->_taskAutoShare = false;
+            isolate = true;
+        } else
+            push(*entry);
+    }
+    xSemaphoreGive(mutex);
+    if (isolate) {
+        log_w("%s took %dus, moving it to its own thread", task->taskName(), loopTime);
+        _taskUnregister(task);
+        task->taskStart();
+    }
+}
+
+bool TaskExecutor::add(Task *task) {
+    if (pdTRUE != xSemaphoreTake(mutex, (TickType_t)100)) {
+        log_e("could not get mutex");
+        return false;
+    }
+    bool added = false;
+    if (!task->_taskScheduled && numEntries < ATOLL_TASK_EXECUTOR_MAX_TASKS) {
+        Entry entry;
+        entry.task = task;
+        entry.due = millis();
+        // a task restarted from its own loop is pushed back by run()
+        if (running != task) push(entry);
+        task->_taskScheduled = true;
+        task->_taskExecutor = this;
+        added = true;
+    }
+    xSemaphoreGive(mutex);
+    if (!added) {
+        log_e("could not add %s", task->taskName());
+        return false;
+    }
+    xSemaphoreGive(wakeup);
+    return true;
+}
+
+bool TaskExecutor::remove(Task *task) {
+    if (pdTRUE != xSemaphoreTake(mutex, portMAX_DELAY)) return false;
+    bool removed = task->_taskScheduled;
+    task->_taskScheduled = false;
+    for (uint8_t i = 0; i < numEntries; i++) {
+        if (heap[i].task != task) continue;
+        heap[i] = heap[--numEntries];
+        if (i < numEntries) {
+            siftUp(i);
+            siftDown(i);
+        }
+        break;
+    }
+    xSemaphoreGive(mutex);
+    return removed;
+}
+
+void TaskExecutor::wake(Task *task, bool notified) {
+    if (pdTRUE != xSemaphoreTake(mutex, (TickType_t)100)) return;
+    ulong t = millis();
+    bool found = false;
+    for (uint8_t i = 0; i < numEntries; i++) {
+        if (heap[i].task != task) continue;
+        if ((long)(heap[i].due - t) > 0) {
+            heap[i].due = t;
+            if (notified) heap[i].notified = true;
+            siftUp(i);
+        }
+        found = true;
+        break;
+    }
+    if (!found && running == task && notified) task->_taskNotified = true;
+    xSemaphoreGive(mutex);
+    xSemaphoreGive(wakeup);
+}
+
+bool TaskExecutor::before(const Entry &a, const Entry &b) {
+    return (long)(a.due - b.due) < 0;
+}
+
+// call with the mutex held
+void TaskExecutor::push(const Entry &entry) {
+    heap[numEntries] = entry;
+    siftUp(numEntries++);
+}
+
+// call with the mutex held and a non-empty heap
+TaskExecutor::Entry TaskExecutor::pop() {
+    Entry top = heap[0];
+    heap[0] = heap[--numEntries];
+    if (0 < numEntries) siftDown(0);
+    return top;
+}
+
+void TaskExecutor::siftUp(uint8_t index) {
+    while (0 < index) {
+        uint8_t parent = (index - 1) / 2;
+        if (!before(heap[index], heap[parent])) return;
+        Entry tmp = heap[index];
+        heap[index] = heap[parent];
+        heap[parent] = tmp;
+        index = parent;
+    }
+}
+
+void TaskExecutor::siftDown(uint8_t index) {
+    for (;;) {
+        uint8_t smallest = index;
+        uint8_t left = 2 * index + 1;
+        uint8_t right = left + 1;
+        if (left < numEntries && before(heap[left], heap[smallest])) smallest = left;
+        if (right < numEntries && before(heap[right], heap[smallest])) smallest = right;
+        if (smallest == index) return;
+        Entry tmp = heap[index];
+        heap[index] = heap[smallest];
+        heap[smallest] = tmp;
+        index = smallest;
+    }
+}
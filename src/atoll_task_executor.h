@@ -0,0 +1,88 @@
+#ifndef __atoll_task_executor_h
+#define __atoll_task_executor_h
+
+#include <Arduino.h>
+
+#include "atoll_task.h"
+
+#ifndef ATOLL_TASK_EXECUTOR_MAX_TASKS
+#define ATOLL_TASK_EXECUTOR_MAX_TASKS 16  // max number of tasks sharing one executor
+#endif
+#ifndef ATOLL_TASK_EXECUTOR_STACK
+#define ATOLL_TASK_EXECUTOR_STACK 6144  // must fit the largest stack needed by the shared tasks
+#endif
+#ifndef ATOLL_TASK_EXECUTOR_PRIORITY
+#define ATOLL_TASK_EXECUTOR_PRIORITY 1
+#endif
+#ifndef ATOLL_TASK_EXECUTOR_IDLE_WAIT
+#define ATOLL_TASK_EXECUTOR_IDLE_WAIT 1000  // ms to sleep when no task is scheduled
+#endif
+#ifndef ATOLL_TASK_EXECUTOR_BUDGET
+#define ATOLL_TASK_EXECUTOR_BUDGET 20  // ms a shared loop may take before it counts as an overrun
+#endif
+#ifndef ATOLL_TASK_EXECUTOR_MAX_OVERRUNS
+#define ATOLL_TASK_EXECUTOR_MAX_OVERRUNS 3  // consecutive overruns after which a task is moved to its own thread
+#endif
+
+namespace Atoll {
+
+// Runs the loop() of many low frequency tasks on one thread.
+// Scheduled tasks are kept in a min-heap ordered by their next deadline, the
+// tasks that are due are run in the order of their priority. A task that
+// misses its deadline is rescheduled one period after it finished, without
+// catching up. A task that repeatedly takes longer than
+// ATOLL_TASK_EXECUTOR_BUDGET is moved to a dedicated thread so it cannot
+// delay the others.
+// Use Task::taskSetShared() before taskStart(), or define
+// ATOLL_TASK_SHARE_MAX_FREQ to share all tasks up to that frequency with the
+// first started executor. Tasks making blocking BLE calls and the Api worker,
+// which is identified by its task handle, opt out of sharing with
+// taskSetShared(nullptr).
+class TaskExecutor : public Task {
+   public:
+    const char *taskName() override { return "Executor"; }
+
+    TaskExecutor();
+    ~TaskExecutor();
+    void loop() override;
+    void taskStart(float freq = -1,
+                   uint32_t stack = 0,
+                   int8_t priority = -1,
+                   int8_t core = -1) override;
+
+    bool add(Task *task);
+    bool remove(Task *task);
+    // makes the task due now, called by Task::taskNotify() and the governor
+    void wake(Task *task, bool notified = true);
+    uint8_t size() { return numEntries; }
+
+    // the executor used by Task::taskStart() for ATOLL_TASK_SHARE_MAX_FREQ
+    static TaskExecutor *defaultExecutor;
+
+   protected:
+    struct Entry {
+        Task *task = nullptr;
+        ulong due = 0;         // millis() of the next run
+        uint8_t overruns = 0;  // consecutive loops over the budget
+        bool notified = false;  // woken by wake()
+    };
+
+    Entry heap[ATOLL_TASK_EXECUTOR_MAX_TASKS];
+    uint8_t numEntries = 0;
+    Task *running = nullptr;  // the task being run, not in the heap
+    SemaphoreHandle_t mutex = xSemaphoreCreateMutex();
+    // wakes the loop, the task notification is left to the shared tasks,
+    // e.g. for blocking calls that wait on it
+    SemaphoreHandle_t wakeup = xSemaphoreCreateBinary();
+
+    static bool before(const Entry &a, const Entry &b);
+    void push(const Entry &entry);
+    Entry pop();
+    void siftUp(uint8_t index);
+    void siftDown(uint8_t index);
+    void run(Entry *entry);
+};
+
+}  // namespace Atoll
+
+#endif
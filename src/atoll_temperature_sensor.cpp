@@ -1,6 +1,9 @@
 #ifdef FEATURE_TEMPERATURE
 #include "atoll_temperature_sensor.h"
 #include "atoll_log.h"
+#ifdef FEATURE_API
+#include "atoll_api.h"
+#endif
 
 using namespace Atoll;
 
@@ -27,6 +30,14 @@ void TemperatureSensor::setup(::Preferences *p) {
             printSettings();
         }
     }
+#ifdef FEATURE_API
+    Api::addChannel(Api::Channel(label, [this](char *buf, size_t size, float *value) {
+        if (0 == lastUpdate) return false;
+        snprintf(buf, size, "%.2f", this->value);
+        *value = this->value;
+        return true;
+    }));
+#endif
 }
 
 void TemperatureSensor::begin() {
@@ -35,8 +46,10 @@ void TemperatureSensor::begin() {
 
 void TemperatureSensor::loop() {
     float prevValue = value;
-    if (update()) lastUpdate = millis();
+    bool updated = update();
+    if (updated) lastUpdate = millis();
     value += offset;
+    if (updated) EventBus::publish(EventBus::TEMPERATURE, value, this);
     if (prevValue == value) return;
 #ifdef FEATURE_BLE_SERVER
     if (bleChar) {
@@ -2,6 +2,7 @@
 #define __atoll_temperature_sensor_h
 
 #include "atoll_preferences.h"
+#include "atoll_event_bus.h"
 
 #ifdef FEATURE_BLE_SERVER
 #include "atoll_ble_server.h"
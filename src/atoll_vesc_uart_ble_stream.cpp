@@ -31,7 +31,6 @@ size_t VescUartBleStream::write(const uint8_t* buffer, size_t size) {
         log_e("vesc is null");
         return 0;
     }
-    PeerCharacteristicVescRX* vescRX = (PeerCharacteristicVescRX*)vesc->getChar("VescRX");
     if (nullptr == vescRX) {
         log_e("VescRX char not found");
         return 0;
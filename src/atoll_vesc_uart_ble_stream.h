@@ -21,6 +21,7 @@ class VescUartBleStream : public Stream {
     virtual size_t write(const uint8_t* buffer, size_t size) override;
 
     Vesc* vesc = nullptr;
+    PeerCharacteristicVescRX* vescRX = nullptr;  // set by the Vesc, written on each write()
 
     CircularBuffer<uint8_t, 512> rxBuf;
 };
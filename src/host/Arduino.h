@@ -0,0 +1,49 @@
+#ifndef __atoll_host_arduino_h
+#define __atoll_host_arduino_h
+
+// Arduino core shim for the host build, see atoll_host.h
+
+#ifdef ATOLL_HOST
+
+#include <functional>
+#include <atomic>
+
+#include "atoll_host.h"
+#include "WString.h"
+
+#define ARDUHAL_LOG_LEVEL_NONE 0
+#define ARDUHAL_LOG_LEVEL_ERROR 1
+#define ARDUHAL_LOG_LEVEL_WARN 2
+#define ARDUHAL_LOG_LEVEL_INFO 3
+#define ARDUHAL_LOG_LEVEL_DEBUG 4
+#define ARDUHAL_LOG_LEVEL_VERBOSE 5
+
+#define ARDUHAL_LOG_FORMAT(letter, format) "[%6u][" #letter "][%s:%u] %s(): " format "\r\n", \
+                                           (unsigned long)(esp_timer_get_time() / 1000ULL),  \
+                                           pathToFileName(__FILE__), __LINE__, __FUNCTION__
+
+class Print {
+   public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size) {
+        size_t n = 0;
+        while (n < size && write(buffer[n])) n++;
+        return n;
+    }
+    size_t write(const char *str) {
+        return nullptr == str ? 0 : write((const uint8_t *)str, strlen(str));
+    }
+    virtual void flush() {}
+};
+
+class Stream : public Print {
+   public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+#endif
+
+#endif
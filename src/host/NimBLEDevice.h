@@ -0,0 +1,522 @@
+#ifndef __atoll_host_nimble_device_h
+#define __atoll_host_nimble_device_h
+
+// NimBLE-Arduino shim for the host build: the client side used by BleClient,
+// Peer and the peer characteristics, without a radio.
+// Remote devices are simulated in memory: the test adds the services and
+// chars of a client with the host only addService() and addCharacteristic(),
+// delivers notifications to the subscribed chars with notify() and records
+// the written values. connect() succeeds immediately and calls onConnect(),
+// scanning finds nothing.
+
+#ifdef ATOLL_HOST
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <string>
+#include <vector>
+
+#define BLE_HS_CONN_HANDLE_NONE 0xffff
+#define BLE_HS_EUNKNOWN 1
+#define BLE_ATT_ATTR_MAX_LEN 512
+#define BLE_ADDR_PUBLIC 0
+#define BLE_ADDR_RANDOM 1
+#define BLE_HS_IO_DISPLAY_ONLY 0
+#define BLE_HS_IO_KEYBOARD_ONLY 2
+#define BLE_HS_IO_NO_INPUT_OUTPUT 3
+#define BLE_HCI_SCAN_FILT_NO_WL 0
+#define CONFIG_BTDM_SCAN_DUPL_TYPE_DEVICE 0
+#ifndef NIMBLE_MAX_CONNECTIONS
+#define NIMBLE_MAX_CONNECTIONS 3
+#endif
+
+struct ble_gap_upd_params {
+    uint16_t itvl_min, itvl_max, latency, supervision_timeout, min_ce_len, max_ce_len;
+};
+
+struct NIMBLE_PROPERTY {
+    enum : uint32_t {
+        READ = 1 << 1,
+        WRITE_NR = 1 << 2,
+        WRITE = 1 << 3,
+        NOTIFY = 1 << 4,
+        INDICATE = 1 << 5,
+        BROADCAST = 1 << 0,
+        READ_ENC = 1 << 9,
+        READ_AUTHEN = 1 << 10,
+        READ_AUTHOR = 1 << 11,
+        WRITE_ENC = 1 << 12,
+        WRITE_AUTHEN = 1 << 13,
+        WRITE_AUTHOR = 1 << 14,
+    };
+};
+
+// UUIDs are kept in their 128 bit string form, 16 bit UUIDs are expanded
+// with the Bluetooth base UUID so both forms compare equal
+class NimBLEUUID {
+   public:
+    NimBLEUUID() {}
+    NimBLEUUID(uint16_t uuid) : short16(uuid) {
+        char buf[37];
+        snprintf(buf, sizeof(buf), "0000%04x-0000-1000-8000-00805f9b34fb", uuid);
+        value = buf;
+    }
+    NimBLEUUID(const std::string &uuid) : NimBLEUUID(uuid.c_str()) {}
+    NimBLEUUID(const char *uuid) {
+        if (nullptr == uuid) return;
+        size_t len = strlen(uuid);
+        if (len <= 6) {
+            *this = NimBLEUUID((uint16_t)strtoul(uuid, nullptr, 16));
+            return;
+        }
+        value = uuid;
+        std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+    }
+
+    bool equals(const NimBLEUUID &uuid) const { return value == uuid.value; }
+    bool operator==(const NimBLEUUID &uuid) const { return equals(uuid); }
+    bool operator!=(const NimBLEUUID &uuid) const { return !equals(uuid); }
+    uint8_t bitSize() const { return value.empty() ? 0 : 0 < short16 ? 16 : 128; }
+    // 16 bit UUIDs are printed as 0x180d, as by NimBLE
+    std::string toString() const {
+        if (16 != bitSize()) return value;
+        char buf[7];
+        snprintf(buf, sizeof(buf), "0x%04x", short16);
+        return buf;
+    }
+    operator std::string() const { return toString(); }
+
+   protected:
+    std::string value;
+    uint16_t short16 = 0;
+};
+
+class NimBLEAddress {
+   public:
+    NimBLEAddress() {}
+    NimBLEAddress(const std::string &address, uint8_t type = BLE_ADDR_PUBLIC) : type(type) {
+        unsigned int b[6];
+        if (6 == sscanf(address.c_str(), "%x:%x:%x:%x:%x:%x", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5]))
+            for (int i = 0; i < 6; i++) value = value << 8 | (b[i] & 0xff);
+    }
+
+    bool equals(const NimBLEAddress &address) const { return value == address.value; }
+    bool operator==(const NimBLEAddress &address) const { return equals(address); }
+    bool operator!=(const NimBLEAddress &address) const { return !equals(address); }
+    std::string toString() const {
+        char buf[18];
+        snprintf(buf, sizeof(buf), "%02x:%02x:%02x:%02x:%02x:%02x",
+                 (uint8_t)(value >> 40), (uint8_t)(value >> 32), (uint8_t)(value >> 24),
+                 (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value);
+        return buf;
+    }
+    operator std::string() const { return toString(); }
+    uint8_t getType() const { return type; }
+    uint64_t toUint64() const { return value; }
+    operator uint64_t() const { return value; }
+    bool isNull() const { return 0 == value; }
+
+   protected:
+    uint64_t value = 0;
+    uint8_t type = BLE_ADDR_PUBLIC;
+};
+
+class NimBLEAttValue {
+   public:
+    NimBLEAttValue() {}
+    NimBLEAttValue(const uint8_t *data, uint16_t length) : value(data, data + length) {}
+    NimBLEAttValue(const char *str) : NimBLEAttValue((const uint8_t *)str, strlen(str)) {}
+    NimBLEAttValue(const std::string &str) : NimBLEAttValue((const uint8_t *)str.data(), str.length()) {}
+
+    const uint8_t *data() const { return terminated().data(); }
+    uint16_t length() const { return value.size(); }
+    uint16_t size() const { return value.size(); }
+    const char *c_str() const { return (const char *)terminated().data(); }
+    operator std::string() const { return std::string((const char *)data(), length()); }
+    const uint8_t &operator[](int index) const { return value[index]; }
+    template <typename T>
+    T getValue(time_t *timestamp = nullptr, bool skipSizeCheck = false) const {
+        T result = T();
+        if (sizeof(T) <= value.size()) memcpy(&result, value.data(), sizeof(T));
+        return result;
+    }
+
+   protected:
+    std::vector<uint8_t> value;
+    mutable std::vector<uint8_t> buffer;  // the value with a terminating zero
+
+    const std::vector<uint8_t> &terminated() const {
+        buffer = value;
+        buffer.push_back(0);
+        return buffer;
+    }
+};
+
+template <>
+inline String NimBLEAttValue::getValue<String>(time_t *, bool) const {
+    return String((const char *)value.data(), value.size());
+}
+
+class NimBLEConnInfo {
+   public:
+    NimBLEAddress address;
+    uint16_t mtu = 23;
+
+    NimBLEAddress getAddress() const { return address; }
+    NimBLEAddress getIdAddress() const { return address; }
+    uint16_t getConnHandle() const { return 0; }
+    uint16_t getMTU() const { return mtu; }
+    bool isBonded() const { return false; }
+    uint16_t getConnInterval() const { return 24; }
+    uint16_t getConnLatency() const { return 0; }
+    uint16_t getConnTimeout() const { return 400; }
+    bool isMaster() const { return true; }
+    bool isSlave() const { return false; }
+    uint8_t getSecKeySize() const { return 0; }
+    bool isEncrypted() const { return false; }
+    bool isAuthenticated() const { return false; }
+};
+
+class NimBLEClient;
+class NimBLERemoteService;
+class NimBLECharacteristic;  // the server side is not simulated
+
+class NimBLERemoteCharacteristic {
+   public:
+    typedef std::function<void(NimBLERemoteCharacteristic *c, uint8_t *data, size_t length, bool isNotify)> notify_callback;
+
+    NimBLERemoteCharacteristic(NimBLERemoteService *service, const NimBLEUUID &uuid, uint32_t properties, uint16_t handle)
+        : service(service), uuid(uuid), properties(properties), handle(handle) {}
+
+    NimBLEUUID getUUID() const { return uuid; }
+    uint16_t getHandle() const { return handle; }
+    NimBLERemoteService *getRemoteService() const { return service; }
+    NimBLEClient *getClient() const;
+    std::string toString() const { return uuid.toString(); }
+
+    bool canRead() const { return properties & NIMBLE_PROPERTY::READ; }
+    bool canWrite() const { return properties & NIMBLE_PROPERTY::WRITE; }
+    bool canWriteNoResponse() const { return properties & NIMBLE_PROPERTY::WRITE_NR; }
+    bool canNotify() const { return properties & NIMBLE_PROPERTY::NOTIFY; }
+    bool canIndicate() const { return properties & NIMBLE_PROPERTY::INDICATE; }
+
+    NimBLEAttValue readValue(time_t *timestamp = nullptr) { return value; }
+    NimBLEAttValue getValue(time_t *timestamp = nullptr) { return value; }
+    bool writeValue(const uint8_t *data, size_t length, bool response = false) {
+        value = NimBLEAttValue(data, length);
+        writes++;
+        return true;
+    }
+    bool writeValue(const std::string &str, bool response = false) {
+        return writeValue((const uint8_t *)str.data(), str.length(), response);
+    }
+    bool writeValue(const char *str, bool response = false) {
+        return writeValue((const uint8_t *)str, strlen(str), response);
+    }
+    // values with c_str() and length() are written as strings, others as their bytes
+    template <typename T>
+    bool writeValue(const T &v, bool response = false) {
+        if constexpr (std::is_same<T, String>::value)
+            return writeValue((const uint8_t *)v.c_str(), v.length(), response);
+        else
+            return writeValue((const uint8_t *)&v, sizeof(T), response);
+    }
+
+    bool subscribe(bool notifications = true, const notify_callback notifyCallback = nullptr, bool response = true) {
+        if (!canNotify() && !canIndicate()) return false;
+        callback = notifyCallback;
+        return true;
+    }
+    bool unsubscribe(bool response = true) {
+        callback = nullptr;
+        return true;
+    }
+
+    // host only: the remote device sets the value of the char
+    void setValue(const uint8_t *data, size_t length) { value = NimBLEAttValue(data, length); }
+    // host only: the remote device notifies, returns false if not subscribed
+    bool notify(const uint8_t *data, size_t length, bool isNotify = true) {
+        if (nullptr == callback) return false;
+        setValue(data, length);
+        callback(this, (uint8_t *)data, length, isNotify);
+        return true;
+    }
+    bool subscribed() const { return nullptr != callback; }
+    uint32_t writes = 0;  // host only: number of writes by the client
+
+   protected:
+    NimBLERemoteService *service;
+    NimBLEUUID uuid;
+    uint32_t properties;
+    uint16_t handle;
+    NimBLEAttValue value;
+    notify_callback callback = nullptr;
+};
+
+class NimBLERemoteService {
+   public:
+    NimBLERemoteService(NimBLEClient *client, const NimBLEUUID &uuid) : client(client), uuid(uuid) {}
+    ~NimBLERemoteService() {
+        for (auto c : chars) delete c;
+    }
+
+    NimBLEUUID getUUID() const { return uuid; }
+    NimBLEClient *getClient() const { return client; }
+    std::string toString() const { return uuid.toString(); }
+    NimBLERemoteCharacteristic *getCharacteristic(const char *uuid) { return getCharacteristic(NimBLEUUID(uuid)); }
+    NimBLERemoteCharacteristic *getCharacteristic(const NimBLEUUID &uuid) {
+        for (auto c : chars)
+            if (c->getUUID() == uuid) return c;
+        return nullptr;
+    }
+    const std::vector<NimBLERemoteCharacteristic *> &getCharacteristics(bool refresh = false) { return chars; }
+
+    // host only: adds a char to the simulated remote service
+    NimBLERemoteCharacteristic *addCharacteristic(const NimBLEUUID &uuid, uint32_t properties) {
+        static uint16_t nextHandle = 1;
+        chars.push_back(new NimBLERemoteCharacteristic(this, uuid, properties, nextHandle++));
+        return chars.back();
+    }
+
+   protected:
+    NimBLEClient *client;
+    NimBLEUUID uuid;
+    std::vector<NimBLERemoteCharacteristic *> chars;
+};
+
+inline NimBLEClient *NimBLERemoteCharacteristic::getClient() const {
+    return service->getClient();
+}
+
+class NimBLEClientCallbacks {
+   public:
+    virtual ~NimBLEClientCallbacks() {}
+    virtual void onConnect(NimBLEClient *client) {}
+    virtual void onConnectFail(NimBLEClient *client, int reason) {}
+    virtual void onDisconnect(NimBLEClient *client, int reason) {}
+    virtual bool onConnParamsUpdateRequest(NimBLEClient *client, const ble_gap_upd_params *params) { return true; }
+    virtual uint32_t onPassKeyRequest() { return 123456; }
+    virtual bool onConfirmPIN(uint32_t pin) { return true; }
+    virtual void onPassKeyEntry(NimBLEConnInfo &connInfo) {}
+    virtual void onAuthenticationComplete(NimBLEConnInfo &connInfo) {}
+    virtual void onConfirmPasskey(NimBLEConnInfo &connInfo, uint32_t pin) {}
+    virtual void onMTUChange(NimBLEClient *client, uint16_t mtu) {}
+};
+
+class NimBLEClient {
+   public:
+    NimBLEClient(const NimBLEAddress &address) : address(address) {}
+    ~NimBLEClient() { deleteServices(); }
+
+    bool connect(const NimBLEAddress &address, bool deleteAttributes = true, bool asyncConnect = false, bool exchangeMTU = true) {
+        this->address = address;
+        return connect(deleteAttributes, asyncConnect, exchangeMTU);
+    }
+    bool connect(bool deleteAttributes = true, bool asyncConnect = false, bool exchangeMTU = true) {
+        if (connected) return false;
+        connected = true;
+        if (nullptr != callbacks) callbacks->onConnect(this);
+        return true;
+    }
+    bool disconnect(uint8_t reason = 0x13) {
+        if (!connected) return false;
+        connected = false;
+        if (nullptr != callbacks) callbacks->onDisconnect(this, reason);
+        return true;
+    }
+    bool cancelConnect() { return true; }
+    bool isConnected() { return connected; }
+    bool discoverAttributes() {
+        // one request per attribute
+        size_t attributes = services.size();
+        for (auto s : services) attributes += s->getCharacteristics().size();
+        if (0 < discoveryRoundTrip) delay(discoveryRoundTrip * attributes);
+        return true;
+    }
+    void deleteServices() {
+        for (auto s : services) delete s;
+        services.clear();
+    }
+    NimBLERemoteService *getService(const char *uuid) { return getService(NimBLEUUID(uuid)); }
+    NimBLERemoteService *getService(const NimBLEUUID &uuid) {
+        for (auto s : services)
+            if (s->getUUID() == uuid) return s;
+        return nullptr;
+    }
+    const std::vector<NimBLERemoteService *> &getServices(bool refresh = false) { return services; }
+    NimBLEAddress getPeerAddress() const { return address; }
+    bool setPeerAddress(const NimBLEAddress &address) {
+        this->address = address;
+        return true;
+    }
+    int getRssi() { return -50; }
+    void setClientCallbacks(NimBLEClientCallbacks *callbacks, bool deleteCallbacks = true) { this->callbacks = callbacks; }
+    uint16_t getConnHandle() const { return connected ? 0 : BLE_HS_CONN_HANDLE_NONE; }
+    void setConnectTimeout(uint32_t timeout) {}
+    void setConnectionParams(uint16_t minInterval, uint16_t maxInterval, uint16_t latency, uint16_t timeout,
+                             uint16_t scanInterval = 16, uint16_t scanWindow = 16) {}
+    void updateConnParams(uint16_t minInterval, uint16_t maxInterval, uint16_t latency, uint16_t timeout) {}
+    uint16_t getMTU() const { return mtu; }
+    NimBLEConnInfo getConnInfo() {
+        NimBLEConnInfo info;
+        info.address = address;
+        info.mtu = mtu;
+        return info;
+    }
+
+    // host only: adds a service to the simulated remote device
+    NimBLERemoteService *addService(const NimBLEUUID &uuid) {
+        services.push_back(new NimBLERemoteService(this, uuid));
+        return services.back();
+    }
+    uint16_t mtu = 23;  // host only
+    uint32_t discoveryRoundTrip = 0;  // host only: ms per attribute discovered
+
+   protected:
+    NimBLEAddress address;
+    bool connected = false;
+    NimBLEClientCallbacks *callbacks = nullptr;
+    std::vector<NimBLERemoteService *> services;
+};
+
+class NimBLEAdvertisedDevice {
+   public:
+    NimBLEAddress address;
+    std::string name;
+    int rssi = 0;
+    std::vector<NimBLEUUID> serviceUuids;
+
+    NimBLEAddress getAddress() const { return address; }
+    std::string getName() const { return name; }
+    int getRSSI() const { return rssi; }
+    bool haveName() const { return !name.empty(); }
+    bool haveServiceUUID() const { return !serviceUuids.empty(); }
+    bool isAdvertisingService(const NimBLEUUID &uuid) const {
+        return serviceUuids.end() != std::find(serviceUuids.begin(), serviceUuids.end(), uuid);
+    }
+    std::string toString() const { return "Name: " + name + ", Address: " + address.toString(); }
+};
+
+class NimBLEScanResults {
+   public:
+    int getCount() const { return 0; }
+};
+
+class NimBLEScanCallbacks {
+   public:
+    virtual ~NimBLEScanCallbacks() {}
+    virtual void onDiscovered(NimBLEAdvertisedDevice *advertisedDevice) {}
+    virtual void onResult(NimBLEAdvertisedDevice *advertisedDevice) {}
+    virtual void onScanEnd(NimBLEScanResults results) {}
+};
+
+class NimBLEScan {
+   public:
+    bool start(uint32_t duration, bool isContinue = false, bool restart = true) {
+        scanning = true;
+        return true;
+    }
+    bool stop() {
+        scanning = false;
+        return true;
+    }
+    bool isScanning() { return scanning; }
+    void setScanCallbacks(NimBLEScanCallbacks *callbacks, bool wantDuplicates = false) { this->callbacks = callbacks; }
+    void setActiveScan(bool active) {}
+    void setInterval(uint16_t interval) {}
+    void setWindow(uint16_t window) {}
+    void setDuplicateFilter(uint8_t filter) {}
+    void setLimitedOnly(bool limited) {}
+    void setFilterPolicy(uint8_t policy) {}
+    void setMaxResults(uint8_t max) {}
+    void clearResults() {}
+    void clearDuplicateCache() {}
+
+    // host only: reports an advertisement to the scan callbacks
+    void advertise(NimBLEAdvertisedDevice *device) {
+        if (scanning && nullptr != callbacks) callbacks->onResult(device);
+    }
+
+   protected:
+    bool scanning = false;
+    NimBLEScanCallbacks *callbacks = nullptr;
+};
+
+class NimBLEDevice {
+   public:
+    static bool init(const std::string &deviceName) { return initialized = true; }
+    static bool deinit(bool clearAll = false) {
+        if (clearAll)
+            while (!clients.empty()) deleteClient(clients.front());
+        initialized = false;
+        return true;
+    }
+    static bool getInitialized() { return initialized; }
+    static bool isInitialized() { return initialized; }
+
+    static NimBLEScan *getScan() {
+        static NimBLEScan scan;
+        return &scan;
+    }
+    static NimBLEClient *createClient(const NimBLEAddress &address = NimBLEAddress()) {
+        if (NIMBLE_MAX_CONNECTIONS <= clients.size()) return nullptr;
+        clients.push_back(new NimBLEClient(address));
+        return clients.back();
+    }
+    static bool deleteClient(NimBLEClient *client) {
+        auto it = std::find(clients.begin(), clients.end(), client);
+        if (clients.end() == it) return false;
+        clients.erase(it);
+        delete client;
+        return true;
+    }
+    static NimBLEClient *getClientByPeerAddress(const NimBLEAddress &address) {
+        for (auto c : clients)
+            if (c->getPeerAddress() == address) return c;
+        return nullptr;
+    }
+    static NimBLEClient *getDisconnectedClient() {
+        for (auto c : clients)
+            if (!c->isConnected()) return c;
+        return nullptr;
+    }
+    static size_t getClientListSize() { return clients.size(); }
+    static std::list<NimBLEClient *> *getClientList() { return &clients; }
+
+    static int setMTU(uint16_t mtu) {
+        NimBLEDevice::mtu = mtu;
+        return 0;
+    }
+    static uint16_t getMTU() { return mtu; }
+    static void setSecurityIOCap(uint8_t ioCap) {}
+    static bool deleteAllBonds() { return true; }
+    static bool deleteBond(const NimBLEAddress &address) { return true; }
+    static void setScanDuplicateCacheSize(uint16_t size) {}
+    static void setScanFilterMode(uint8_t mode) {}
+
+   protected:
+    static inline bool initialized = false;
+    static inline uint16_t mtu = 23;
+    static inline std::list<NimBLEClient *> clients;
+};
+
+typedef NimBLEUUID BLEUUID;
+typedef NimBLEAddress BLEAddress;
+typedef NimBLEAttValue BLEAttValue;
+typedef NimBLEConnInfo BLEConnInfo;
+typedef NimBLECharacteristic BLECharacteristic;
+typedef NimBLEClient BLEClient;
+typedef NimBLEClientCallbacks BLEClientCallbacks;
+typedef NimBLERemoteService BLERemoteService;
+typedef NimBLERemoteCharacteristic BLERemoteCharacteristic;
+typedef NimBLEAdvertisedDevice BLEAdvertisedDevice;
+typedef NimBLEScanResults BLEScanResults;
+typedef NimBLEScan BLEScan;
+typedef NimBLEDevice BLEDevice;
+
+#endif
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef __atoll_host_preferences_h
+#define __atoll_host_preferences_h
+
+// Preferences shim for the host build: the namespaces are kept in memory for
+// the lifetime of the process
+
+#ifdef ATOLL_HOST
+
+#include <Arduino.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+
+class Preferences {
+   public:
+    bool begin(const char *name, bool readOnly = false) {
+        if (nullptr == name || 0 == strlen(name) || 15 < strlen(name)) return false;
+        ns = name;
+        this->readOnly = readOnly;
+        return true;
+    }
+    void end() { ns.clear(); }
+
+    bool getBool(const char *key, bool defaultValue = false) { return get<uint8_t>(key, defaultValue); }
+    size_t putBool(const char *key, bool value) { return put<uint8_t>(key, value); }
+    uint8_t getUChar(const char *key, uint8_t defaultValue = 0) { return get(key, defaultValue); }
+    size_t putUChar(const char *key, uint8_t value) { return put(key, value); }
+    int32_t getInt(const char *key, int32_t defaultValue = 0) { return get(key, defaultValue); }
+    size_t putInt(const char *key, int32_t value) { return put(key, value); }
+    uint32_t getUInt(const char *key, uint32_t defaultValue = 0) { return get(key, defaultValue); }
+    size_t putUInt(const char *key, uint32_t value) { return put(key, value); }
+    float getFloat(const char *key, float defaultValue = 0) { return get(key, defaultValue); }
+    size_t putFloat(const char *key, float value) { return put(key, value); }
+
+    String getString(const char *key, String defaultValue = String()) {
+        std::string value;
+        return read(key, &value) ? String(value) : defaultValue;
+    }
+    size_t getString(const char *key, char *buf, size_t size) {
+        std::string value;
+        if (!read(key, &value) || size < value.length() + 1) return 0;
+        memcpy(buf, value.c_str(), value.length() + 1);
+        return value.length() + 1;
+    }
+    size_t putString(const char *key, const char *value) {
+        return write(key, std::string(value)) ? strlen(value) : 0;
+    }
+    size_t putString(const char *key, String value) { return putString(key, value.c_str()); }
+    size_t getBytesLength(const char *key) {
+        std::string value;
+        return read(key, &value) ? value.size() : 0;
+    }
+    size_t getBytes(const char *key, void *buf, size_t maxLen) {
+        std::string value;
+        if (!read(key, &value) || maxLen < value.size()) return 0;
+        memcpy(buf, value.data(), value.size());
+        return value.size();
+    }
+    size_t putBytes(const char *key, const void *value, size_t len) {
+        return write(key, std::string((const char *)value, len)) ? len : 0;
+    }
+
+    bool isKey(const char *key) {
+        std::string value;
+        return read(key, &value);
+    }
+    bool remove(const char *key) {
+        if (ns.empty() || readOnly) return false;
+        std::lock_guard<std::mutex> l(lock());
+        return 0 < store().erase(ns + "/" + key);
+    }
+    // host only: removes every namespace
+    static void clearAll() {
+        std::lock_guard<std::mutex> l(lock());
+        store().clear();
+    }
+
+   protected:
+    std::string ns;
+    bool readOnly = false;
+
+    static std::map<std::string, std::string> &store() {
+        static std::map<std::string, std::string> s;
+        return s;
+    }
+    static std::mutex &lock() {
+        static std::mutex m;
+        return m;
+    }
+
+    bool read(const char *key, std::string *value) {
+        if (ns.empty() || nullptr == key) return false;
+        std::lock_guard<std::mutex> l(lock());
+        auto it = store().find(ns + "/" + key);
+        if (store().end() == it) return false;
+        *value = it->second;
+        return true;
+    }
+    bool write(const char *key, const std::string &value) {
+        if (ns.empty() || readOnly || nullptr == key) return false;
+        std::lock_guard<std::mutex> l(lock());
+        store()[ns + "/" + key] = value;
+        return true;
+    }
+
+    template <typename T>
+    T get(const char *key, T defaultValue) {
+        std::string value;
+        if (!read(key, &value) || sizeof(T) != value.size()) return defaultValue;
+        T result;
+        memcpy(&result, value.data(), sizeof(T));
+        return result;
+    }
+    template <typename T>
+    size_t put(const char *key, T value) {
+        return write(key, std::string((const char *)&value, sizeof(T))) ? sizeof(T) : 0;
+    }
+};
+
+#endif
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef __atoll_host_vesc_uart_h
+#define __atoll_host_vesc_uart_h
+
+// VescUart shim for the host build: the values are never updated
+
+#ifdef ATOLL_HOST
+
+#include <Arduino.h>
+
+class VescUart {
+   public:
+    struct dataPackage {
+        float avgMotorCurrent = 0;
+        float avgInputCurrent = 0;
+        float dutyCycleNow = 0;
+        float rpm = 0;
+        float inpVoltage = 0;
+        float ampHours = 0;
+        float ampHoursCharged = 0;
+        float wattHours = 0;
+        float wattHoursCharged = 0;
+        long tachometer = 0;
+        long tachometerAbs = 0;
+        float tempMosfet = 0;
+        float tempMotor = 0;
+        uint8_t error = 0;
+        uint8_t id = 0;
+    } data;
+
+    VescUart(uint32_t timeout_ms = 100) {}
+    void setSerialPort(Stream *port) {}
+    void setDebugPort(Stream *port) {}
+    bool getVescValues() { return false; }
+};
+
+#endif
+
+#endif
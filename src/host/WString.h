@@ -0,0 +1,81 @@
+#ifndef __atoll_host_wstring_h
+#define __atoll_host_wstring_h
+
+// Arduino String shim for the host build, backed by std::string
+
+#ifdef ATOLL_HOST
+
+#include <string>
+#include <stdio.h>
+#include <string.h>
+
+class String {
+   public:
+    String(const char *str = "") : value(nullptr == str ? "" : str) {}
+    String(const char *str, unsigned int length) : value(str, length) {}
+    String(const std::string &str) : value(str) {}
+    explicit String(char c) : value(1, c) {}
+    explicit String(int n) : value(std::to_string(n)) {}
+    explicit String(unsigned int n) : value(std::to_string(n)) {}
+    explicit String(long n) : value(std::to_string(n)) {}
+    explicit String(unsigned long n) : value(std::to_string(n)) {}
+    explicit String(double n, unsigned int decimals = 2) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.*f", decimals, n);
+        value = buf;
+    }
+
+    const char *c_str() const { return value.c_str(); }
+    unsigned int length() const { return value.length(); }
+    bool isEmpty() const { return value.empty(); }
+    char charAt(unsigned int index) const { return index < value.length() ? value[index] : 0; }
+    char operator[](unsigned int index) const { return charAt(index); }
+    int indexOf(char c, unsigned int from = 0) const { return npos(value.find(c, from)); }
+    int indexOf(const String &str, unsigned int from = 0) const { return npos(value.find(str.value, from)); }
+    int lastIndexOf(char c) const { return npos(value.rfind(c)); }
+    String substring(unsigned int from) const { return substring(from, value.length()); }
+    String substring(unsigned int from, unsigned int to) const {
+        if (value.length() < from || to < from) return String();
+        return String(value.substr(from, to - from));
+    }
+    bool startsWith(const String &prefix) const { return 0 == value.compare(0, prefix.value.length(), prefix.value); }
+    bool endsWith(const String &suffix) const {
+        return suffix.value.length() <= value.length() &&
+               0 == value.compare(value.length() - suffix.value.length(), suffix.value.length(), suffix.value);
+    }
+    bool equals(const String &str) const { return value == str.value; }
+    long toInt() const { return atol(value.c_str()); }
+    float toFloat() const { return atof(value.c_str()); }
+    void trim() {
+        size_t start = value.find_first_not_of(" \t\r\n");
+        size_t end = value.find_last_not_of(" \t\r\n");
+        value = std::string::npos == start ? "" : value.substr(start, end - start + 1);
+    }
+
+    String &operator+=(const String &str) {
+        value += str.value;
+        return *this;
+    }
+    String &operator+=(const char *str) {
+        if (nullptr != str) value += str;
+        return *this;
+    }
+    String &operator+=(char c) {
+        value += c;
+        return *this;
+    }
+    friend String operator+(const String &a, const String &b) { return String(a.value + b.value); }
+    bool operator==(const String &str) const { return value == str.value; }
+    bool operator==(const char *str) const { return nullptr != str && value == str; }
+    bool operator!=(const String &str) const { return value != str.value; }
+    bool operator!=(const char *str) const { return !(*this == str); }
+
+   protected:
+    std::string value;
+
+    static int npos(size_t index) { return std::string::npos == index ? -1 : (int)index; }
+};
+
+#endif
+
+#endif
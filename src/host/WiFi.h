@@ -0,0 +1,215 @@
+#ifndef __atoll_host_wifi_h
+#define __atoll_host_wifi_h
+
+// WiFi shim for the host build over POSIX sockets, see atoll_host.h
+// The station is always connected, servers listen on the loopback interface.
+
+#ifdef ATOLL_HOST
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <memory>
+
+#include "Arduino.h"
+
+typedef enum {
+    WIFI_MODE_NULL = 0,
+    WIFI_MODE_STA,
+    WIFI_MODE_AP,
+    WIFI_MODE_APSTA,
+} wifi_mode_t;
+
+class IPAddress {
+   public:
+    IPAddress(uint32_t address = 0) : address(address) {}  // network byte order
+
+    String toString() const {
+        char buf[INET_ADDRSTRLEN] = "";
+        inet_ntop(AF_INET, &address, buf, sizeof(buf));
+        return String(buf);
+    }
+
+   protected:
+    uint32_t address;
+};
+
+namespace Atoll {
+namespace Host {
+
+// closed when the last copy of the client or server is gone, or by close()
+struct Socket {
+    int fd;
+
+    Socket(int fd) : fd(fd) {}
+    ~Socket() { close(); }
+
+    void close() {
+        if (fd < 0) return;
+        ::close(fd);
+        fd = -1;
+    }
+};
+
+}  // namespace Host
+}  // namespace Atoll
+
+// copies share the connection as on the ESP32
+class WiFiClient {
+   public:
+    WiFiClient() {}
+    explicit WiFiClient(int fd) : socket(std::make_shared<Atoll::Host::Socket>(fd)) {}
+
+    // returns 1 if connected
+    int connect(const char *host, uint16_t port) {
+        stop();
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        if (1 != inet_pton(AF_INET, host, &address.sin_addr)) return 0;
+        int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return 0;
+        socket = std::make_shared<Atoll::Host::Socket>(fd);
+        if (0 != ::connect(fd, (sockaddr *)&address, sizeof(address))) {
+            stop();
+            return 0;
+        }
+        return 1;
+    }
+
+    // true while the peer has not closed the connection or there is data to read
+    uint8_t connected() {
+        if (!*this) return 0;
+        uint8_t b;
+        ssize_t n = recv(socket->fd, &b, 1, MSG_PEEK | MSG_DONTWAIT);
+        if (0 < n) return 1;
+        if (0 == n) return 0;
+        return EAGAIN == errno || EWOULDBLOCK == errno ? 1 : 0;
+    }
+
+    int available() {
+        if (!*this) return 0;
+        int n = 0;
+        if (0 != ioctl(socket->fd, FIONREAD, &n)) return 0;
+        return n;
+    }
+
+    int read() {
+        uint8_t b;
+        return 1 == read(&b, 1) ? b : -1;
+    }
+
+    // does not block, returns -1 if there is nothing to read
+    int read(uint8_t *buf, size_t size) {
+        if (!*this) return -1;
+        ssize_t n = recv(socket->fd, buf, size, MSG_DONTWAIT);
+        return n <= 0 ? -1 : (int)n;
+    }
+
+    // blocks until everything is written
+    size_t write(const uint8_t *buf, size_t size) {
+        if (!*this) return 0;
+        size_t written = 0;
+        while (written < size) {
+            ssize_t n = send(socket->fd, buf + written, size - written, MSG_NOSIGNAL);
+            if (n <= 0) break;
+            written += n;
+        }
+        return written;
+    }
+
+    int setNoDelay(bool noDelay) {
+        if (!*this) return -1;
+        int flag = noDelay;
+        return setsockopt(socket->fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+    }
+
+    IPAddress remoteIP() {
+        sockaddr_in address = {};
+        socklen_t length = sizeof(address);
+        if (!*this || 0 != getpeername(socket->fd, (sockaddr *)&address, &length)) return IPAddress();
+        return IPAddress(address.sin_addr.s_addr);
+    }
+
+    // closes the connection of every copy
+    void stop() {
+        if (socket) socket->close();
+        socket.reset();
+    }
+
+    operator bool() { return socket && 0 <= socket->fd; }
+
+   protected:
+    std::shared_ptr<Atoll::Host::Socket> socket;
+};
+
+class WiFiServer {
+   public:
+    WiFiServer(uint16_t port = 80, uint8_t maxClients = 4) : port(port), maxClients(maxClients) {}
+
+    void begin(uint16_t port = 0) {
+        if (0 < port) this->port = port;
+        end();
+        int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+        if (fd < 0) return;
+        listener = std::make_shared<Atoll::Host::Socket>(fd);
+        int flag = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(this->port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (0 != bind(fd, (sockaddr *)&address, sizeof(address)) || 0 != listen(fd, maxClients))
+            end();
+    }
+
+    void setNoDelay(bool noDelay) { this->noDelay = noDelay; }
+
+    bool hasClient() {
+        if (pending) return true;
+        if (!listener || listener->fd < 0) return false;
+        int fd = accept4(listener->fd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) return false;
+        pending = WiFiClient(fd);
+        pending.setNoDelay(noDelay);
+        return true;
+    }
+
+    WiFiClient available() {
+        if (!hasClient()) return WiFiClient();
+        WiFiClient client = pending;
+        pending = WiFiClient();
+        return client;
+    }
+
+    void end() {
+        pending.stop();
+        if (listener) listener->close();
+        listener.reset();
+    }
+
+   protected:
+    uint16_t port;
+    uint8_t maxClients;
+    bool noDelay = false;
+    std::shared_ptr<Atoll::Host::Socket> listener;
+    WiFiClient pending;  // accepted by hasClient()
+};
+
+class WiFiClass {
+   public:
+    wifi_mode_t getMode() { return WIFI_MODE_STA; }
+    bool isConnected() { return true; }
+    uint8_t softAPgetStationNum() { return 0; }
+};
+
+inline WiFiClass WiFi;
+
+#endif
+
+#endif
@@ -0,0 +1,485 @@
+#ifdef ATOLL_HOST
+
+#include "atoll_host.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <atomic>
+#include <vector>
+
+struct HostTask {
+    char name[16] = "";
+    TaskFunction_t function = nullptr;
+    void *param = nullptr;
+    uint32_t stack = 0;
+    bool counted = true;       // whether the thread is counted in runnable()
+    uint32_t notifications = 0;
+    bool deleted = false;
+    bool finished = false;    // the thread of a deleted task has ended
+    bool blocked = false;     // in a wait
+    bool abortDelay = false;  // leave the wait, see xTaskAbortDelay()
+};
+
+struct HostSemaphore {
+    uint32_t count = 0;
+    uint32_t max = 1;
+    HostTask *owner = nullptr;  // recursive mutex only
+    uint32_t depth = 0;         // recursive mutex only
+};
+
+struct HostQueue {
+    std::vector<uint8_t> items;
+    size_t itemSize = 0;
+    size_t length = 0;
+    size_t head = 0;   // index of the oldest item
+    size_t count = 0;  // number of items waiting
+};
+
+namespace {
+
+// thrown in the thread of a deleted task, caught by its entry function
+struct Deleted {};
+
+struct Waiter {
+    std::function<bool()> ready;  // called with the lock held
+    HostTask *task = nullptr;
+    uint64_t deadline = UINT64_MAX;  // us
+    bool woken = false;
+};
+
+// never destroyed, detached task threads may still be running at exit
+struct State {
+    std::mutex lock;
+    std::condition_variable cv;
+    std::list<Waiter *> waiters;
+    std::recursive_mutex critical;
+    std::atomic<bool> virtualClockEnabled{false};
+    std::atomic<uint64_t> virtualNow{0};  // us
+    int runnableCount = 0;                // use the lock
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+};
+
+State &state() {
+    static State *s = new State();
+    return *s;
+}
+
+// threads that were not created by xTaskCreate get an uncounted task of their own
+thread_local HostTask *current = nullptr;
+
+HostTask *self() {
+    if (nullptr == current) {
+        static thread_local HostTask own;
+        own.counted = false;
+        snprintf(own.name, sizeof(own.name), "host");
+        current = &own;
+    }
+    return current;
+}
+
+uint64_t nowUs() {
+    if (state().virtualClockEnabled) return state().virtualNow;
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now() - state().started)
+        .count();
+}
+
+uint64_t deadlineAfter(TickType_t ticks) {
+    if (portMAX_DELAY == ticks) return UINT64_MAX;
+    return nowUs() + (uint64_t)ticks * 1000;
+}
+
+// call with the lock held after changing anything a waiter may be waiting for
+void wakeWaiters() {
+    uint64_t now = nowUs();
+    for (Waiter *w : state().waiters) {
+        if (w->woken) continue;
+        if (w->task->deleted || w->task->abortDelay || w->deadline <= now || w->ready()) {
+            w->woken = true;
+            if (w->task->counted) state().runnableCount++;
+        }
+    }
+    state().cv.notify_all();
+}
+
+// Blocks until ready() returns true, the deadline passes or the wait is
+// aborted, returns ready().
+// The waiting task is not counted as runnable while blocked.
+bool wait(std::unique_lock<std::mutex> &l, uint64_t deadline, std::function<bool()> ready) {
+    HostTask *task = self();
+    for (;;) {
+        if (task->deleted) {
+            l.unlock();
+            throw Deleted();
+        }
+        if (ready()) return true;
+        if (task->abortDelay) {
+            task->abortDelay = false;
+            return false;
+        }
+        if (deadline <= nowUs()) return false;
+        Waiter w;
+        w.ready = ready;
+        w.task = task;
+        w.deadline = deadline;
+        task->blocked = true;
+        state().waiters.push_back(&w);
+        if (task->counted) {
+            state().runnableCount--;
+            state().cv.notify_all();  // advance() waits for the count to drop
+        }
+        while (!w.woken) {
+            if (state().virtualClockEnabled || UINT64_MAX == deadline) {
+                state().cv.wait(l);
+                continue;
+            }
+            uint64_t now = nowUs();
+            if (now < deadline) state().cv.wait_for(l, std::chrono::microseconds(deadline - now));
+            if (!w.woken && deadline <= nowUs()) {
+                w.woken = true;
+                if (task->counted) state().runnableCount++;
+            }
+        }
+        state().waiters.remove(&w);
+        task->blocked = false;
+    }
+}
+
+void taskEntry(HostTask *task) {
+    current = task;
+    bool deleted;
+    {
+        std::lock_guard<std::mutex> l(state().lock);
+        deleted = task->deleted;
+    }
+    try {
+        if (!deleted) task->function(task->param);
+    } catch (const Deleted &) {
+    }
+    std::lock_guard<std::mutex> l(state().lock);
+    state().runnableCount--;
+    // a deleted task is freed by vTaskDelete()
+    if (task->deleted)
+        task->finished = true;
+    else
+        delete task;
+    state().cv.notify_all();
+}
+
+void delayUntil(uint64_t deadline) {
+    std::unique_lock<std::mutex> l(state().lock);
+    wait(l, deadline, []() { return false; });
+}
+
+}  // namespace
+
+void vPortEnterCritical(portMUX_TYPE *) {
+    state().critical.lock();
+}
+
+void vPortExitCritical(portMUX_TYPE *) {
+    state().critical.unlock();
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function,
+                                   const char *name,
+                                   uint32_t stack,
+                                   void *param,
+                                   UBaseType_t priority,
+                                   TaskHandle_t *handle,
+                                   BaseType_t core) {
+    HostTask *task = new HostTask();
+    snprintf(task->name, sizeof(task->name), "%s", nullptr == name ? "" : name);
+    task->function = function;
+    task->param = param;
+    task->stack = stack;
+    {
+        std::lock_guard<std::mutex> l(state().lock);
+        state().runnableCount++;
+    }
+    if (nullptr != handle) *handle = task;
+    std::thread(taskEntry, task).detach();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function,
+                       const char *name,
+                       uint32_t stack,
+                       void *param,
+                       UBaseType_t priority,
+                       TaskHandle_t *handle) {
+    return xTaskCreatePinnedToCore(function, name, stack, param, priority, handle, tskNO_AFFINITY);
+}
+
+// The thread of the task ends at its next blocking call, returns when it
+// has ended so the task code does not run after the call, as on FreeRTOS.
+void vTaskDelete(TaskHandle_t task) {
+    if (nullptr == task || self() == task) throw Deleted();
+    std::unique_lock<std::mutex> l(state().lock);
+    task->deleted = true;
+    wakeWaiters();
+    state().cv.wait(l, [task]() { return task->finished; });
+    delete task;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return self();
+}
+
+TickType_t xTaskGetTickCount() {
+    return (TickType_t)(nowUs() / 1000);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    delayUntil(deadlineAfter(ticks));
+}
+
+BaseType_t xTaskDelayUntil(TickType_t *previousWakeTime, TickType_t increment) {
+    TickType_t wake = *previousWakeTime + increment;
+    *previousWakeTime = wake;
+    int32_t ticks = (int32_t)(wake - xTaskGetTickCount());
+    if (ticks <= 0) return pdFALSE;
+    delayUntil(nowUs() + (uint64_t)ticks * 1000);
+    return pdTRUE;
+}
+
+BaseType_t xTaskAbortDelay(TaskHandle_t task) {
+    std::lock_guard<std::mutex> l(state().lock);
+    if (nullptr == task || !task->blocked) return pdFAIL;
+    task->abortDelay = true;
+    wakeWaiters();
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t timeout) {
+    std::unique_lock<std::mutex> l(state().lock);
+    HostTask *task = self();
+    wait(l, deadlineAfter(timeout), [task]() { return 0 < task->notifications; });
+    uint32_t count = task->notifications;
+    if (0 < count) task->notifications = pdTRUE == clearOnExit ? 0 : count - 1;
+    return count;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    if (nullptr == task) return pdFAIL;
+    std::lock_guard<std::mutex> l(state().lock);
+    task->notifications++;
+    wakeWaiters();
+    return pdPASS;
+}
+
+static thread_local bool isrContext = false;
+
+BaseType_t xPortInIsrContext() {
+    return isrContext ? pdTRUE : pdFALSE;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken) {
+    xTaskNotifyGive(task);
+    if (nullptr != higherPriorityTaskWoken) *higherPriorityTaskWoken = pdFALSE;
+}
+
+// there is no stack to measure, the size the task was created with
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    return nullptr == task ? 0 : task->stack;
+}
+
+uint32_t xPortGetFreeHeapSize() {
+    return 0;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    HostSemaphore *semaphore = new HostSemaphore();
+    semaphore->count = 1;
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+    return new HostSemaphore();
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t timeout) {
+    if (nullptr == semaphore) return pdFALSE;
+    std::unique_lock<std::mutex> l(state().lock);
+    if (!wait(l, deadlineAfter(timeout), [semaphore]() { return 0 < semaphore->count; }))
+        return pdFALSE;
+    semaphore->count--;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    if (nullptr == semaphore) return pdFALSE;
+    std::lock_guard<std::mutex> l(state().lock);
+    if (semaphore->max <= semaphore->count) return pdFALSE;
+    semaphore->count++;
+    wakeWaiters();
+    return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+    delete semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() {
+    return xSemaphoreCreateMutex();
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t semaphore, TickType_t timeout) {
+    if (nullptr == semaphore) return pdFALSE;
+    std::unique_lock<std::mutex> l(state().lock);
+    HostTask *task = self();
+    if (semaphore->owner == task) {
+        semaphore->depth++;
+        return pdTRUE;
+    }
+    if (!wait(l, deadlineAfter(timeout), [semaphore]() { return 0 < semaphore->count; }))
+        return pdFALSE;
+    semaphore->count--;
+    semaphore->owner = task;
+    semaphore->depth = 1;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t semaphore) {
+    if (nullptr == semaphore) return pdFALSE;
+    std::lock_guard<std::mutex> l(state().lock);
+    if (semaphore->owner != self()) return pdFALSE;
+    if (0 < --semaphore->depth) return pdTRUE;
+    semaphore->owner = nullptr;
+    semaphore->count++;
+    wakeWaiters();
+    return pdTRUE;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    if (0 == length || 0 == itemSize) return nullptr;
+    HostQueue *queue = new HostQueue();
+    queue->items.resize(length * itemSize);
+    queue->itemSize = itemSize;
+    queue->length = length;
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t timeout) {
+    if (nullptr == queue) return pdFALSE;
+    std::unique_lock<std::mutex> l(state().lock);
+    if (!wait(l, deadlineAfter(timeout), [queue]() { return queue->count < queue->length; }))
+        return pdFALSE;
+    size_t tail = (queue->head + queue->count) % queue->length;
+    memcpy(queue->items.data() + tail * queue->itemSize, item, queue->itemSize);
+    queue->count++;
+    wakeWaiters();
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t timeout) {
+    if (nullptr == queue) return pdFALSE;
+    std::unique_lock<std::mutex> l(state().lock);
+    if (!wait(l, deadlineAfter(timeout), [queue]() { return 0 < queue->count; }))
+        return pdFALSE;
+    memcpy(buffer, queue->items.data() + queue->head * queue->itemSize, queue->itemSize);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    wakeWaiters();
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    if (nullptr == queue) return 0;
+    std::lock_guard<std::mutex> l(state().lock);
+    return queue->count;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    delete queue;
+}
+
+esp_reset_reason_t esp_reset_reason() {
+    return ESP_RST_POWERON;
+}
+
+int64_t esp_timer_get_time() {
+    return (int64_t)nowUs();
+}
+
+unsigned long millis() {
+    return (unsigned long)(nowUs() / 1000);
+}
+
+unsigned long micros() {
+    return (unsigned long)nowUs();
+}
+
+void delay(uint32_t ms) {
+    if (0 == ms)
+        yield();
+    else
+        vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+void yield() {
+    std::this_thread::yield();
+}
+
+long random(long max) {
+    return random(0, max);
+}
+
+long random(long min, long max) {
+    if (max <= min) return min;
+    return min + (long)(::random() % (max - min));
+}
+
+EspClass ESP;
+
+void EspClass::restart() {
+    exit(0);
+}
+
+const char *pathToFileName(const char *path) {
+    const char *name = strrchr(path, '/');
+    return nullptr == name ? path : name + 1;
+}
+
+namespace Atoll {
+namespace Host {
+
+void useVirtualClock(bool enable) {
+    std::lock_guard<std::mutex> l(state().lock);
+    if (enable && !state().virtualClockEnabled) state().virtualNow = nowUs();
+    state().virtualClockEnabled = enable;
+    wakeWaiters();
+}
+
+bool virtualClock() {
+    return state().virtualClockEnabled;
+}
+
+void advance(uint32_t ms) {
+    std::unique_lock<std::mutex> l(state().lock);
+    // tasks started since the last step run up to their first wait at the current time
+    state().cv.wait(l, []() { return state().runnableCount <= 0; });
+    for (uint32_t i = 0; i < ms; i++) {
+        if (state().virtualClockEnabled) state().virtualNow += 1000;
+        wakeWaiters();
+        state().cv.wait(l, []() { return state().runnableCount <= 0; });
+    }
+}
+
+int runnable() {
+    std::lock_guard<std::mutex> l(state().lock);
+    return state().runnableCount;
+}
+
+void setIsrContext(bool isr) {
+    isrContext = isr;
+}
+
+}  // namespace Host
+}  // namespace Atoll
+
+#endif
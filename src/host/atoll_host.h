@@ -0,0 +1,162 @@
+#if !defined(__atoll_host_h) && defined(ATOLL_HOST)
+#define __atoll_host_h
+
+// Linux implementation of the parts of the Arduino core, ESP-IDF and FreeRTOS
+// used by the portable modules (Task, TaskExecutor, Log, MpscRing).
+// Tasks are std::threads, 1 tick is 1 ms. Build with -DATOLL_HOST and
+// -Isrc/host so <Arduino.h> resolves to the shim, see [env:native].
+// The BLE client builds against the NimBLEDevice.h, Preferences.h and
+// VescUart.h shims next to this file, the Api against Preferences.h and the
+// TCP transport of the Api against WiFi.h.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+
+#define IRAM_ATTR
+#define RTC_NOINIT_ATTR
+#define RTC_DATA_ATTR
+
+// FreeRTOS
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef struct HostTask *TaskHandle_t;
+typedef struct HostSemaphore *SemaphoreHandle_t;
+typedef struct HostQueue *QueueHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define portMAX_DELAY (TickType_t)0xffffffffUL
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define pdTICKS_TO_MS(ticks) ((uint32_t)(ticks))
+#define tskNO_AFFINITY 0x7fffffff
+
+typedef struct {
+    int unused;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+
+// not a real critical section: one recursive lock shared by all muxes,
+// enough to keep the protected data consistent between the threads
+void vPortEnterCritical(portMUX_TYPE *mux);
+void vPortExitCritical(portMUX_TYPE *mux);
+#define portENTER_CRITICAL(mux) vPortEnterCritical(mux)
+#define portEXIT_CRITICAL(mux) vPortExitCritical(mux)
+#define portENTER_CRITICAL_ISR(mux) vPortEnterCritical(mux)
+#define portEXIT_CRITICAL_ISR(mux) vPortExitCritical(mux)
+#define portYIELD_FROM_ISR(...)
+// true on a thread marked with Host::setIsrContext()
+BaseType_t xPortInIsrContext();
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function,
+                                   const char *name,
+                                   uint32_t stack,
+                                   void *param,
+                                   UBaseType_t priority,
+                                   TaskHandle_t *handle,
+                                   BaseType_t core);
+BaseType_t xTaskCreate(TaskFunction_t function,
+                       const char *name,
+                       uint32_t stack,
+                       void *param,
+                       UBaseType_t priority,
+                       TaskHandle_t *handle);
+void vTaskDelete(TaskHandle_t task);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+TickType_t xTaskGetTickCount();
+void vTaskDelay(TickType_t ticks);
+BaseType_t xTaskDelayUntil(TickType_t *previousWakeTime, TickType_t increment);
+BaseType_t xTaskAbortDelay(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t timeout);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken);
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+uint32_t xPortGetFreeHeapSize();
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+SemaphoreHandle_t xSemaphoreCreateBinary();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t timeout);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+void vSemaphoreDelete(SemaphoreHandle_t semaphore);
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex();
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t semaphore, TickType_t timeout);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t semaphore);
+
+// items are copied in and out as on FreeRTOS
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t timeout);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t timeout);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+void vQueueDelete(QueueHandle_t queue);
+
+// ESP-IDF
+
+typedef enum {
+    ESP_RST_UNKNOWN,
+    ESP_RST_POWERON,
+    ESP_RST_EXT,
+    ESP_RST_SW,
+    ESP_RST_PANIC,
+    ESP_RST_INT_WDT,
+    ESP_RST_TASK_WDT,
+    ESP_RST_WDT,
+    ESP_RST_DEEPSLEEP,
+    ESP_RST_BROWNOUT,
+    ESP_RST_SDIO,
+} esp_reset_reason_t;
+
+esp_reset_reason_t esp_reset_reason();
+int64_t esp_timer_get_time();
+inline bool esp_ptr_in_drom(const void *) { return false; }
+
+// Arduino
+
+typedef unsigned long ulong;
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void yield();
+long random(long max);
+long random(long min, long max);
+const char *pathToFileName(const char *path);
+
+class EspClass {
+   public:
+    void restart();  // exits the process
+};
+
+extern EspClass ESP;
+
+namespace Atoll {
+namespace Host {
+
+// Switches between the monotonic clock of the host and a virtual clock that
+// only moves when advance() is called, call before starting any task.
+// With the virtual clock every wait of the tasks is resolved against the
+// virtual time, which makes the schedule of the tasks deterministic.
+void useVirtualClock(bool enable);
+bool virtualClock();
+// Moves the virtual clock 1 ms at a time, after each step waits until every
+// task woken by the step is blocked again. Not to be called from a task.
+void advance(uint32_t ms);
+// number of tasks that are not blocked in a wait
+int runnable();
+// Marks the calling thread as running an interrupt handler, to exercise the
+// paths that must not block in an ISR. There are no interrupts on the host.
+void setIsrContext(bool isr);
+
+}  // namespace Host
+}  // namespace Atoll
+
+#endif
@@ -0,0 +1 @@
+#include "../atoll_host.h"
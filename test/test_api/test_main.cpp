@@ -0,0 +1,454 @@
+// Api: the worker task, single and batched commands over a loopback
+// transport, reply order, chunking, init pages and the connect-to-ready time
+// of a client that reads its settings one by one against one batch. The same
+// commands over TCP, its framing and concurrent clients.
+#include <unity.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "atoll_api.h"
+#include "atoll_api_tcp.h"
+#include "atoll_task_executor.h"
+
+using namespace Atoll;
+
+#define SETTINGS 12  // the settings a client reads after init
+#define READY_RUNS 200
+#define TCP_PORT 23230
+#define TCP_READY_RUNS 20
+
+// replies are collected until a reply with the "[end]" prefix arrives
+class Loopback : public ApiTransport {
+   public:
+    size_t maxReply = ATOLL_API_MSG_REPLY_LENGTH;
+
+    const char *transportName() override { return "Loopback"; }
+
+    bool send(uint16_t clientId, const uint8_t *data, size_t size) override {
+        std::lock_guard<std::mutex> l(lock);
+        replies.emplace_back((const char *)data, size);
+        cv.notify_all();
+        return true;
+    }
+
+    size_t maxReplySize(uint16_t clientId) override { return maxReply; }
+
+    // sends the frame, returns the replies to it
+    std::vector<std::string> request(const std::string &frame) {
+        {
+            std::lock_guard<std::mutex> l(lock);
+            replies.clear();
+        }
+        Api::receive(this, 1, frame.c_str(), frame.length());
+        Api::receive(this, 1, "[end]init", strlen("[end]init"));
+        std::unique_lock<std::mutex> l(lock);
+        bool ended = cv.wait_for(l, std::chrono::seconds(2), [this]() {
+            return !replies.empty() && 0 == replies.back().rfind("[end]", 0);
+        });
+        TEST_ASSERT_TRUE_MESSAGE(ended, frame.c_str());
+        replies.pop_back();
+        return replies;
+    }
+
+    // sends the frame and waits for the first reply
+    std::string roundTrip(const std::string &frame) {
+        std::unique_lock<std::mutex> l(lock);
+        replies.clear();
+        l.unlock();
+        Api::receive(this, 1, frame.c_str(), frame.length());
+        l.lock();
+        cv.wait_for(l, std::chrono::seconds(2), [this]() { return !replies.empty(); });
+        return replies.empty() ? "" : replies.front();
+    }
+
+   protected:
+    std::mutex lock;
+    std::condition_variable cv;
+    std::vector<std::string> replies;
+};
+
+// a client of ApiTcp, frames are prefixed with their length
+class TcpClient {
+   public:
+    WiFiClient client;
+
+    // header and body are written separately, no Nagle delay as on the server side
+    bool connect() {
+        if (1 != client.connect("127.0.0.1", TCP_PORT)) return false;
+        client.setNoDelay(true);
+        return true;
+    }
+
+    void sendFrame(const std::string &frame) {
+        uint8_t header[2] = {(uint8_t)(frame.size() & 0xff), (uint8_t)(frame.size() >> 8)};
+        client.write(header, sizeof(header));
+        client.write((const uint8_t *)frame.data(), frame.size());
+    }
+
+    // returns false on timeout
+    bool readFrame(std::string *frame, uint32_t timeout = 2000) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+        uint8_t header[2];
+        if (!readAll(header, sizeof(header), deadline)) return false;
+        frame->resize(header[0] | header[1] << 8);
+        return readAll((uint8_t *)&(*frame)[0], frame->size(), deadline);
+    }
+
+    // sends the frame, returns the replies to it, false on timeout
+    bool request(const std::string &frame, std::vector<std::string> *replies) {
+        sendFrame(frame);
+        sendFrame("[end]init");
+        replies->clear();
+        std::string reply;
+        while (readFrame(&reply)) {
+            if (0 == reply.rfind("[end]", 0)) return true;
+            replies->push_back(reply);
+        }
+        return false;
+    }
+
+    std::string roundTrip(const std::string &frame) {
+        sendFrame(frame);
+        std::string reply;
+        readFrame(&reply);
+        return reply;
+    }
+
+   protected:
+    bool readAll(uint8_t *buf, size_t size, std::chrono::steady_clock::time_point deadline) {
+        size_t received = 0;
+        while (received < size) {
+            int n = client.read(buf + received, size - received);
+            if (0 < n)
+                received += n;
+            else if (!client.connected() || deadline < std::chrono::steady_clock::now())
+                return false;
+            else
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        return true;
+    }
+};
+
+static Api api;
+static TaskExecutor executor;
+static ::Preferences preferences;
+static Loopback loopback;
+static ApiTcp tcp;
+static TcpClient tcpClient;
+
+static std::string expected(const char *command, const char *value) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%d;%d=%s", Api::success()->code, Api::command(command)->code, value);
+    return buf;
+}
+
+static std::string settingsBatch() {
+    std::string batch;
+    for (int i = 0; i < SETTINGS; i++) batch += "s" + std::to_string(i) + "\n";
+    return batch;
+}
+
+void setUp() {
+    loopback.maxReply = ATOLL_API_MSG_REPLY_LENGTH;
+    if (!tcpClient.client) tcpClient.connect();
+}
+
+void tearDown() {}
+
+// the worker keeps a dedicated task even if it was set to be shared
+void test_worker_dedicated() {
+    TEST_ASSERT_TRUE(api.taskRunning());
+    TEST_ASSERT_FALSE(api.taskShared());
+    TEST_ASSERT_EQUAL(0, executor.size());
+}
+
+void test_single() {
+    auto replies = loopback.request("s3");
+    TEST_ASSERT_EQUAL(1, replies.size());
+    TEST_ASSERT_EQUAL_STRING(expected("s3", "value3").c_str(), replies[0].c_str());
+}
+
+// one reply with a line per command, in the order of the commands
+void test_batch() {
+    auto replies = loopback.request("s1\nbogus\r\n\ns0=x\n=x\ns2");
+    TEST_ASSERT_EQUAL(1, replies.size());
+    char unknown[48];
+    snprintf(unknown, sizeof(unknown), "%d:unknownCommand;0=", Api::result("unknownCommand")->code);
+    char commandMissing[48];
+    snprintf(commandMissing, sizeof(commandMissing), "%d:commandMissing;0=", Api::result("commandMissing")->code);
+    std::string lines = expected("s1", "value1") + "\n" +
+                        unknown + "\n" +
+                        expected("s0", "x") + "\n" +
+                        commandMissing + "\n" +
+                        expected("s2", "value2");
+    TEST_ASSERT_EQUAL_STRING(lines.c_str(), replies[0].c_str());
+}
+
+void test_batch_correlation_id() {
+    auto replies = loopback.request("[7]s0\ns1");
+    TEST_ASSERT_EQUAL(1, replies.size());
+    std::string lines = "[7]" + expected("s0", "value0") + "\n" + expected("s1", "value1");
+    TEST_ASSERT_EQUAL_STRING(lines.c_str(), replies[0].c_str());
+}
+
+// replies are split at line boundaries to fit the transport
+void test_batch_chunks() {
+    loopback.maxReply = 40;
+    auto replies = loopback.request(settingsBatch());
+    TEST_ASSERT_GREATER_THAN(1, replies.size());
+    std::string joined;
+    for (auto &r : replies) {
+        TEST_ASSERT_LESS_OR_EQUAL(40, r.size());
+        TEST_ASSERT_NOT_EQUAL('\n', r.back());
+        if (!joined.empty()) joined += "\n";
+        joined += r;
+    }
+    std::string lines;
+    for (int i = 0; i < SETTINGS; i++) {
+        if (!lines.empty()) lines += "\n";
+        std::string name = "s" + std::to_string(i);
+        lines += expected(name.c_str(), ("value" + std::to_string(i)).c_str());
+    }
+    TEST_ASSERT_EQUAL_STRING(lines.c_str(), joined.c_str());
+}
+
+// a binary reply is sent on its own
+void test_batch_binary() {
+    auto replies = loopback.request("s0\nbin\ns1");
+    TEST_ASSERT_EQUAL(3, replies.size());
+    std::string bin = expected("bin", "");
+    bin.append("\0\1\2", 3);
+    TEST_ASSERT_EQUAL(bin.size(), replies[1].size());
+    TEST_ASSERT_EQUAL_MEMORY(bin.data(), replies[1].data(), bin.size());
+    TEST_ASSERT_EQUAL_STRING(expected("s1", "value1").c_str(), replies[2].c_str());
+}
+
+void test_batch_too_long() {
+    std::string batch;
+    for (int i = 0; i <= ATOLL_API_BATCH_MAX_COMMANDS; i++) batch += "s0\n";
+    auto replies = loopback.request(batch);
+    TEST_ASSERT_EQUAL(1, replies.size());
+    char tooLong[48];
+    snprintf(tooLong, sizeof(tooLong), "%d:commandTooLong;0=", Api::result("commandTooLong")->code);
+    TEST_ASSERT_EQUAL_STRING(tooLong, replies[0].c_str());
+}
+
+// init paged to fit a small transport with a correlation id: every page ends
+// with the marker of the next one except the last, every value is on one page
+void test_init_pages() {
+    const size_t mtus[] = {60, 120};
+    for (size_t mtu : mtus) {
+        loopback.maxReply = mtu;
+        std::string prefix = "[pg]" + expected("init", "0:version=");
+        std::vector<int> seen(SETTINGS, 0);
+        int page = 0;
+        while (true) {
+            auto replies = loopback.request("[pg]init=page:" + std::to_string(page));
+            TEST_ASSERT_EQUAL(1, replies.size());
+            std::string &reply = replies[0];
+            TEST_ASSERT_LESS_OR_EQUAL(mtu, reply.size());
+            TEST_ASSERT_EQUAL_STRING_LEN(prefix.c_str(), reply.c_str(), prefix.size());
+            TEST_ASSERT_EQUAL(';', reply.back());
+            for (int i = 0; i < SETTINGS; i++) {
+                std::string token = ";" + std::to_string(Api::command(("s" + std::to_string(i)).c_str())->code) +
+                                    ":s" + std::to_string(i) + "=value" + std::to_string(i) + ";";
+                if (std::string::npos != reply.find(token)) seen[i]++;
+            }
+            size_t next = reply.find("0:next=");
+            if (std::string::npos == next) break;
+            std::string marker = "0:next=" + std::to_string(page + 1) + ";";
+            TEST_ASSERT_EQUAL_STRING(marker.c_str(), reply.substr(next).c_str());
+            page++;
+            TEST_ASSERT_LESS_THAN(100, page);
+        }
+        TEST_ASSERT_GREATER_THAN(1, page);
+        for (int i = 0; i < SETTINGS; i++) TEST_ASSERT_EQUAL(1, seen[i]);
+    }
+}
+
+// init and the settings one by one, every command a round trip, against a
+// single batch; on BLE each round trip adds a write and a notification
+void test_connect_to_ready() {
+    std::string batch = "init\n" + settingsBatch();
+    double sequentialUs = 0, batchUs = 0;
+    for (int run = 0; run < READY_RUNS; run++) {
+        auto start = std::chrono::steady_clock::now();
+        TEST_ASSERT_EQUAL('1', loopback.roundTrip("init")[0]);
+        for (int i = 0; i < SETTINGS; i++)
+            TEST_ASSERT_EQUAL('1', loopback.roundTrip("s" + std::to_string(i))[0]);
+        sequentialUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        start = std::chrono::steady_clock::now();
+        auto replies = loopback.request(batch);
+        batchUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        TEST_ASSERT_EQUAL(1, replies.size());
+    }
+    char msg[128];
+    snprintf(msg, sizeof(msg), "connect to ready: %d round trips %.0f us, 1 batch %.0f us",
+             SETTINGS + 1, sequentialUs / READY_RUNS, batchUs / READY_RUNS);
+    TEST_MESSAGE(msg);
+}
+
+// the replies over TCP are the same as over the loopback transport with the
+// same reply size
+void test_tcp_same_replies() {
+    loopback.maxReply = ATOLL_API_TCP_MAX_REPLY_LENGTH;
+    std::string tooLong;
+    for (int i = 0; i <= ATOLL_API_BATCH_MAX_COMMANDS; i++) tooLong += "s0\n";
+    const std::string frames[] = {
+        "s3",
+        "s0=x",
+        "bogus",
+        "[7]s1",
+        "s1\nbogus\r\n\ns0=x\n=x\ns2",
+        "[8]init\n" + settingsBatch(),
+        "s0\nbin\ns1",
+        tooLong,
+    };
+    for (auto &frame : frames) {
+        auto expected = loopback.request(frame);
+        std::vector<std::string> replies;
+        TEST_ASSERT_TRUE_MESSAGE(tcpClient.request(frame, &replies), frame.c_str());
+        TEST_ASSERT_EQUAL_MESSAGE(expected.size(), replies.size(), frame.c_str());
+        for (size_t i = 0; i < expected.size(); i++) {
+            TEST_ASSERT_EQUAL_MESSAGE(expected[i].size(), replies[i].size(), frame.c_str());
+            TEST_ASSERT_EQUAL_MEMORY(expected[i].data(), replies[i].data(), expected[i].size());
+        }
+    }
+}
+
+// a frame arriving in pieces, an empty keepalive frame and a frame that is too long
+void test_tcp_framing() {
+    std::string frame = "[3]s2";
+    uint8_t header[2] = {(uint8_t)frame.size(), 0};
+    uint8_t keepalive[2] = {0, 0};
+    tcpClient.client.write(keepalive, sizeof(keepalive));
+    tcpClient.client.write(header, 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    tcpClient.client.write(header + 1, 1);
+    for (char c : frame) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        tcpClient.client.write((const uint8_t *)&c, 1);
+    }
+    std::string reply;
+    TEST_ASSERT_TRUE(tcpClient.readFrame(&reply));
+    TEST_ASSERT_EQUAL_STRING(("[3]" + expected("s2", "value2")).c_str(), reply.c_str());
+
+    tcpClient.sendFrame(std::string(ATOLL_API_COMMAND_STR_LENGTH + 1, 'x'));
+    TEST_ASSERT_TRUE(tcpClient.readFrame(&reply));
+    char tooLong[48];
+    snprintf(tooLong, sizeof(tooLong), "%d:commandTooLong;0=", Api::result("commandTooLong")->code);
+    TEST_ASSERT_EQUAL_STRING(tooLong, reply.c_str());
+    // still in sync
+    TEST_ASSERT_EQUAL_STRING(expected("s1", "value1").c_str(), tcpClient.roundTrip("s1").c_str());
+}
+
+// every client gets its own replies, a client over the limit is disconnected
+void test_tcp_clients() {
+    TcpClient clients[ATOLL_API_TCP_MAX_CLIENTS - 1];  // one slot is taken by tcpClient
+    for (auto &c : clients) TEST_ASSERT_TRUE(c.connect());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    TcpClient extra;
+    TEST_ASSERT_TRUE(extra.connect());
+    std::string reply;
+    TEST_ASSERT_FALSE(extra.readFrame(&reply, 500));
+    TEST_ASSERT_FALSE(extra.client.connected());
+
+    std::vector<std::thread> threads;
+    bool ok[ATOLL_API_TCP_MAX_CLIENTS - 1] = {};
+    for (int i = 0; i < ATOLL_API_TCP_MAX_CLIENTS - 1; i++)
+        threads.emplace_back([&clients, &ok, i]() {
+            bool all = true;
+            std::vector<std::string> replies;
+            for (int j = 0; j < 50; j++) {
+                std::string value = std::to_string(i) + "." + std::to_string(j);
+                all = all &&
+                      clients[i].request("s" + std::to_string(i) + "=" + value, &replies) &&
+                      1 == replies.size() &&
+                      replies[0] == expected(("s" + std::to_string(i)).c_str(), value.c_str());
+            }
+            ok[i] = all;
+        });
+    for (auto &t : threads) t.join();
+    for (bool b : ok) TEST_ASSERT_TRUE(b);
+    for (auto &c : clients) c.client.stop();
+    // let the server notice, the slots are free for the next test
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+}
+
+// connect, then init and the settings one by one or in one batch
+void test_tcp_connect_to_ready() {
+    std::string batch = "init\n" + settingsBatch();
+    double sequentialMs = 0, batchMs = 0;
+    for (int run = 0; run < TCP_READY_RUNS; run++) {
+        auto start = std::chrono::steady_clock::now();
+        TcpClient c;
+        TEST_ASSERT_TRUE(c.connect());
+        TEST_ASSERT_EQUAL('1', c.roundTrip("init")[0]);
+        for (int i = 0; i < SETTINGS; i++)
+            TEST_ASSERT_EQUAL('1', c.roundTrip("s" + std::to_string(i))[0]);
+        sequentialMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        c.client.stop();
+
+        start = std::chrono::steady_clock::now();
+        TcpClient b;
+        TEST_ASSERT_TRUE(b.connect());
+        std::string reply;
+        b.sendFrame(batch);
+        TEST_ASSERT_TRUE(b.readFrame(&reply));
+        batchMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        TEST_ASSERT_EQUAL(SETTINGS + 1, std::count(reply.begin(), reply.end(), '\n') + 1);
+        b.client.stop();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    char msg[128];
+    snprintf(msg, sizeof(msg), "TCP connect to ready: %d round trips %.1f ms, 1 batch %.1f ms",
+             SETTINGS + 1, sequentialMs / TCP_READY_RUNS, batchMs / TCP_READY_RUNS);
+    TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv) {
+    executor.taskStart();
+    api.taskSetShared(&executor);
+    Api::setup(&api, &preferences, "api");
+    for (int i = 0; i < SETTINGS; i++) {
+        char name[8];
+        snprintf(name, sizeof(name), "s%d", i);
+        Api::addCommand(Api::Command(name, [i](Api::Message *msg) {
+            if (strlen(msg->arg))
+                snprintf(msg->reply, sizeof(msg->reply), "%s", msg->arg);
+            else
+                snprintf(msg->reply, sizeof(msg->reply), "value%d", i);
+            return Api::success();
+        }));
+    }
+    Api::addCommand(Api::Command("bin", [](Api::Message *msg) {
+        snprintf(msg->reply, sizeof(msg->reply), "%s", "");
+        memcpy(msg->reply, "\0\1\2", 3);
+        msg->replyLength = 3;
+        return Api::success();
+    }));
+    tcp.setup(TCP_PORT);
+    tcp.start();
+    UNITY_BEGIN();
+    RUN_TEST(test_worker_dedicated);
+    RUN_TEST(test_single);
+    RUN_TEST(test_batch);
+    RUN_TEST(test_batch_correlation_id);
+    RUN_TEST(test_batch_chunks);
+    RUN_TEST(test_batch_binary);
+    RUN_TEST(test_batch_too_long);
+    RUN_TEST(test_init_pages);
+    RUN_TEST(test_connect_to_ready);
+    RUN_TEST(test_tcp_same_replies);
+    RUN_TEST(test_tcp_framing);
+    RUN_TEST(test_tcp_clients);
+    RUN_TEST(test_tcp_connect_to_ready);
+    return UNITY_END();
+}
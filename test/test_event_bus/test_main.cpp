@@ -0,0 +1,58 @@
+// EventBus on the host: the first subscription starts the library bus, which
+// delivers the events in its own task, scheduled by the virtual clock
+#include <unity.h>
+
+#include "atoll_event_bus.h"
+
+using namespace Atoll;
+
+static float received = 0;
+static uint32_t receivedCount = 0;
+
+static void onEvent(const EventBus::Event &event, void *arg) {
+    received = event.value;
+    receivedCount++;
+}
+
+void setUp() {
+    Host::useVirtualClock(true);
+}
+
+void tearDown() {
+    Host::useVirtualClock(false);
+}
+
+void test_subscribe_starts_the_bus() {
+    TEST_ASSERT_NULL(EventBus::instance);
+    TEST_ASSERT_TRUE(EventBus::subscribe(EventBus::topicBit(EventBus::CADENCE), onEvent));
+    TEST_ASSERT_NOT_NULL(EventBus::instance);
+    TEST_ASSERT_TRUE(EventBus::instance->taskRunning());
+    TEST_ASSERT_TRUE(EventBus::publish(EventBus::CADENCE, 90));
+    Host::advance(5);
+    TEST_ASSERT_EQUAL(1, receivedCount);
+    TEST_ASSERT_EQUAL_FLOAT(90, received);
+}
+
+// the rings have a single consumer: no second bus while the library bus runs
+void test_second_bus_not_started() {
+    EventBus *running = EventBus::instance;
+    EventBus bus;
+    bus.taskStart();
+    TEST_ASSERT_FALSE(bus.taskRunning());
+    TEST_ASSERT_EQUAL_PTR(running, EventBus::instance);
+    // and subscribing again does not start another one
+    TEST_ASSERT_TRUE(EventBus::subscribe(EventBus::topicBit(EventBus::POWER), onEvent));
+    TEST_ASSERT_EQUAL_PTR(running, EventBus::instance);
+    TEST_ASSERT_TRUE(EventBus::publish(EventBus::POWER, 250));
+    Host::advance(5);
+    TEST_ASSERT_EQUAL(2, receivedCount);
+    TEST_ASSERT_EQUAL_FLOAT(250, received);
+    EventBus::unsubscribe(onEvent);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_subscribe_starts_the_bus);
+    RUN_TEST(test_second_bus_not_started);
+    return UNITY_END();
+}
@@ -0,0 +1,19 @@
+// Sample JK BMS responses, 300 bytes each with a valid checksum:
+// 0-1 device info, 2-3 settings, 4-10 cell info
+#pragma once
+
+#include <stdint.h>
+
+static const uint8_t frames[][300] = {
+{85,170,235,144,3,231,74,75,45,66,50,65,49,54,83,0,0,0,0,0,0,0,51,46,48,0,0,0,0,0,51,46,51,46,48,0,0,0,16,142,50,2,19,0,0,0,66,77,83,0,0,0,0,0,0,0,0,0,0,0,0,0,49,50,51,52,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,169},
+{85,170,235,144,3,159,74,75,45,66,50,65,50,52,83,49,53,80,0,0,0,0,49,48,46,88,87,0,0,0,49,48,46,48,55,0,0,0,64,175,1,0,6,0,0,0,74,75,45,66,50,65,50,52,83,49,53,80,0,0,0,0,49,50,51,52,0,0,0,0,0,0,0,0,0,0,0,0,50,50,48,52,48,55,0,0,50,48,50,49,54,48,50,48,57,54,0,48,48,48,48,0,73,110,112,117,116,32,85,115,101,114,100,97,116,97,0,0,49,50,51,52,53,54,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,101},
+{85,170,235,144,1,79,88,2,0,0,84,11,0,0,128,12,0,0,204,16,0,0,104,16,0,0,10,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,240,10,0,0,168,97,0,0,30,0,0,0,60,0,0,0,240,73,2,0,44,1,0,0,60,0,0,0,60,0,0,0,208,7,0,0,188,2,0,0,88,2,0,0,188,2,0,0,88,2,0,0,56,255,255,255,156,255,255,255,132,3,0,0,188,2,0,0,13,0,0,0,1,0,0,0,1,0,0,0,1,0,0,0,136,19,0,0,220,5,0,0,228,12,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,64},
+{85,170,235,144,1,80,0,0,128,63,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,16,0,0,0,0,0,64,64,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,163,253,64,64,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,136,64,154,153,89,64,10,215,163,59,0,0,0,64,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,206},
+{85,170,235,144,2,140,255,12,1,13,1,13,255,12,1,13,1,13,255,12,1,13,1,13,1,13,1,13,255,12,1,13,1,13,1,13,1,13,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,255,255,0,0,0,13,0,0,0,0,157,1,150,1,140,1,135,1,132,1,132,1,131,1,132,1,133,1,129,1,131,1,134,1,130,1,130,1,131,1,133,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,3,208,0,0,0,0,0,0,0,0,0,0,190,0,191,0,210,0,0,0,0,0,0,84,142,11,1,0,104,60,1,0,0,0,0,0,61,4,0,0,100,0,121,4,202,3,16,0,1,1,170,6,0,0,0,0,0,0,0,0,0,0,0,0,7,0,1,0,0,0,213,2,0,0,0,0,174,214,59,64,0,0,0,0,88,170,253,255,0,0,0,1,0,2,0,0,236,230,79,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,205},
+{85,170,235,144,2,141,255,12,1,13,1,13,1,13,1,13,1,13,255,12,1,13,1,13,1,13,255,12,255,12,1,13,1,13,1,13,1,13,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,255,255,0,0,0,13,0,0,0,0,157,1,150,1,140,1,135,1,132,1,132,1,131,1,132,1,133,1,129,1,131,1,134,1,130,1,130,1,131,1,133,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,208,0,0,0,0,0,0,0,0,0,0,190,0,191,0,210,0,0,0,0,0,0,84,142,11,1,0,104,60,1,0,0,0,0,0,61,4,0,0,100,0,121,4,202,3,16,0,1,1,170,6,0,0,0,0,0,0,0,0,0,0,0,0,7,0,1,0,0,0,213,2,0,0,0,0,174,214,59,64,0,0,0,0,88,170,253,255,0,0,0,1,0,2,0,0,240,230,79,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,211},
+{85,170,235,144,2,142,255,12,1,13,1,13,255,12,1,13,1,13,255,12,1,13,1,13,1,13,255,12,255,12,1,13,1,13,1,13,1,13,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,255,255,0,0,0,13,0,0,0,0,157,1,150,1,140,1,135,1,132,1,132,1,131,1,132,1,133,1,129,1,131,1,134,1,130,1,130,1,131,1,133,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,208,0,0,0,0,0,0,0,0,0,0,190,0,191,0,210,0,0,0,0,0,0,84,142,11,1,0,104,60,1,0,0,0,0,0,61,4,0,0,100,0,121,4,202,3,16,0,1,1,170,6,0,0,0,0,0,0,0,0,0,0,0,0,7,0,1,0,0,0,213,2,0,0,0,0,174,214,59,64,0,0,0,0,88,170,253,255,0,0,0,1,0,2,0,0,245,230,79,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,214},
+{85,170,235,144,2,145,255,12,255,12,1,13,255,12,1,13,1,13,255,12,1,13,1,13,1,13,1,13,255,12,1,13,1,13,1,13,1,13,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,255,255,0,0,0,13,0,0,0,0,157,1,150,1,140,1,135,1,132,1,132,1,131,1,132,1,133,1,129,1,131,1,134,1,130,1,130,1,131,1,133,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1,208,0,0,0,0,0,0,0,0,0,0,191,0,192,0,210,0,0,0,0,0,0,84,142,11,1,0,104,60,1,0,0,0,0,0,61,4,0,0,100,0,121,4,204,3,16,0,1,1,170,6,0,0,0,0,0,0,0,0,0,0,0,0,7,0,1,0,0,0,213,2,0,0,0,0,174,214,59,64,0,0,0,0,88,170,253,255,0,0,0,1,0,2,0,0,1,231,79,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,231},
+{85,170,235,144,2,146,1,13,1,13,1,13,1,13,1,13,1,13,255,12,1,13,1,13,1,13,1,13,255,12,1,13,1,13,1,13,1,13,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,255,255,0,0,0,13,0,0,0,0,157,1,150,1,140,1,135,1,132,1,132,1,131,1,132,1,133,1,129,1,131,1,134,1,130,1,130,1,131,1,133,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,3,208,0,0,0,0,0,0,0,0,0,0,191,0,192,0,210,0,0,0,0,0,0,84,142,11,1,0,104,60,1,0,0,0,0,0,61,4,0,0,100,0,121,4,204,3,16,0,1,1,170,6,0,0,0,0,0,0,0,0,0,0,0,0,7,0,1,0,0,0,213,2,0,0,0,0,174,214,59,64,0,0,0,0,88,170,253,255,0,0,0,1,0,2,0,0,6,231,79,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,248},
+{85,170,235,144,2,147,255,12,1,13,1,13,1,13,1,13,1,13,255,12,1,13,1,13,1,13,255,12,255,12,1,13,1,13,1,13,1,13,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,255,255,0,0,0,13,0,0,0,0,157,1,150,1,140,1,135,1,132,1,132,1,131,1,132,1,133,1,129,1,131,1,134,1,130,1,130,1,131,1,133,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,4,208,0,0,0,0,0,0,0,0,0,0,190,0,192,0,210,0,0,0,0,0,0,84,142,11,1,0,104,60,1,0,0,0,0,0,61,4,0,0,100,0,121,4,205,3,16,0,1,1,170,6,0,0,0,0,0,0,0,0,0,0,0,0,7,0,1,0,0,0,213,2,0,0,0,0,174,214,59,64,0,0,0,0,88,170,253,255,0,0,0,1,0,2,0,0,10,231,79,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,248},
+{85,170,235,144,2,75,192,97,86,64,31,170,86,64,255,145,86,64,255,145,86,64,31,170,86,64,255,145,86,64,255,145,86,64,255,145,86,64,31,170,86,64,255,145,86,64,255,145,86,64,255,145,86,64,255,145,86,64,31,170,86,64,224,121,86,64,224,121,86,64,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,124,29,35,62,27,235,8,62,86,206,20,62,77,155,21,62,224,219,205,61,114,51,205,61,148,136,1,62,94,30,234,61,229,23,205,61,227,187,215,61,245,68,210,61,190,124,1,62,39,182,0,62,218,181,252,61,107,81,248,61,162,147,243,61,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,3,149,86,64,0,190,144,59,0,0,0,0,255,255,0,0,1,0,0,1,0,0,0,0,0,0,0,0,0,0,0,102,160,210,74,64,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,83,150,28,0,0,0,0,0,0,72,34,64,0,19},
+};
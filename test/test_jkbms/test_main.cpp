@@ -0,0 +1,237 @@
+// JK BMS: frame assembly and decoding of the sample responses, the error
+// strings, a bounded fuzz of the assembler and the cost per frame.
+#include <unity.h>
+
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <random>
+
+#include "atoll_peer_characteristic_jkbms.h"
+#include "frames.h"
+
+using namespace Atoll;
+
+#define FRAMES (sizeof(frames) / sizeof(frames[0]))
+#define FUZZ_RUNS 200000
+#define BENCH_FRAMES 200000
+
+// counts the allocations of the whole program
+static std::atomic<long> allocations{0};
+
+void *operator new(size_t size) {
+    allocations++;
+    void *p = malloc(0 == size ? 1 : size);
+    if (nullptr == p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+class JkBmsTest : public PeerCharacteristicJkBms {
+   public:
+    JkBmsTest() { cellInfoMinDelay = 0; }
+
+    void feed(const uint8_t *data, size_t length) { assemble(data, length); }
+
+    // in the chunks of a 128 byte MTU
+    void feedChunks(const uint8_t *frame) {
+        feed(frame, 128);
+        feed(frame + 128, 128);
+        feed(frame + 256, 44);
+    }
+
+    void setCellInfoMinDelay(uint32_t delay) { cellInfoMinDelay = delay; }
+};
+
+static void setErrorMask(uint8_t *frame, uint16_t mask) {
+    frame[136] = mask >> 8;
+    frame[137] = mask;
+    uint8_t crc = 0;
+    for (int i = 0; i < 299; i++) crc += frame[i];
+    frame[299] = crc;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_device_info() {
+    JkBmsTest bms;
+    bms.feedChunks(frames[0]);
+    TEST_ASSERT_EQUAL_STRING("JK-B2A16S", bms.deviceInfo.vendorId);
+    TEST_ASSERT_EQUAL_STRING("3.0", bms.deviceInfo.hardwareVersion);
+    TEST_ASSERT_EQUAL_STRING("3.3.0", bms.deviceInfo.softwareVersion);
+    TEST_ASSERT_EQUAL(36867600, bms.deviceInfo.uptime);
+    TEST_ASSERT_EQUAL(19, bms.deviceInfo.powerOnCount);
+    TEST_ASSERT_EQUAL_STRING("BMS", bms.deviceInfo.deviceName);
+    TEST_ASSERT_EQUAL_STRING("1234", bms.deviceInfo.devicePasscode);
+    bms.feedChunks(frames[1]);
+    TEST_ASSERT_EQUAL_STRING("JK-B2A24S15P", bms.deviceInfo.vendorId);
+    TEST_ASSERT_EQUAL_STRING("10.XW", bms.deviceInfo.hardwareVersion);
+    TEST_ASSERT_EQUAL_STRING("10.07", bms.deviceInfo.softwareVersion);
+    TEST_ASSERT_EQUAL(110400, bms.deviceInfo.uptime);
+    TEST_ASSERT_EQUAL(6, bms.deviceInfo.powerOnCount);
+    TEST_ASSERT_EQUAL_STRING("JK-B2A24S15P", bms.deviceInfo.deviceName);
+    TEST_ASSERT_EQUAL_STRING("220407", bms.deviceInfo.manufacturingDate);
+    TEST_ASSERT_EQUAL_STRING("2021602096", bms.deviceInfo.serialNumber);
+    TEST_ASSERT_EQUAL_STRING("0000", bms.deviceInfo.passcode);
+    TEST_ASSERT_EQUAL_STRING("Input Userdata", bms.deviceInfo.userData);
+    TEST_ASSERT_EQUAL_STRING("123456", bms.deviceInfo.setupPasscode);
+}
+
+void test_settings() {
+    JkBmsTest bms;
+    bms.feedChunks(frames[2]);
+    TEST_ASSERT_FLOAT_WITHIN(0.0005f, 2.9f, bms.settings.cellUVP);
+    TEST_ASSERT_FLOAT_WITHIN(0.0005f, 4.3f, bms.settings.cellOVP);
+    TEST_ASSERT_FLOAT_WITHIN(0.0005f, 25.0f, bms.settings.maxChargeCurrent);
+    TEST_ASSERT_FLOAT_WITHIN(0.0005f, 150.0f, bms.settings.maxDischargeCurrent);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 70.0f, bms.settings.chargeOTP);
+    TEST_ASSERT_EQUAL(13, bms.settings.cellCount);
+    TEST_ASSERT_TRUE(bms.settings.chargingSwitch);
+    TEST_ASSERT_TRUE(bms.settings.dischargingSwitch);
+    TEST_ASSERT_TRUE(bms.settings.balancerSwitch);
+}
+
+void test_cell_info() {
+    JkBmsTest bms;
+    bms.feedChunks(frames[4]);
+    TEST_ASSERT_FLOAT_WITHIN(0.0005f, 53.251f, bms.cellInfo.voltage);
+    TEST_ASSERT_FLOAT_WITHIN(0.0005f, 0.0f, bms.cellInfo.chargeCurrent);
+    TEST_ASSERT_FLOAT_WITHIN(0.0005f, 3.327f, bms.cellInfo.lowestCellVoltage);
+    TEST_ASSERT_FLOAT_WITHIN(0.0005f, 3.329f, bms.cellInfo.highestCellVoltage);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 21.0f, bms.cellInfo.temp0);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 19.0f, bms.cellInfo.temp1);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 19.1f, bms.cellInfo.temp2);
+    TEST_ASSERT_EQUAL(84, bms.cellInfo.soc);
+    TEST_ASSERT_FLOAT_WITHIN(0.0005f, 68.494f, bms.cellInfo.capacityRemaining);
+    TEST_ASSERT_EQUAL(1049546, bms.cellInfo.totalRuntime);
+    TEST_ASSERT_EQUAL_STRING("", bms.cellInfo.errors);
+    bms.feedChunks(frames[9]);
+    TEST_ASSERT_FLOAT_WITHIN(0.0005f, 53.252f, bms.cellInfo.voltage);
+    TEST_ASSERT_FLOAT_WITHIN(0.05f, 19.2f, bms.cellInfo.temp2);
+    TEST_ASSERT_EQUAL(1049549, bms.cellInfo.totalRuntime);
+}
+
+// updates closer than cellInfoMinDelay are skipped
+void test_cell_info_min_delay() {
+    JkBmsTest bms;
+    bms.setCellInfoMinDelay(1000);
+    Host::useVirtualClock(true);
+    Host::advance(1000);
+    bms.feedChunks(frames[4]);
+    Host::advance(500);
+    bms.feedChunks(frames[9]);
+    TEST_ASSERT_EQUAL(1049546, bms.cellInfo.totalRuntime);
+    Host::advance(500);
+    bms.feedChunks(frames[9]);
+    TEST_ASSERT_EQUAL(1049549, bms.cellInfo.totalRuntime);
+    Host::useVirtualClock(false);
+}
+
+// a frame with a bad checksum is dropped
+void test_checksum() {
+    JkBmsTest bms;
+    uint8_t f[300];
+    memcpy(f, frames[4], sizeof(f));
+    f[299]++;
+    bms.feedChunks(f);
+    TEST_ASSERT_EQUAL(0, bms.cellInfo.soc);
+}
+
+void test_errors() {
+    static JkBmsTest bms;
+    uint8_t f[300];
+    memcpy(f, frames[9], sizeof(f));
+    struct {
+        uint16_t mask;
+        const char *expected;
+    } cases[] = {
+        {0x0000, ""},
+        {0x0001, "Charge Overtemperature"},
+        {0x0008, "Cell Undervoltage"},
+        {0x1400, "Cell count is not equal to settings, Cell Overvoltage"},
+        {0x0408, "Cell Undervoltage, Cell count is not equal to settings"},
+        {0xffff,
+         "Charge Overtemperature, Charge Undertemperature, Error 0x00 0x04, Cell Undervoltage, "
+         "Error 0x00 0x10, Error 0x00 0x20, Error 0x00 0x40, Error 0x00 0x80, Error 0x01 0x00, "
+         "Error 0x02 0x00, Cell count is not equal to settings, Current sensor anomaly, "
+         "Cell Overvoltage, Error 0x20 0x00, Charge overcurrent protection, Error 0x80 0x00"},
+    };
+    for (auto &c : cases) {
+        setErrorMask(f, c.mask);
+        bms.feed(f, sizeof(f));
+        TEST_ASSERT_EQUAL_STRING(c.expected, bms.cellInfo.errors);
+    }
+}
+
+// random data, mutated frames with and without a fixed checksum, chunked
+// and truncated, must not crash or overrun the frame buffer
+void test_fuzz() {
+    static JkBmsTest bms;
+    std::mt19937 rng(7);
+    uint8_t buf[400];
+    for (uint32_t n = 0; n < FUZZ_RUNS; n++) {
+        size_t length = rng() % sizeof(buf) + 1;
+        int mode = rng() % 3;
+        if (0 == mode) {
+            for (size_t i = 0; i < length; i++) buf[i] = rng();
+        } else {
+            memcpy(buf, frames[rng() % FRAMES], 300);
+            if (300 < length) length = 300;
+            int flips = rng() % 8;
+            for (int k = 0; k < flips; k++) buf[rng() % 300] = rng();
+            if (rng() % 2) {
+                buf[4] = 1 + rng() % 3;
+                uint8_t crc = 0;
+                for (int i = 0; i < 299; i++) crc += buf[i];
+                buf[299] = crc;
+            }
+        }
+        if (2 == mode) {
+            size_t offset = 0;
+            while (offset < length) {
+                size_t chunk = 1 + rng() % 64;
+                if (length < offset + chunk) chunk = length - offset;
+                bms.feed(buf + offset, chunk);
+                offset += chunk;
+            }
+        } else
+            bms.feed(buf, length);
+    }
+    // still in sync
+    bms.feedChunks(frames[4]);
+    TEST_ASSERT_EQUAL(84, bms.cellInfo.soc);
+}
+
+// decoding does not allocate
+void test_benchmark() {
+    static JkBmsTest bms;
+    long before = allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t n = 0; n < BENCH_FRAMES; n++) bms.feedChunks(frames[n % FRAMES]);
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    TEST_ASSERT_EQUAL(0, allocations - before);
+    char msg[64];
+    snprintf(msg, sizeof(msg), "%.0f ns/frame", ns / BENCH_FRAMES);
+    TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_device_info);
+    RUN_TEST(test_settings);
+    RUN_TEST(test_cell_info);
+    RUN_TEST(test_cell_info_min_delay);
+    RUN_TEST(test_checksum);
+    RUN_TEST(test_errors);
+    RUN_TEST(test_fuzz);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
@@ -0,0 +1,175 @@
+// Deferred logging: formatting of the captured records, delivery by the log
+// task and the caller-side cost against the synchronous path.
+// Built with ATOLL_LOG_DEFERRED, see [env:native_deferred].
+#include <unity.h>
+
+#include <chrono>
+#include <string>
+
+#include "atoll_log.h"
+
+using namespace Atoll;
+
+#define BENCH_BURSTS 20000
+
+class LogTest : public Log {
+   public:
+    typedef Log::Record Record;
+
+    static void capture(Record *r) {}
+    template <typename T, typename... Args>
+    static void capture(Record *r, T arg, Args... args) {
+        Log::capture(r, arg);
+        capture(r, args...);
+    }
+
+    template <typename... Args>
+    static void assertFormat(const char *expected, const char *format, Args... args) {
+        Record r;
+        r.format = format;
+        capture(&r, args...);
+        char buf[256];
+        Log::format(&r, buf, sizeof(buf));
+        TEST_ASSERT_EQUAL_STRING(expected, buf);
+    }
+
+    // defer() queues without a running task, flush() is called by the test
+    static void setDeferred(bool running) { deferredRunning = running; }
+};
+
+static std::string output;
+static uint32_t messages = 0;
+
+void setUp() {
+    output.clear();
+    messages = 0;
+}
+
+void tearDown() {
+    LogTest::setDeferred(false);
+}
+
+void test_format() {
+    LogTest::assertFormat("x=-7 y=3.14 s='str' c=A h=ff %",
+                          "x=%d y=%.2f s='%s' c=%c h=%x %%", -7, 3.14159f, "str", 'A', 255u);
+    LogTest::assertFormat("[  1234] 18446744073709551615 -9223372036854775807",
+                          "[%6lu] %llu %lld", 1234ul, UINT64_MAX, -INT64_MAX);
+    LogTest::assertFormat("|  42|42  |   abc|", "|%*d|%-4d|%6s|", 4, 42, 42, "abc");
+    LogTest::assertFormat("(null) 1.5e+00", "%s %.1e", (const char *)nullptr, 1.5);
+    // missing arguments are printed as '?'
+    LogTest::assertFormat("1 ?", "%d %s", 1);
+}
+
+void test_format_truncates() {
+    LogTest::Record r;
+    r.format = "%s and more";
+    LogTest::capture(&r, "0123456789");
+    char buf[8];
+    TEST_ASSERT_EQUAL(7, Log::format(&r, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_STRING("0123456", buf);
+}
+
+void test_strings_are_copied() {
+    char name[16] = "before";
+    LogTest::setDeferred(true);
+    Log::defer(1, "name: %s\r\n", name);
+    strcpy(name, "after");
+    Log::flush();
+    TEST_ASSERT_EQUAL_STRING("name: before\r\n", output.c_str());
+}
+
+void test_prefix_not_counted() {
+    uint32_t truncated = Log::deferredStats().truncated;
+    LogTest::setDeferred(true);
+    // the four prefix arguments of log_e plus ATOLL_LOG_DEFERRED_MAX_ARGS of the caller
+    log_e("%d %d %d %d %d %d %d %d", 1, 2, 3, 4, 5, 6, 7, 8);
+    Log::flush();
+    TEST_ASSERT_EQUAL(truncated, Log::deferredStats().truncated);
+    TEST_ASSERT_NOT_NULL(strstr(output.c_str(), "(): 1 2 3 4 5 6 7 8\r\n"));
+    // one more does not fit, the truncation is reported by the log task
+    output.clear();
+    log_e("%d %d %d %d %d %d %d %d %d", 1, 2, 3, 4, 5, 6, 7, 8, 9);
+    Log::flush();
+    TEST_ASSERT_EQUAL(truncated + 1, Log::deferredStats().truncated);
+    TEST_ASSERT_NOT_NULL(strstr(output.c_str(), "(): 1 2 3 4 5 6 7 8 ?\r\n"));
+    TEST_ASSERT_NOT_NULL(strstr(output.c_str(), "[Log] 1 message truncated\r\n"));
+}
+
+void test_full_queue() {
+    LogTest::setDeferred(true);
+    uint32_t dropped = Log::deferredStats().dropped;
+    for (int i = 0; i < ATOLL_LOG_DEFERRED_QUEUE_LENGTH + 3; i++)
+        Log::defer(1, "%d\r\n", i);
+    TEST_ASSERT_EQUAL(dropped + 3, Log::deferredStats().dropped);
+    TEST_ASSERT_EQUAL(ATOLL_LOG_DEFERRED_QUEUE_LENGTH, Log::flush());
+    TEST_ASSERT_NOT_NULL(strstr(output.c_str(), "[Log] 3 messages dropped\r\n"));
+}
+
+// before the task is started a message logged from an ISR waits in the queue
+void test_isr() {
+    uint32_t dropped = Log::dropped();
+    Atoll::Host::setIsrContext(true);
+    log_e("isr");
+    Atoll::Host::setIsrContext(false);
+    TEST_ASSERT_EQUAL(0, messages);
+    TEST_ASSERT_EQUAL(1, Log::flush());
+    TEST_ASSERT_NOT_NULL(strstr(output.c_str(), "(): isr\r\n"));
+    TEST_ASSERT_EQUAL(dropped, Log::dropped());
+}
+
+void test_task() {
+    Log::startTask();
+    for (int i = 0; i < 10; i++) log_e("message %d", i);
+    // stopping the task writes the queued messages
+    Log::stopTask();
+    TEST_ASSERT_EQUAL(10, messages);
+    TEST_ASSERT_NOT_NULL(strstr(output.c_str(), "(): message 9\r\n"));
+    // synchronous again
+    log_e("sync");
+    TEST_ASSERT_EQUAL(11, messages);
+}
+
+// Caller-side cost of a typical call with the prefix and three arguments.
+// The deferred path is measured in bursts that fit the queue, the queue is
+// flushed between the bursts outside of the measurement.
+void test_benchmark() {
+    double syncNs = 0, deferredNs = 0;
+    char name[] = "Peer";
+    for (int i = 0; i < BENCH_BURSTS; i++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int j = 0; j < ATOLL_LOG_DEFERRED_QUEUE_LENGTH; j++)
+            log_e("%s value %d %.2f", name, j, 1.5);
+        syncNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    }
+    LogTest::setDeferred(true);
+    for (int i = 0; i < BENCH_BURSTS; i++) {
+        auto start = std::chrono::steady_clock::now();
+        for (int j = 0; j < ATOLL_LOG_DEFERRED_QUEUE_LENGTH; j++)
+            log_e("%s value %d %.2f", name, j, 1.5);
+        deferredNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        Log::flush();
+    }
+    uint32_t calls = BENCH_BURSTS * ATOLL_LOG_DEFERRED_QUEUE_LENGTH;
+    TEST_ASSERT_EQUAL(2 * calls, messages);
+    char msg[96];
+    snprintf(msg, sizeof(msg), "caller cost: synchronous %.0f ns/call, deferred %.0f ns/call",
+             syncNs / calls, deferredNs / calls);
+    TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv) {
+    Log::addSink([](const char *buf, size_t size) {
+        output.append(buf, size);
+        messages++;
+    });
+    UNITY_BEGIN();
+    RUN_TEST(test_format);
+    RUN_TEST(test_format_truncates);
+    RUN_TEST(test_strings_are_copied);
+    RUN_TEST(test_prefix_not_counted);
+    RUN_TEST(test_full_queue);
+    RUN_TEST(test_isr);
+    RUN_TEST(test_task);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
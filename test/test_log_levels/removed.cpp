@@ -0,0 +1,22 @@
+// A module built with a lower local level than the test, its debug logs are
+// removed by the preprocessor.
+#define ATOLL_LOG_TAG "Removed"
+#define ATOLL_LOG_LOCAL_LEVEL 1
+#include "atoll_log.h"
+
+#include "removed.h"
+
+void removedDebug(int (*argument)()) {
+    log_d("%d", argument());
+}
+
+void removedError(int (*argument)()) {
+    log_e("%d", argument());
+}
+
+void removedLoop(volatile int *sink, int count) {
+    for (int i = 0; i < count; i++) {
+        *sink = i;
+        log_d("x %d %f", i * 3 + 1, (double)i);
+    }
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+// log_d and log_e from a translation unit with ATOLL_LOG_LOCAL_LEVEL 1
+void removedDebug(int (*argument)());
+void removedError(int (*argument)());
+// count iterations of a loop with a removed log_d
+void removedLoop(volatile int *sink, int count);
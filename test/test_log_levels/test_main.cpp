@@ -0,0 +1,209 @@
+// Log levels: runtime levels of the tags, parsing and printing of the level
+// string, compile time removal, dropped messages and the cost of a filtered call.
+#define ATOLL_LOG_TAG "Levels"
+#define ATOLL_LOG_LOCAL_LEVEL 4
+#include <unity.h>
+
+#include <chrono>
+#include <string>
+
+#include "atoll_log.h"
+#include "removed.h"
+
+using namespace Atoll;
+
+#define BENCH_CALLS 20000000
+
+static uint32_t messages = 0;
+static std::string output;
+static bool sinkLogs = false;  // the sink logs once, while the log is busy
+static int evaluated = 0;
+static volatile int sink = 0;
+
+static int argument() {
+    return ++evaluated;
+}
+
+void setUp() {
+    Log::removeTagLevel("*");
+    Log::setLevel(1);
+    messages = 0;
+    output.clear();
+    evaluated = 0;
+}
+
+void tearDown() {}
+
+static const char *levels() {
+    static char buf[128];
+    Log::levelsToStr(buf, sizeof(buf));
+    return buf;
+}
+
+void test_tag_level() {
+    log_d("hidden");
+    log_e("shown");
+    TEST_ASSERT_EQUAL(1, messages);
+    TEST_ASSERT_TRUE(Log::setTagLevel("Levels", 4));
+    TEST_ASSERT_EQUAL(4, Log::tagLevel("Levels"));
+    TEST_ASSERT_EQUAL(1, Log::tagLevel("Other"));
+    log_d("shown");
+    log_i("shown");
+    TEST_ASSERT_EQUAL(3, messages);
+    // the cache of the translation unit is refreshed on the next call
+    Log::removeTagLevel("Levels");
+    log_d("hidden");
+    TEST_ASSERT_EQUAL(3, messages);
+    // the tag level overrides the global level in both directions
+    Log::setLevel(4);
+    TEST_ASSERT_TRUE(Log::setTagLevel("Levels", 0));
+    log_e("hidden");
+    TEST_ASSERT_EQUAL(3, messages);
+    TEST_ASSERT_FALSE(Log::setTagLevel("", 1));
+    TEST_ASSERT_FALSE(Log::setTagLevel("NameLongerThan15", 1));
+}
+
+void test_max_tags() {
+    char tag[8];
+    for (int i = 0; i < ATOLL_LOG_MAX_TAGS; i++) {
+        snprintf(tag, sizeof(tag), "Tag%d", i);
+        TEST_ASSERT_TRUE(Log::setTagLevel(tag, 2));
+    }
+    TEST_ASSERT_FALSE(Log::setTagLevel("OneMore", 2));
+    // existing tags can still be changed
+    TEST_ASSERT_TRUE(Log::setTagLevel("Tag0", 3));
+    TEST_ASSERT_EQUAL(3, Log::tagLevel("Tag0"));
+}
+
+void test_levels_str() {
+    TEST_ASSERT_EQUAL_STRING("*:1", levels());
+    TEST_ASSERT_TRUE(Log::levelsFromStr("Levels:4,Other:2"));
+    TEST_ASSERT_EQUAL_STRING("*:1,Levels:4,Other:2", levels());
+    TEST_ASSERT_TRUE(Log::levelsFromStr("-Levels,*:3"));
+    TEST_ASSERT_EQUAL_STRING("*:3,Other:2", levels());
+    TEST_ASSERT_TRUE(Log::levelsFromStr("-*"));
+    TEST_ASSERT_EQUAL_STRING("*:3", levels());
+}
+
+void test_levels_str_invalid() {
+    TEST_ASSERT_TRUE(Log::levelsFromStr("Levels:4"));
+    const char *invalid[] = {
+        "Levels:9",
+        "Levels",
+        "Levels:",
+        "Levels:44",
+        "a:1,",
+        ",a:1",
+        "a b:1",
+        "-Levels:1",
+        "NameLongerThan15:1",
+        "Other:2,Bad",  // the valid entry is not applied either
+    };
+    for (const char *str : invalid) {
+        TEST_ASSERT_FALSE_MESSAGE(Log::levelsFromStr(str), str);
+        TEST_ASSERT_EQUAL_STRING_MESSAGE("*:1,Levels:4", levels(), str);
+    }
+    TEST_ASSERT_FALSE(Log::levelsFromStr(nullptr));
+}
+
+// the arguments of the calls removed by the preprocessor are not evaluated,
+// whatever the runtime level
+void test_compile_time_removed() {
+    TEST_ASSERT_TRUE(Log::setTagLevel("Removed", 5));
+    removedDebug(argument);
+    TEST_ASSERT_EQUAL(0, evaluated);
+    TEST_ASSERT_EQUAL(0, messages);
+    removedError(argument);
+    TEST_ASSERT_EQUAL(1, evaluated);
+    TEST_ASSERT_EQUAL(1, messages);
+    // filtered at runtime: not written, the arguments are not evaluated either
+    TEST_ASSERT_TRUE(Log::setTagLevel("Removed", 0));
+    removedError(argument);
+    TEST_ASSERT_EQUAL(1, evaluated);
+    TEST_ASSERT_EQUAL(1, messages);
+}
+
+// messages that could not be written are counted and reported with the next one
+void test_dropped() {
+    uint32_t dropped = Log::dropped();
+    // the sink is called with the log mutex held, its message is reported
+    // right after the one being written
+    sinkLogs = true;
+    log_e("busy");
+    TEST_ASSERT_EQUAL(dropped + 1, Log::dropped());
+    TEST_ASSERT_EQUAL(2, messages);
+    TEST_ASSERT_NOT_NULL(strstr(output.c_str(), "(): busy\r\n[Log] 1 message not written\r\n"));
+    // an ISR never waits for the mutex
+    Atoll::Host::setIsrContext(true);
+    log_e("isr");
+    Atoll::Host::setIsrContext(false);
+    TEST_ASSERT_EQUAL(2, messages);
+    TEST_ASSERT_EQUAL(dropped + 2, Log::dropped());
+    output.clear();
+    log_e("next");
+    TEST_ASSERT_EQUAL(4, messages);
+    TEST_ASSERT_NOT_NULL(strstr(output.c_str(), "(): next\r\n[Log] 1 message not written\r\n"));
+    log_e("reported once");
+    TEST_ASSERT_EQUAL(5, messages);
+}
+
+// a call checking the level after the call is made, as log_* did before the
+// levels were checked in the macros
+__attribute__((noinline)) static void checkedInside(uint8_t level, const char *format, ...) {
+    if (Log::getLevel() < level) return;
+    sink = sink + 1;
+}
+
+template <typename F>
+static double nsPerCall(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() /
+           BENCH_CALLS;
+}
+
+void test_benchmark() {
+    double loop = nsPerCall([]() {
+        for (int i = 0; i < BENCH_CALLS; i++) sink = i;
+    });
+    double inside = nsPerCall([]() {
+        for (int i = 0; i < BENCH_CALLS; i++) {
+            sink = i;
+            checkedInside(ARDUHAL_LOG_LEVEL_DEBUG, "x %d %f", i * 3 + 1, (double)i);
+        }
+    });
+    double runtime = nsPerCall([]() {
+        for (int i = 0; i < BENCH_CALLS; i++) {
+            sink = i;
+            log_d("x %d %f", i * 3 + 1, (double)i);
+        }
+    });
+    double removed = nsPerCall([]() { removedLoop(&sink, BENCH_CALLS); });
+    TEST_ASSERT_EQUAL(0, messages);
+    char msg[160];
+    snprintf(msg, sizeof(msg),
+             "filtered log_d: checked inside the call +%.2f ns, runtime level +%.2f ns, "
+             "compile time removed +%.2f ns (loop %.2f ns)",
+             inside - loop, runtime - loop, removed - loop, loop);
+    TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv) {
+    Log::addSink([](const char *buf, size_t size) {
+        messages++;
+        output.append(buf, size);
+        if (sinkLogs) {
+            sinkLogs = false;
+            log_e("from the sink");
+        }
+    });
+    UNITY_BEGIN();
+    RUN_TEST(test_tag_level);
+    RUN_TEST(test_max_tags);
+    RUN_TEST(test_levels_str);
+    RUN_TEST(test_levels_str_invalid);
+    RUN_TEST(test_compile_time_removed);
+    RUN_TEST(test_dropped);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
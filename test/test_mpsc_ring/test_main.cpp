@@ -0,0 +1,117 @@
+// MpscRing: order, full ring accounting and a multithreaded stress test
+#include <unity.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "atoll_mpsc_ring.h"
+
+using namespace Atoll;
+
+#define STRESS_PRODUCERS 4
+#define STRESS_ITEMS 200000  // per producer
+
+struct Item {
+    uint32_t producer;
+    uint32_t seq;
+    char payload[120];  // the size of a log record
+};
+
+void setUp() {}
+void tearDown() {}
+
+void test_fifo() {
+    MpscRing<uint32_t, 8> ring;
+    uint32_t v;
+    TEST_ASSERT_FALSE(ring.pop(&v));
+    for (uint32_t round = 0; round < 5; round++) {
+        for (uint32_t i = 0; i < 5; i++) TEST_ASSERT_TRUE(ring.push(round * 10 + i));
+        TEST_ASSERT_EQUAL(5, ring.size());
+        for (uint32_t i = 0; i < 5; i++) {
+            TEST_ASSERT_TRUE(ring.pop(&v));
+            TEST_ASSERT_EQUAL(round * 10 + i, v);
+        }
+        TEST_ASSERT_FALSE(ring.pop(&v));
+    }
+    TEST_ASSERT_EQUAL(25, ring.pushed());
+    TEST_ASSERT_EQUAL(0, ring.dropped());
+}
+
+void test_full() {
+    MpscRing<uint32_t, 4> ring;
+    for (uint32_t i = 0; i < 4; i++) TEST_ASSERT_TRUE(ring.push(i));
+    TEST_ASSERT_FALSE(ring.push(4));
+    TEST_ASSERT_FALSE(ring.push(5));
+    TEST_ASSERT_EQUAL(4, ring.pushed());
+    TEST_ASSERT_EQUAL(2, ring.dropped());
+    // the oldest items are kept, the new ones are dropped
+    uint32_t v;
+    TEST_ASSERT_TRUE(ring.pop(&v));
+    TEST_ASSERT_EQUAL(0, v);
+    TEST_ASSERT_TRUE(ring.push(6));
+    for (uint32_t expected : {1, 2, 3, 6}) {
+        TEST_ASSERT_TRUE(ring.pop(&v));
+        TEST_ASSERT_EQUAL(expected, v);
+    }
+    TEST_ASSERT_FALSE(ring.pop(&v));
+}
+
+static MpscRing<Item, 64> stressRing;
+
+// producers retry when the ring is full, every item must arrive once and in
+// the order of its producer
+void test_stress() {
+    std::atomic<bool> done{false};
+    uint32_t last[STRESS_PRODUCERS] = {};
+    uint64_t popped = 0;
+    bool ordered = true;
+    auto start = std::chrono::steady_clock::now();
+    std::thread consumer([&]() {
+        Item item;
+        for (;;) {
+            if (stressRing.pop(&item)) {
+                popped++;
+                if (item.seq != last[item.producer] + 1) ordered = false;
+                last[item.producer] = item.seq;
+            } else if (done) {
+                if (!stressRing.pop(&item)) break;
+                popped++;
+                if (item.seq != last[item.producer] + 1) ordered = false;
+                last[item.producer] = item.seq;
+            } else
+                std::this_thread::yield();
+        }
+    });
+    std::vector<std::thread> producers;
+    for (uint32_t p = 0; p < STRESS_PRODUCERS; p++)
+        producers.emplace_back([p]() {
+            Item item;
+            item.producer = p;
+            for (uint32_t i = 1; i <= STRESS_ITEMS; i++) {
+                item.seq = i;
+                while (!stressRing.push(item)) std::this_thread::yield();
+            }
+        });
+    for (auto &t : producers) t.join();
+    done = true;
+    consumer.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    TEST_ASSERT_TRUE(ordered);
+    TEST_ASSERT_EQUAL(STRESS_PRODUCERS * STRESS_ITEMS, popped);
+    TEST_ASSERT_EQUAL(STRESS_PRODUCERS * STRESS_ITEMS, stressRing.pushed());
+    for (uint32_t p = 0; p < STRESS_PRODUCERS; p++) TEST_ASSERT_EQUAL(STRESS_ITEMS, last[p]);
+    char msg[128];
+    snprintf(msg, sizeof(msg), "%d producers: %.1fM pushes/s, %u full ring rejections",
+             STRESS_PRODUCERS, popped / seconds / 1e6, stressRing.dropped());
+    TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_fifo);
+    RUN_TEST(test_full);
+    RUN_TEST(test_stress);
+    return UNITY_END();
+}
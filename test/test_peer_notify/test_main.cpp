@@ -0,0 +1,273 @@
+// Peer notifications dispatched by handle and the remote chars cached per
+// connection, against the simulated remote device of the NimBLE host shim,
+// the Database Hash saved by BleClient, the time to the first notification
+// with and without attribute discovery, and a micro-benchmark of the lookups
+// on the notification path.
+#include <unity.h>
+
+#include <chrono>
+
+#include "atoll_ble_client.h"
+#include "atoll_peer.h"
+
+using namespace Atoll;
+
+#define BENCH_CALLS 2000000
+#define REMOTE_SERVICES 6
+#define REMOTE_CHARS 4  // per service
+#define DISCOVERY_ROUND_TRIP 15  // ms per attribute
+
+class TestESPM : public ESPM {
+   public:
+    TestESPM(Saved saved) : ESPM(saved) {}
+    using Peer::discoverAttributes;
+    using Peer::forgetRemoteChars;
+};
+
+static TestESPM *peer = nullptr;
+static BLEClient *client = nullptr;
+
+static Peer::Saved saved(const char *address = "aa:bb:cc:dd:ee:01") {
+    Peer::Saved s;
+    strncpy(s.address, address, sizeof(s.address));
+    strncpy(s.type, "E", sizeof(s.type));
+    strncpy(s.name, "ESPM", sizeof(s.name));
+    return s;
+}
+
+// the services and chars of the peer plus filler ones, REMOTE_SERVICES
+// services with REMOTE_CHARS chars each, the chars of the peer last
+static void populate(BLEClient *client, Peer *peer) {
+    uint16_t filler = 0xff00;
+    for (uint8_t i = 0; i < REMOTE_SERVICES; i++) client->addService(BLEUUID(filler++));
+    for (const char *label : {"Battery", "Power", "ApiTX", "ApiRX", "Weight", "Temperature"}) {
+        PeerCharacteristic *c = peer->getChar(label);
+        if (nullptr == c) continue;
+        BLERemoteService *s = client->getService(c->serviceUuid);
+        if (nullptr == s) s = client->addService(c->serviceUuid);
+        while (s->getCharacteristics().size() < REMOTE_CHARS - 1)
+            s->addCharacteristic(BLEUUID(filler++), NIMBLE_PROPERTY::READ);
+        s->addCharacteristic(c->charUuid, NIMBLE_PROPERTY::READ | NIMBLE_PROPERTY::WRITE | NIMBLE_PROPERTY::NOTIFY);
+    }
+}
+
+static BLERemoteCharacteristic *remote(const char *label) {
+    PeerCharacteristic *c = peer->getChar(label);
+    return client->getService(c->serviceUuid)->getCharacteristic(c->charUuid);
+}
+
+// crank revolution data only, flags 0x0020
+static const uint8_t powerFrame[] = {0x20, 0x00, 0xfa, 0x00, 0x10, 0x00, 0x00, 0x04};
+
+void setUp() {
+    client = NimBLEDevice::createClient(BLEAddress(peer->saved.address));
+    populate(client, peer);
+    peer->setClient(client);
+    client->connect();
+    TEST_ASSERT_TRUE(peer->isConnected());
+    peer->subscribeChars(client);
+}
+
+void tearDown() {
+    peer->unsetClient();
+    NimBLEDevice::deleteClient(client);
+}
+
+void test_notifications_are_counted() {
+    BLERemoteCharacteristic *rc = remote("Power");
+    TEST_ASSERT_TRUE(rc->subscribed());
+    uint32_t notifications = peer->notifications;
+    for (int i = 0; i < 3; i++) TEST_ASSERT_TRUE(rc->notify(powerFrame, sizeof(powerFrame)));
+    TEST_ASSERT_EQUAL(notifications + 3, peer->notifications);
+    PeerCharacteristicPower *power = (PeerCharacteristicPower *)peer->getChar("Power");
+    TEST_ASSERT_EQUAL(250, power->lastValue);
+}
+
+// the subscribed chars are found by the value handle of their remote char
+void test_dispatch_by_handle() {
+    for (const char *label : {"Battery", "Power", "ApiTX", "Temperature"})
+        TEST_ASSERT_EQUAL_PTR(peer->getChar(label), peer->charByHandle(remote(label)->getHandle()));
+    TEST_ASSERT_NULL(peer->charByHandle(0));
+    TEST_ASSERT_NULL(peer->charByHandle(remote("Power")->getHandle() + 1));
+    // notifications of a char outside the peer are not dispatched
+    PeerCharacteristicPower *power = (PeerCharacteristicPower *)peer->getChar("Power");
+    power->lastValue = 0;
+    uint8_t frame[sizeof(powerFrame)];
+    memcpy(frame, powerFrame, sizeof(frame));
+    BLERemoteCharacteristic *other = client->getService(power->serviceUuid)->getCharacteristics()[0];
+    peer->onNotify(other, frame, sizeof(frame), true);
+    TEST_ASSERT_EQUAL(0, power->lastValue);
+    peer->onNotify(remote("Power"), frame, sizeof(frame), true);
+    TEST_ASSERT_EQUAL(250, power->lastValue);
+}
+
+// the table is dropped on disconnect, a new connection publishes a new one
+void test_handle_table_per_connection() {
+    uint16_t handle = remote("Power")->getHandle();
+    TEST_ASSERT_NOT_NULL(peer->charByHandle(handle));
+    client->disconnect();
+    TEST_ASSERT_NULL(peer->charByHandle(handle));
+    client->connect();
+    peer->subscribeChars(client);
+    TEST_ASSERT_EQUAL_PTR(peer->getChar("Power"), peer->charByHandle(handle));
+    // and before the attributes are deleted
+    peer->forgetRemoteChars();
+    TEST_ASSERT_NULL(peer->charByHandle(handle));
+}
+
+void test_remote_char_cached() {
+    PeerCharacteristic *c = peer->getChar("Temperature");
+    BLERemoteCharacteristic *rc = c->getRemoteChar(client);
+    TEST_ASSERT_NOT_NULL(rc);
+    TEST_ASSERT_EQUAL_PTR(remote("Temperature"), rc);
+    // served from the cache even if the service list changes
+    client->addService(BLEUUID((uint16_t)0xfe00));
+    TEST_ASSERT_EQUAL_PTR(rc, c->getRemoteChar(client));
+    // not while disconnected
+    client->disconnect();
+    TEST_ASSERT_NULL(c->getRemoteChar(client));
+}
+
+void test_remote_chars_forgotten() {
+    PeerCharacteristic *c = peer->getChar("Power");
+    TEST_ASSERT_NOT_NULL(c->getRemoteChar(client));
+    // the attributes are rediscovered: the cached chars must not be used
+    peer->forgetRemoteChars();
+    client->deleteServices();
+    populate(client, peer);
+    BLERemoteCharacteristic *rc = c->getRemoteChar(client);
+    TEST_ASSERT_EQUAL_PTR(remote("Power"), rc);
+    // and after unsetting the client
+    peer->unsetClient();
+    TEST_ASSERT_NULL(c->getRemoteChar(nullptr));
+    peer->setClient(client);
+}
+
+// the hash is saved by the BleClient the peer was added to and loaded with the
+// peer after a reboot
+void test_db_hash_saved() {
+    ::Preferences::clearAll();
+    ::Preferences preferences;
+    uint8_t hash[DATABASE_HASH_LENGTH];
+    for (uint8_t i = 0; i < sizeof(hash); i++) hash[i] = i + 1;
+    BLEClient *other = NimBLEDevice::createClient(BLEAddress("aa:bb:cc:dd:ee:02"));
+    {
+        BleClient bleClient;
+        bleClient.preferencesSetup(&preferences, "BleClient");
+        TestESPM *espm = new TestESPM(saved("aa:bb:cc:dd:ee:02"));  // deleted with bleClient
+        populate(other, espm);
+        BLERemoteCharacteristic *hashChar = other->addService(BLEUUID(GENERIC_ATTRIBUTE_SERVICE_UUID))
+                                                ->addCharacteristic(BLEUUID(DATABASE_HASH_CHAR_UUID), NIMBLE_PROPERTY::READ);
+        hashChar->setValue(hash, sizeof(hash));
+        TEST_ASSERT_TRUE(bleClient.addPeer(espm));
+        bleClient.saveSettings();
+        espm->setClient(other);
+        espm->connect();
+        espm->setupConnection();
+        TEST_ASSERT_EQUAL(1, espm->discoveries);
+        TEST_ASSERT_FALSE(espm->dbHashUnchanged);
+        espm->discoverAttributes(other);
+        TEST_ASSERT_TRUE(espm->dbHashUnchanged);
+        // a changed database is saved again
+        hash[0] = 0xff;
+        hashChar->setValue(hash, sizeof(hash));
+        espm->discoverAttributes(other);
+        TEST_ASSERT_FALSE(espm->dbHashUnchanged);
+    }
+    NimBLEDevice::deleteClient(other);
+
+    BleClient rebooted;
+    rebooted.preferencesSetup(&preferences, "BleClient");
+    rebooted.loadSettings();
+    Peer *loaded = rebooted.getFirstPeerByName("ESPM");
+    TEST_ASSERT_NOT_NULL(loaded);
+    uint8_t savedHash[DATABASE_HASH_LENGTH];
+    TEST_ASSERT_TRUE(loaded->getSavedDbHash(savedHash));
+    TEST_ASSERT_EQUAL_MEMORY(hash, savedHash, sizeof(hash));
+}
+
+// with DISCOVERY_ROUND_TRIP ms per discovered attribute, reusing the
+// attributes on reconnect brings the first notification forward
+void test_first_notification_time() {
+    BLERemoteCharacteristic *rc = remote("Power");
+    client->discoveryRoundTrip = DISCOVERY_ROUND_TRIP;
+    ulong time[2];
+    uint16_t discoveries = peer->discoveries;
+    for (uint8_t i = 0; i < 2; i++) {
+        client->disconnect();
+        peer->connect();
+        peer->setupConnection();
+        TEST_ASSERT_TRUE(peer->isConnected());
+        TEST_ASSERT_EQUAL(0 < i, peer->attributesCached);
+        TEST_ASSERT_EQUAL(0, peer->firstNotificationTime);
+        TEST_ASSERT_TRUE(rc->notify(powerFrame, sizeof(powerFrame)));
+        time[i] = peer->firstNotificationTime;
+    }
+    TEST_ASSERT_EQUAL(discoveries + 1, peer->discoveries);
+    TEST_ASSERT_LESS_THAN(time[0], time[1]);
+    // the attributes must not be reused with the next client
+    peer->forgetAttributes();
+
+    char msg[96];
+    snprintf(msg, sizeof(msg), "first notification after %lu ms with discovery, %lu ms with cached attributes",
+             time[0], time[1]);
+    TEST_MESSAGE(msg);
+}
+
+template <typename F>
+static double nsPerCall(F f) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCH_CALLS; i++) f(i);
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / BENCH_CALLS;
+}
+
+void test_benchmark() {
+    static volatile uintptr_t sink;
+    PeerCharacteristic *temperature = peer->getChar("Temperature");
+    PeerCharacteristicPower *power = (PeerCharacteristicPower *)peer->getChar("Power");
+    BLERemoteCharacteristic *rc = remote("Power");
+
+    double getChar = nsPerCall([](int) { sink = (uintptr_t)peer->getChar("Temperature"); });
+    double walk = nsPerCall([temperature](int) {
+        temperature->forgetRemoteChar();
+        sink = (uintptr_t)temperature->getRemoteChar(client);
+    });
+    double forget = nsPerCall([temperature](int) {
+        temperature->forgetRemoteChar();
+        sink = (uintptr_t)temperature;
+    });
+    double cached = nsPerCall([temperature](int) { sink = (uintptr_t)temperature->getRemoteChar(client); });
+    uint16_t handle = rc->getHandle();
+    double byHandle = nsPerCall([handle](int) { sink = (uintptr_t)peer->charByHandle(handle); });
+    double direct = nsPerCall([power, rc](int) { power->onNotify(rc, (uint8_t *)powerFrame, sizeof(powerFrame), true); });
+    uint32_t notifications = peer->notifications;
+    double indexed = nsPerCall([rc](int) { peer->onNotify(rc, (uint8_t *)powerFrame, sizeof(powerFrame), true); });
+    double notify = nsPerCall([rc](int) { rc->notify(powerFrame, sizeof(powerFrame)); });
+    TEST_ASSERT_EQUAL(notifications + 2 * BENCH_CALLS, peer->notifications);
+    // the last lookup stored the char
+    TEST_ASSERT_NOT_EQUAL(0, sink);
+
+    char msg[320];
+    snprintf(msg, sizeof(msg),
+             "%d services with %d chars: getChar(\"Temperature\") %.1f ns, "
+             "getRemoteChar() walk %.1f ns, cached %.1f ns, charByHandle() %.1f ns, "
+             "notification: char onNotify() %.1f ns, indexed by the peer %.1f ns, via the subscription %.1f ns",
+             (int)client->getServices().size(), REMOTE_CHARS, getChar, walk - forget, cached, byHandle,
+             direct, indexed, notify);
+    TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv) {
+    // the chars of the peer are not deleted with it, one peer for all the tests
+    peer = new TestESPM(saved());
+    UNITY_BEGIN();
+    RUN_TEST(test_notifications_are_counted);
+    RUN_TEST(test_dispatch_by_handle);
+    RUN_TEST(test_handle_table_per_connection);
+    RUN_TEST(test_remote_char_cached);
+    RUN_TEST(test_remote_chars_forgotten);
+    RUN_TEST(test_db_hash_saved);
+    RUN_TEST(test_first_notification_time);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
@@ -0,0 +1,232 @@
+// Cycling Power Measurement: parsing of every field, cadence and speed from
+// the event deltas, a bounded fuzz of the parser and the decode cost.
+#include <unity.h>
+
+#include <chrono>
+#include <random>
+
+#include "atoll_peer_characteristic_power.h"
+
+using namespace Atoll;
+
+#define FUZZ_FRAMES 1000000
+#define BENCH_CALLS 5000000
+
+typedef PeerCharacteristicPower::Measurement Measurement;
+
+// the length the flags require, from the field sizes of the spec
+static size_t requiredLength(uint16_t flags) {
+    return 4 +
+           (flags & 0x0001 ? 1 : 0) +
+           (flags & 0x0004 ? 2 : 0) +
+           (flags & 0x0010 ? 6 : 0) +
+           (flags & 0x0020 ? 4 : 0) +
+           (flags & 0x0040 ? 4 : 0) +
+           (flags & 0x0080 ? 4 : 0) +
+           (flags & 0x0100 ? 3 : 0) +
+           (flags & 0x0200 ? 2 : 0) +
+           (flags & 0x0400 ? 2 : 0) +
+           (flags & 0x0800 ? 2 : 0);
+}
+
+// a frame with the fields of flags, the crank and wheel data given
+static size_t frame(uint8_t *f, uint16_t flags, uint16_t crankRevs, uint16_t crankEvent,
+                    uint32_t wheelRevs, uint16_t wheelEvent) {
+    size_t o = 0;
+    f[o++] = flags;
+    f[o++] = flags >> 8;
+    f[o++] = 250;
+    f[o++] = 0;
+    if (flags & 0x0001) f[o++] = 100;
+    if (flags & 0x0004) {
+        f[o++] = 0x20;
+        f[o++] = 0x01;
+    }
+    if (flags & 0x0010) {
+        for (int i = 0; i < 4; i++) f[o++] = wheelRevs >> (8 * i);
+        f[o++] = wheelEvent;
+        f[o++] = wheelEvent >> 8;
+    }
+    if (flags & 0x0020) {
+        f[o++] = crankRevs;
+        f[o++] = crankRevs >> 8;
+        f[o++] = crankEvent;
+        f[o++] = crankEvent >> 8;
+    }
+    if (flags & 0x0040) {  // 300 N, -10 N
+        f[o++] = 0x2c;
+        f[o++] = 0x01;
+        f[o++] = 0xf6;
+        f[o++] = 0xff;
+    }
+    if (flags & 0x0080) {  // 1600/32 Nm, -32/32 Nm
+        f[o++] = 0x40;
+        f[o++] = 0x06;
+        f[o++] = 0xe0;
+        f[o++] = 0xff;
+    }
+    if (flags & 0x0100) {  // 90 and 260 degrees in 12 bits each
+        f[o++] = 0x5a;
+        f[o++] = 0x40;
+        f[o++] = 0x10;
+    }
+    if (flags & 0x0200) {
+        f[o++] = 10;
+        f[o++] = 0;
+    }
+    if (flags & 0x0400) {
+        f[o++] = 190;
+        f[o++] = 0;
+    }
+    if (flags & 0x0800) {
+        f[o++] = 42;
+        f[o++] = 0;
+    }
+    return o;
+}
+
+void setUp() {
+    Host::useVirtualClock(true);
+}
+
+void tearDown() {
+    Host::useVirtualClock(false);
+}
+
+void test_all_fields() {
+    uint8_t f[40];
+    size_t length = frame(f, 0x0fff, 1, 1024, 100, 2048);
+    TEST_ASSERT_EQUAL(requiredLength(0x0fff), length);
+    Measurement m;
+    TEST_ASSERT_TRUE(PeerCharacteristicPower::parse(f, length, &m));
+    TEST_ASSERT_EQUAL(250, m.power);
+    TEST_ASSERT_EQUAL(100, m.balance);
+    TEST_ASSERT_EQUAL(0x0120, m.accumulatedTorque);
+    TEST_ASSERT_EQUAL(100, m.wheelRevolutions);
+    TEST_ASSERT_EQUAL(2048, m.lastWheelEvent);
+    TEST_ASSERT_EQUAL(1, m.crankRevolutions);
+    TEST_ASSERT_EQUAL(1024, m.lastCrankEvent);
+    TEST_ASSERT_EQUAL(300, m.maxForce);
+    TEST_ASSERT_EQUAL(-10, m.minForce);
+    TEST_ASSERT_EQUAL(1600, m.maxTorque);
+    TEST_ASSERT_EQUAL(-32, m.minTorque);
+    TEST_ASSERT_EQUAL(90, m.maxAngle);
+    TEST_ASSERT_EQUAL(260, m.minAngle);
+    TEST_ASSERT_EQUAL(10, m.topDeadSpot);
+    TEST_ASSERT_EQUAL(190, m.bottomDeadSpot);
+    TEST_ASSERT_EQUAL(42, m.accumulatedEnergy);
+    // one byte short
+    TEST_ASSERT_FALSE(PeerCharacteristicPower::parse(f, length - 1, &m));
+}
+
+void test_negative_power() {
+    const uint8_t f[] = {0x00, 0x00, 0xf6, 0xff};
+    Measurement m;
+    TEST_ASSERT_TRUE(PeerCharacteristicPower::parse(f, sizeof(f), &m));
+    TEST_ASSERT_EQUAL(-10, m.power);
+    PeerCharacteristicPower p;
+    TEST_ASSERT_EQUAL(0, p.decode(f, sizeof(f)));
+}
+
+// crank at 90 rpm and wheel at 36 km/h in the layouts of common power meters:
+// crank only, balance and crank, torque, wheel and crank, every field;
+// the event times roll over during the run
+void test_layouts() {
+    for (uint16_t flags : {0x0020, 0x0021, 0x0034, 0x0fff}) {
+        PeerCharacteristicPower p;
+        uint16_t crankRevs = 65530, crankEvent = 65000, wheelEvent = 65000;
+        uint32_t wheelRevs = 100;
+        double wheelTime = 0;
+        for (int i = 0; i < 20; i++) {
+            uint8_t f[40];
+            size_t length = frame(f, flags, crankRevs, crankEvent, wheelRevs, wheelEvent);
+            Host::advance(667);
+            TEST_ASSERT_EQUAL(250, p.decode(f, length));
+            crankRevs++;
+            crankEvent += 683;  // 1024 * 60 / 90
+            wheelRevs += 3;     // 3 * 2.105 m in 0.2105 s at 36 km/h
+            wheelTime += 3 * 2.105 / 10.0 * 2048;
+            wheelEvent = 65000 + (uint16_t)wheelTime;
+        }
+        char msg[16];
+        snprintf(msg, sizeof(msg), "flags %04x", flags);
+        TEST_ASSERT_EQUAL_MESSAGE(90, p.lastCadence, msg);
+        TEST_ASSERT_EQUAL_MESSAGE(flags & 0x0010 ? 3600 : 0, p.lastSpeed, msg);
+    }
+}
+
+void test_event_timeout() {
+    PeerCharacteristicPower p;
+    uint8_t f[40];
+    size_t length = frame(f, 0x0020, 1, 0, 0, 0);
+    p.decode(f, length);
+    Host::advance(667);
+    length = frame(f, 0x0020, 2, 683, 0, 0);
+    p.decode(f, length);
+    TEST_ASSERT_EQUAL(90, p.lastCadence);
+    // the same event repeated: coasting
+    Host::advance(ATOLL_POWER_EVENT_TIMEOUT + 1);
+    p.decode(f, length);
+    TEST_ASSERT_EQUAL(0, p.lastCadence);
+}
+
+// random lengths and contents: accepted exactly when the frame is at least
+// as long as its flags require
+void test_fuzz() {
+    std::mt19937 rng(1);
+    uint8_t f[32];
+    uint32_t accepted = 0;
+    for (uint32_t i = 0; i < FUZZ_FRAMES; i++) {
+        size_t length = rng() % (sizeof(f) + 1);
+        for (size_t j = 0; j < length; j++) f[j] = rng();
+        Measurement m;
+        bool ok = PeerCharacteristicPower::parse(f, length, &m);
+        if (ok) accepted++;
+        bool expected = 4 <= length && requiredLength(f[0] | f[1] << 8) <= length;
+        if (ok != expected) {
+            char msg[64];
+            snprintf(msg, sizeof(msg), "flags %02x%02x length %d", f[1], f[0], (int)length);
+            TEST_FAIL_MESSAGE(msg);
+        }
+    }
+    char msg[64];
+    snprintf(msg, sizeof(msg), "%d frames, %u accepted", FUZZ_FRAMES, accepted);
+    TEST_MESSAGE(msg);
+}
+
+void test_benchmark() {
+    uint8_t crank[40], full[40];
+    size_t crankLength = frame(crank, 0x0020, 1, 0, 0, 0);
+    size_t fullLength = frame(full, 0x0fff, 1, 0, 0, 0);
+    PeerCharacteristicPower p;
+    double ns[2];
+    struct {
+        uint8_t *f;
+        size_t length;
+    } cases[] = {{crank, crankLength}, {full, fullLength}};
+    for (int c = 0; c < 2; c++) {
+        uint32_t sum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < BENCH_CALLS; i++) {
+            cases[c].f[cases[c].length - 1]++;  // a new event each time
+            sum += p.decode(cases[c].f, cases[c].length);
+        }
+        ns[c] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / BENCH_CALLS;
+        TEST_ASSERT_EQUAL(250u * BENCH_CALLS, sum);
+    }
+    char msg[96];
+    snprintf(msg, sizeof(msg), "decode(): crank only (%d bytes) %.1f ns, every field (%d bytes) %.1f ns",
+             (int)crankLength, ns[0], (int)fullLength, ns[1]);
+    TEST_MESSAGE(msg);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_all_fields);
+    RUN_TEST(test_negative_power);
+    RUN_TEST(test_layouts);
+    RUN_TEST(test_event_timeout);
+    RUN_TEST(test_fuzz);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
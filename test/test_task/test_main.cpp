@@ -0,0 +1,194 @@
+// Task and TaskExecutor on the host, scheduled by the virtual clock
+#include <unity.h>
+
+#include "atoll_task.h"
+#include "atoll_task_executor.h"
+
+using namespace Atoll;
+
+class Counter : public Task {
+   public:
+    const char *taskName() override { return "Counter"; }
+    uint32_t loops = 0;
+    uint32_t loopDelay = 0;       // ms to block in each loop
+    uint32_t notifications = 0;   // FreeRTOS task notifications seen by the loop
+    volatile float freq = 0;      // applied by the loop, the task changes its own freq
+    void loop() override {
+        loops++;
+        if (0 < freq) {
+            taskSetFreq(freq);
+            freq = 0;
+        }
+        if (0 < loopDelay) delay(loopDelay);
+        notifications += ulTaskNotifyTake(pdTRUE, 0);
+    }
+};
+
+void setUp() {
+    Host::useVirtualClock(true);
+}
+
+void tearDown() {
+    Host::advance(5);
+    TEST_ASSERT_EQUAL(0, Host::runnable());
+    Host::useVirtualClock(false);
+}
+
+void test_virtual_clock() {
+    unsigned long start = millis();
+    int64_t startUs = esp_timer_get_time();
+    Host::advance(250);
+    TEST_ASSERT_EQUAL(250, millis() - start);
+    TEST_ASSERT_EQUAL(250000, esp_timer_get_time() - startUs);
+    TEST_ASSERT_EQUAL(millis(), xTaskGetTickCount());
+}
+
+void test_periodic_loop() {
+    Counter t;
+    t.taskStart(10);
+    TEST_ASSERT_TRUE(t.taskRunning());
+    Host::advance(1000);
+    // the first loop runs on start
+    TEST_ASSERT_EQUAL(11, t.loops);
+    TEST_ASSERT_EQUAL(t.loops, t.taskStats.loops);
+    TEST_ASSERT_EQUAL(0, t.taskStats.overruns);
+    t.taskStop();
+    TEST_ASSERT_FALSE(t.taskRunning());
+    uint32_t loops = t.loops;
+    Host::advance(500);
+    TEST_ASSERT_EQUAL(loops, t.loops);
+}
+
+void test_set_freq() {
+    Counter t;
+    t.taskStart(1);
+    Host::advance(1000);
+    TEST_ASSERT_EQUAL(2, t.loops);
+    t.freq = 20;
+    Host::advance(1000);
+    TEST_ASSERT_EQUAL(50, t.taskDelayMs());
+    uint32_t loops = t.loops;
+    Host::advance(1000);
+    TEST_ASSERT_EQUAL(loops + 20, t.loops);
+    t.taskStop();
+}
+
+void test_wake_on_notify() {
+    Counter t;
+    t.taskSetWakeOnNotify(true);
+    t.taskStart(1);
+    Host::advance(10);
+    uint32_t loops = t.loops;
+    for (int i = 0; i < 5; i++) {
+        t.taskNotify();
+        Host::advance(10);
+    }
+    TEST_ASSERT_EQUAL(loops + 5, t.loops);
+    TEST_ASSERT_EQUAL(5, t.taskStats.notified);
+    // taskNotify() must leave the FreeRTOS notification to blocking calls in the loop
+    TEST_ASSERT_EQUAL(0, t.notifications);
+    // the delay is the max time between loops
+    Host::advance(1000);
+    TEST_ASSERT_EQUAL(loops + 6, t.loops);
+    t.taskStop();
+}
+
+void test_executor_shared() {
+    TaskExecutor executor;
+    executor.taskStart();
+    Counter a, b;
+    a.taskSetShared(&executor);
+    b.taskSetShared(&executor);
+    a.taskStart(5);
+    b.taskStart(2);
+    TEST_ASSERT_TRUE(a.taskShared());
+    TEST_ASSERT_TRUE(b.taskShared());
+    TEST_ASSERT_EQUAL(2, executor.size());
+    Host::advance(2000);
+    TEST_ASSERT_INT_WITHIN(1, 10, a.loops);
+    TEST_ASSERT_INT_WITHIN(1, 4, b.loops);
+    b.taskStop();
+    TEST_ASSERT_EQUAL(1, executor.size());
+    TEST_ASSERT_FALSE(b.taskRunning());
+    a.taskStop();
+    executor.taskStop();
+}
+
+void test_executor_notify() {
+    TaskExecutor executor;
+    executor.taskStart();
+    Counter t;
+    t.taskSetShared(&executor);
+    t.taskSetWakeOnNotify(true);
+    t.taskStart(1);
+    Host::advance(10);
+    uint32_t loops = t.loops;
+    t.taskNotify();
+    Host::advance(10);
+    TEST_ASSERT_EQUAL(loops + 1, t.loops);
+    TEST_ASSERT_EQUAL(1, t.taskStats.notified);
+    t.taskStop();
+    executor.taskStop();
+}
+
+void test_executor_overrun() {
+    TaskExecutor executor;
+    executor.taskStart();
+    Counter slow;
+    slow.loopDelay = ATOLL_TASK_EXECUTOR_BUDGET + 10;
+    slow.taskSetShared(&executor);
+    slow.taskStart(10);
+    TEST_ASSERT_TRUE(slow.taskShared());
+    Host::advance(1000);
+    // moved to a dedicated thread after ATOLL_TASK_EXECUTOR_MAX_OVERRUNS loops
+    TEST_ASSERT_FALSE(slow.taskShared());
+    TEST_ASSERT_TRUE(slow.taskRunning());
+    TEST_ASSERT_EQUAL(0, executor.size());
+    uint32_t loops = slow.loops;
+    Host::advance(1000);
+    TEST_ASSERT_GREATER_THAN(loops, slow.loops);
+    slow.taskStop();
+    executor.taskStop();
+}
+
+void test_governor() {
+    Counter t;
+    t.taskSetGovernor(1, 10, TaskActivity::moving);
+    t.taskStart();
+    Host::advance(1000);
+    TEST_ASSERT_FALSE(t.taskGovernorActive());
+    uint32_t loops = t.loops;
+    Task::taskSetActivity(TaskActivity::moving, true);
+    Host::advance(1000);
+    TEST_ASSERT_TRUE(t.taskGovernorActive());
+    TEST_ASSERT_INT_WITHIN(1, loops + 10, t.loops);
+    Task::taskSetActivity(TaskActivity::moving, false);
+    Host::advance(10);
+    TEST_ASSERT_FALSE(t.taskGovernorActive());
+    t.taskStop();
+}
+
+void test_registry() {
+    Counter t;
+    uint8_t count = Task::taskCount();
+    t.taskStart(1);
+    TEST_ASSERT_EQUAL(count + 1, Task::taskCount());
+    TEST_ASSERT_EQUAL(&t, Task::taskFind("Counter"));
+    t.taskStop();
+    TEST_ASSERT_EQUAL(count, Task::taskCount());
+    TEST_ASSERT_NULL(Task::taskFind("Counter"));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_virtual_clock);
+    RUN_TEST(test_periodic_loop);
+    RUN_TEST(test_set_freq);
+    RUN_TEST(test_wake_on_notify);
+    RUN_TEST(test_executor_shared);
+    RUN_TEST(test_executor_notify);
+    RUN_TEST(test_executor_overrun);
+    RUN_TEST(test_governor);
+    RUN_TEST(test_registry);
+    return UNITY_END();
+}